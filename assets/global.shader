@@ -1,16 +1,16 @@
 #version 1
 
 type global
-vertex simple.vs
-fragment test.fs
+vertex window.vs
+fragment window.fs
 attrib 0 vertex
 attrib 1 uv
 
-uniform mvp ignored
-uniform flip bool false
-uniform tex_scr sampler
+block Frame 0
+block Window 1
+
+feature DIM
+feature INVERT
+feature TINT
 
-uniform invert bool false
-uniform dim float 1.0
-uniform opacity float 1.0
-uniform uvscale vec2 1.0,1.0
+uniform tex_scr sampler
@@ -0,0 +1,56 @@
+#version 140
+
+// Features, set per batch when any of its windows needs them:
+// DIM    - windows can be dimmed
+// INVERT - windows can have their colors inverted
+
+in vec2 fragmentUV;
+flat in int unit;
+flat in float dim;
+flat in int invert;
+
+// Must be as large as WINDOWBATCH_TEXTURES
+uniform sampler2D tex_scr[16];
+
+// Sampler arrays can only be indexed by constants before GLSL 4.00
+vec4 sample_unit(vec2 uv) {
+    switch(unit) {
+        case 0: return texture(tex_scr[0], uv);
+        case 1: return texture(tex_scr[1], uv);
+        case 2: return texture(tex_scr[2], uv);
+        case 3: return texture(tex_scr[3], uv);
+        case 4: return texture(tex_scr[4], uv);
+        case 5: return texture(tex_scr[5], uv);
+        case 6: return texture(tex_scr[6], uv);
+        case 7: return texture(tex_scr[7], uv);
+        case 8: return texture(tex_scr[8], uv);
+        case 9: return texture(tex_scr[9], uv);
+        case 10: return texture(tex_scr[10], uv);
+        case 11: return texture(tex_scr[11], uv);
+        case 12: return texture(tex_scr[12], uv);
+        case 13: return texture(tex_scr[13], uv);
+        case 14: return texture(tex_scr[14], uv);
+        default: return texture(tex_scr[15], uv);
+    }
+}
+
+void main() {
+    gl_FragColor = sample_unit(fragmentUV);
+
+#ifdef DIM
+    vec3 contrib = gl_FragColor.rgb * vec3(0.2627, 0.6780, 0.0593);
+    float luma = contrib.r + contrib.g + contrib.b;
+    gl_FragColor.rgb += (1.0 - dim) * (vec3(luma) - gl_FragColor.rgb);
+
+    gl_FragColor.rgb *= .2 * dim + .8;
+#endif
+
+#ifdef INVERT
+    if(invert != 0) {
+        gl_FragColor.rgb = vec3(gl_FragColor.a) - gl_FragColor.rgb;
+    }
+#endif
+
+    if(gl_FragColor.a == 0)
+        discard;
+}
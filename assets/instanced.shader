@@ -0,0 +1,17 @@
+#version 1
+
+type instanced
+vertex instanced.vs
+fragment instanced.fs
+attrib 0 vertex
+attrib 1 uv
+attrib 2 rect
+attrib 3 params
+attrib 4 uvscale
+
+block Frame 0
+
+feature DIM
+feature INVERT
+
+uniform tex_scr ignored
@@ -0,0 +1,32 @@
+#version 140
+in vec3 vertex;
+in vec2 uv;
+// Position and size of the window
+in vec4 rect;
+// z, dim, flags and texture unit
+in vec4 params;
+in vec2 uvscale;
+
+out vec2 fragmentUV;
+flat out int unit;
+flat out float dim;
+flat out int invert;
+
+layout(std140) uniform Frame {
+    mat4 view;
+    vec2 viewport;
+};
+
+void main() {
+    int flags = int(params.z);
+    bool flip = (flags & 1) != 0;
+
+    fragmentUV = flip ? vec2(uv.x, 1 - uv.y) : uv;
+    fragmentUV *= uvscale;
+    unit = int(params.w);
+    dim = params.y;
+    invert = (flags >> 1) & 1;
+
+    vec3 pos = vec3(rect.xy + vertex.xy * rect.zw, vertex.z + params.x);
+    gl_Position = view * vec4(pos, 1.0);
+}
@@ -8,5 +8,6 @@ attrib 1 uv
 
 uniform mvp ignored
 uniform flip bool false
+uniform uvscale vec2 1.0,1.0
 uniform opacity float 1.0
 uniform tex_scr sampler
@@ -0,0 +1,53 @@
+#version 140
+
+// Features, set per window:
+// DIM    - the window is dimmed
+// INVERT - the colors of the window are inverted
+// TINT   - the window is tinted
+
+in vec2 fragmentUV;
+flat in float opacity;
+flat in float dim;
+flat in vec4 tint;
+
+layout(std140) uniform Frame {
+    mat4 view;
+    vec2 viewport;
+};
+
+uniform sampler2D tex_scr;
+
+#ifdef TINT
+float rand(in vec2 co){
+    return fract(sin(dot(co.xy, vec2(12.9898,78.233))) * 43758.5453);
+}
+#endif
+
+void main() {
+    vec2 uv = fragmentUV;
+    gl_FragColor = texture(tex_scr, uv);
+
+#ifdef DIM
+    vec3 contrib = gl_FragColor.rgb * vec3(0.2627, 0.6780, 0.0593);
+    float luma = contrib.r + contrib.g + contrib.b;
+    gl_FragColor.rgb += (1.0 - dim) * (vec3(luma) - gl_FragColor.rgb);
+
+    gl_FragColor.rgb *= .2 * dim + .8;
+#endif
+
+#ifdef INVERT
+    gl_FragColor.rgb = vec3(gl_FragColor.a) - gl_FragColor.rgb;
+#endif
+
+    gl_FragColor *= opacity;
+
+#ifdef TINT
+    // The tint is a sparse pattern behind the contents
+    vec2 screen_uv = gl_FragCoord.xy / viewport;
+    if(rand(screen_uv) >= .85)
+        gl_FragColor += tint * (1.0 - gl_FragColor.a);
+#endif
+
+    if(gl_FragColor.a == 0)
+        discard;
+}
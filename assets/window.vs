@@ -0,0 +1,38 @@
+#version 140
+in vec3 vertex;
+in vec2 uv;
+out vec2 fragmentUV;
+flat out float opacity;
+flat out float dim;
+flat out vec4 tint;
+
+layout(std140) uniform Frame {
+    mat4 view;
+    vec2 viewport;
+};
+
+// Set for every draw
+layout(std140) uniform Window {
+    // Position and size of the window
+    vec4 rect;
+    // z, opacity, dim and flags
+    vec4 params;
+    // Premultiplied, only used with TINT
+    vec4 tint_color;
+    // Scale of the texture uvs in xy
+    vec4 uvscale;
+};
+
+void main() {
+    int flags = int(params.w);
+    bool flip = (flags & 1) != 0;
+
+    fragmentUV = flip ? vec2(uv.x, 1 - uv.y) : uv;
+    fragmentUV *= uvscale.xy;
+    opacity = params.y;
+    dim = params.z;
+    tint = tint_color;
+
+    vec3 pos = vec3(rect.xy + vertex.xy * rect.zw, vertex.z + params.x);
+    gl_Position = view * vec4(pos, 1.0);
+}
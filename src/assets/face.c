@@ -1,8 +1,34 @@
 #include "face.h"
 
+#include "../glstate.h"
+
+#include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include <assert.h>
 
+#include "logging.h"
+
+// The arena starts out with room for this many quads, and doubles when it
+// runs out
+#define FACE_ARENA_QUADS 4096
+
+// Every rect is a quad of 4 vertices, drawn as two triangles
+#define QUAD_VERTICES 4
+#define QUAD_INDICES 6
+
+static struct {
+    bool initialized;
+
+    GLuint vao;
+    GLuint vertex;
+    GLuint index;
+    size_t capacity;
+
+    // The unused ranges, sorted and never adjacent
+    Vector free;
+} arena;
+
 void face_init(struct face* asset, size_t vertex_count) {
     vector_init(&asset->vertex_buffer, sizeof(float), vertex_count * 3);
     vector_init(&asset->uv_buffer, sizeof(float), vertex_count * 2);
@@ -17,7 +43,7 @@ struct face* face_load_file(const char* path) {
 
     fseek(file, 0, SEEK_SET);
 
-    struct face* face = malloc(sizeof(struct face));
+    struct face* face = calloc(1, sizeof(struct face));
 
     char* line = NULL;
     size_t line_size = 0;
@@ -234,7 +260,7 @@ void face_upload(struct face* asset) {
     glGenBuffers(1, &asset->vertex);
     glGenBuffers(1, &asset->uv);
 
-    glBindVertexArray(asset->vao);
+    glstate_bindVertexArray(asset->vao);
 
     glEnableVertexAttribArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, asset->vertex);
@@ -247,14 +273,277 @@ void face_upload(struct face* asset) {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
 }
 
-void face_bind(struct face* face) {
-    glBindVertexArray(face->vao);
+void face_draw(struct face* face) {
+    if(face->in_arena) {
+        glstate_bindVertexArray(arena.vao);
+        glDrawElementsBaseVertex(GL_TRIANGLES, face->arena_quads * QUAD_INDICES,
+                GL_UNSIGNED_INT, NULL, face->arena_first * QUAD_VERTICES);
+        return;
+    }
+
+    glstate_bindVertexArray(face->vao);
+    glDrawArrays(GL_TRIANGLES, 0, face->vertex_buffer.size / 3);
 }
 
 void face_unload_file(struct face* asset) {
     glDeleteBuffers(1, &asset->vertex);
     glDeleteBuffers(1, &asset->uv);
+    glDeleteVertexArrays(1, &asset->vao);
+    glstate_deletedVertexArray(asset->vao);
 
     vector_kill(&asset->vertex_buffer);
     vector_kill(&asset->uv_buffer);
+    free(asset);
+}
+
+// The uv of a face is the same as its position, so both attributes read the
+// same buffer
+static void arena_setup_vao() {
+    glstate_bindVertexArray(arena.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vertex);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.index);
+}
+
+// Indices are relative to the first vertex of the face, so one index buffer
+// covering the largest possible face works for all of them
+static bool arena_fill_index(size_t capacity) {
+    GLuint* indices = malloc(sizeof(GLuint) * capacity * QUAD_INDICES);
+    if(indices == NULL) {
+        printf_errf("Failed allocating the face arena indices");
+        return false;
+    }
+
+    for(size_t i = 0; i < capacity; i++) {
+        GLuint base = i * QUAD_VERTICES;
+        GLuint* quad = &indices[i * QUAD_INDICES];
+        quad[0] = base + 0;
+        quad[1] = base + 1;
+        quad[2] = base + 2;
+        quad[3] = base + 2;
+        quad[4] = base + 1;
+        quad[5] = base + 3;
+    }
+
+    glstate_bindVertexArray(arena.vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.index);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * capacity * QUAD_INDICES,
+            indices, GL_STATIC_DRAW);
+
+    free(indices);
+    return true;
+}
+
+void face_ranges_add(Vector* ranges, size_t first, size_t count) {
+    size_t index = 0;
+    while(index < vector_size(ranges)) {
+        struct face_range* range = vector_get(ranges, index);
+        if(range->first > first)
+            break;
+        index++;
+    }
+
+    // Merge with the neighbours where they touch
+    if(index > 0) {
+        struct face_range* prev = vector_get(ranges, index - 1);
+        if(prev->first + prev->count == first) {
+            prev->count += count;
+            if(index < vector_size(ranges)) {
+                struct face_range* next = vector_get(ranges, index);
+                if(prev->first + prev->count == next->first) {
+                    prev->count += next->count;
+                    vector_remove(ranges, index);
+                }
+            }
+            return;
+        }
+    }
+    if(index < vector_size(ranges)) {
+        struct face_range* next = vector_get(ranges, index);
+        if(first + count == next->first) {
+            next->first = first;
+            next->count += count;
+            return;
+        }
+    }
+
+    struct face_range range = {first, count};
+    vector_putBack(ranges, &range);
+    if(index != vector_size(ranges) - 1)
+        vector_circulate(ranges, vector_size(ranges) - 1, index);
+}
+
+bool face_ranges_take(Vector* ranges, size_t count, size_t* first) {
+    for(size_t i = 0; i < vector_size(ranges); i++) {
+        struct face_range* range = vector_get(ranges, i);
+        if(range->count < count)
+            continue;
+
+        *first = range->first;
+        range->first += count;
+        range->count -= count;
+        if(range->count == 0)
+            vector_remove(ranges, i);
+        return true;
+    }
+    return false;
+}
+
+size_t face_ranges_grownCapacity(size_t capacity, size_t count) {
+    size_t grown = capacity;
+    while(grown - capacity < count)
+        grown *= 2;
+    return grown;
+}
+
+// Double the arena until the count fits at the end. The old contents are
+// copied over on the GPU.
+static bool arena_grow(size_t count) {
+    size_t capacity = face_ranges_grownCapacity(arena.capacity, count);
+
+    GLuint vertex;
+    glGenBuffers(1, &vertex);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex);
+    glBufferData(GL_COPY_WRITE_BUFFER, sizeof(float) * 3 * QUAD_VERTICES * capacity,
+            NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, arena.vertex);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+            sizeof(float) * 3 * QUAD_VERTICES * arena.capacity);
+    glDeleteBuffers(1, &arena.vertex);
+    arena.vertex = vertex;
+
+    if(!arena_fill_index(capacity))
+        return false;
+
+    arena_setup_vao();
+    face_ranges_add(&arena.free, arena.capacity, capacity - arena.capacity);
+    arena.capacity = capacity;
+    return true;
+}
+
+static bool arena_alloc(size_t count, size_t* first) {
+    if(face_ranges_take(&arena.free, count, first))
+        return true;
+
+    if(!arena_grow(count))
+        return false;
+    return arena_alloc(count, first);
+}
+
+bool face_arena_init() {
+    glGenVertexArrays(1, &arena.vao);
+    glGenBuffers(1, &arena.vertex);
+    glGenBuffers(1, &arena.index);
+
+    arena.capacity = FACE_ARENA_QUADS;
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vertex);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * QUAD_VERTICES * arena.capacity,
+            NULL, GL_DYNAMIC_DRAW);
+
+    if(!arena_fill_index(arena.capacity)) {
+        glDeleteBuffers(1, &arena.vertex);
+        glDeleteBuffers(1, &arena.index);
+        glDeleteVertexArrays(1, &arena.vao);
+        glstate_deletedVertexArray(arena.vao);
+        return false;
+    }
+    arena_setup_vao();
+
+    vector_init(&arena.free, sizeof(struct face_range), 16);
+    struct face_range all = {0, arena.capacity};
+    vector_putBack(&arena.free, &all);
+
+    arena.initialized = true;
+    return true;
+}
+
+void face_arena_delete() {
+    if(!arena.initialized)
+        return;
+
+    glDeleteBuffers(1, &arena.vertex);
+    glDeleteBuffers(1, &arena.index);
+    glDeleteVertexArrays(1, &arena.vao);
+    glstate_deletedVertexArray(arena.vao);
+    vector_kill(&arena.free);
+    arena.initialized = false;
+}
+
+bool face_arena_store(struct face* face, Vector* rects) {
+    assert(arena.initialized);
+
+    size_t quads = vector_size(rects);
+    if(quads == 0) {
+        face_arena_release(face);
+        face->in_arena = true;
+        return true;
+    }
+
+    if(!face->in_arena || face->arena_capacity < quads) {
+        face_arena_release(face);
+
+        size_t first;
+        if(!arena_alloc(quads, &first)) {
+            printf_errf("Failed allocating %zu quads in the face arena", quads);
+            return false;
+        }
+        face->in_arena = true;
+        face->arena_first = first;
+        face->arena_capacity = quads;
+    }
+    face->arena_quads = quads;
+
+    float* vertices = malloc(sizeof(float) * 3 * QUAD_VERTICES * quads);
+    if(vertices == NULL) {
+        printf_errf("Failed allocating the face vertices");
+        face->arena_quads = 0;
+        return false;
+    }
+
+    size_t index;
+    struct Rect* rect = vector_getFirst(rects, &index);
+    while(rect != NULL) {
+        float* quad = &vertices[index * 3 * QUAD_VERTICES];
+        float x1 = rect->pos.x;
+        float y1 = rect->pos.y;
+        float x2 = rect->pos.x + rect->size.x;
+        float y2 = rect->pos.y - rect->size.y;
+
+        // Same corners and winding as face_init_rects
+        float corners[] = {
+            x1, y1, 0,
+            x1, y2, 0,
+            x2, y1, 0,
+            x2, y2, 0,
+        };
+        memcpy(quad, corners, sizeof(corners));
+
+        rect = vector_getNext(rects, &index);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, arena.vertex);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 3 * QUAD_VERTICES * face->arena_first,
+            sizeof(float) * 3 * QUAD_VERTICES * quads, vertices);
+
+    free(vertices);
+    return true;
+}
+
+void face_arena_release(struct face* face) {
+    if(!face->in_arena)
+        return;
+
+    // The arena might already be gone on shutdown
+    if(arena.initialized && face->arena_capacity != 0)
+        face_ranges_add(&arena.free, face->arena_first, face->arena_capacity);
+
+    face->in_arena = false;
+    face->arena_first = 0;
+    face->arena_quads = 0;
+    face->arena_capacity = 0;
 }
@@ -16,6 +16,14 @@ struct face {
     GLuint vao;
     GLuint vertex;
     GLuint uv;
+
+    // Window shapes live in the face arena as quads instead of having
+    // buffers of their own. The slot is counted in quads, and might be
+    // larger than what's used.
+    bool in_arena;
+    size_t arena_first;
+    size_t arena_quads;
+    size_t arena_capacity;
 };
 
 struct face* face_load_file(const char* path);
@@ -30,6 +38,32 @@ void face_init(struct face* asset, size_t vertex_count);
 void face_init_rects(struct face* asset, Vector* rects);
 
 void face_upload(struct face* asset);
-void face_bind(struct face* face);
+void face_draw(struct face* face);
 
 void face_unload_file(struct face* asset);
+
+// The arena is a single vertex buffer shared by the faces of all shaped
+// windows, drawn through a single VAO with a shared quad index buffer.
+// Storing a new shape reuses the slot of the face if it fits, so a reshape
+// is just a buffer update.
+bool face_arena_init();
+void face_arena_delete();
+
+// Store the rects of a window shape in the face, which has to be zeroed or
+// already be in the arena
+bool face_arena_store(struct face* face, Vector* rects);
+void face_arena_release(struct face* face);
+
+// The bookkeeping of the unused quads in the arena. The ranges are kept
+// sorted and never adjacent, freeing a range merges it with its neighbours.
+struct face_range {
+    size_t first;
+    size_t count;
+};
+
+void face_ranges_add(Vector* ranges, size_t first, size_t count);
+// First fit, returns false if no range is large enough
+bool face_ranges_take(Vector* ranges, size_t count, size_t* first);
+// The arena only ever grows at the end, so everything allocated keeps its
+// place. This is the capacity it doubles to for count more quads.
+size_t face_ranges_grownCapacity(size_t capacity, size_t count);
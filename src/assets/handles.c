@@ -0,0 +1,66 @@
+#include "handles.h"
+
+#include "assets.h"
+#include "../shaders/shaderinfo.h"
+
+#include <stdio.h>
+
+#include "logging.h"
+
+struct AssetHandles asset_handles;
+
+static bool load_shader(const char* path, struct shader_type_info* info,
+        struct shader_program** program, void** type) {
+    *program = assets_load(path);
+    if(*program == NULL) {
+        printf_errf("Failed loading shader %s", path);
+        return false;
+    }
+
+    if((*program)->shader_type_info != info) {
+        printf_errf("Shader %s was not a %s shader", path, info->name);
+        return false;
+    }
+
+    *type = (*program)->shader_type;
+    return true;
+}
+
+#define LOAD_SHADER(handle, path, info) \
+    load_shader(path, &info, &handle.program, (void**)&handle.type)
+
+bool assethandles_load() {
+    asset_handles.window_face = assets_load("window.face");
+    if(asset_handles.window_face == NULL) {
+        printf_errf("Failed loading the window face");
+        return false;
+    }
+
+    if(!LOAD_SHADER(asset_handles.global, "global.shader", global_info))
+        return false;
+
+    struct shader_program* global = asset_handles.global.program;
+    asset_handles.global_features.dim = shader_program_feature(global, "DIM");
+    asset_handles.global_features.invert = shader_program_feature(global, "INVERT");
+    asset_handles.global_features.tint = shader_program_feature(global, "TINT");
+
+    // The window batch is only an optimization, without the instanced shader
+    // every window is drawn on its own
+    if(LOAD_SHADER(asset_handles.instanced, "instanced.shader", instanced_info)) {
+        struct shader_program* instanced = asset_handles.instanced.program;
+        asset_handles.instanced_features.dim = shader_program_feature(instanced, "DIM");
+        asset_handles.instanced_features.invert = shader_program_feature(instanced, "INVERT");
+    } else {
+        printf_errf("Drawing windows without batching");
+        asset_handles.instanced.program = NULL;
+        asset_handles.instanced.type = NULL;
+    }
+
+    return LOAD_SHADER(asset_handles.passthough, "passthough.shader", passthough_info)
+        && LOAD_SHADER(asset_handles.stencil, "stencil.shader", stencil_info)
+        && LOAD_SHADER(asset_handles.shadow, "shadow.shader", shadow_info)
+        && LOAD_SHADER(asset_handles.downscale, "downscale.shader", downsample_info)
+        && LOAD_SHADER(asset_handles.upsample, "upsample.shader", upsample_info)
+        && LOAD_SHADER(asset_handles.profiler, "profiler.shader", profiler_info)
+        && LOAD_SHADER(asset_handles.text, "text.shader", text_info);
+}
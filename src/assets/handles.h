@@ -0,0 +1,49 @@
+#pragma once
+
+#include "face.h"
+#include "shader.h"
+#include "../shaders/include.h"
+
+#include <stdbool.h>
+
+// The assets used for drawing, loaded once at startup. Every shader program
+// is checked against its shader type when it's loaded, so the draw code can
+// use the handles directly without a lookup or a check of its own.
+
+// A shader program together with its uniforms
+#define SHADER_HANDLE(TYPE)             \
+    struct {                            \
+        struct shader_program* program; \
+        struct TYPE* type;              \
+    }
+
+struct AssetHandles {
+    struct face* window_face;
+
+    SHADER_HANDLE(Global) global;
+    // The bits of the global shader variants, 0 if the shader lacks one
+    struct {
+        unsigned int dim;
+        unsigned int invert;
+        unsigned int tint;
+    } global_features;
+    // NULL if the shader failed to load, the windows aren't batched then
+    SHADER_HANDLE(Instanced) instanced;
+    // The bits of the instanced shader variants, 0 if the shader lacks one
+    struct {
+        unsigned int dim;
+        unsigned int invert;
+    } instanced_features;
+    SHADER_HANDLE(Passthough) passthough;
+    SHADER_HANDLE(Stencil) stencil;
+    SHADER_HANDLE(Shadow) shadow;
+    SHADER_HANDLE(Downsample) downscale;
+    SHADER_HANDLE(Upsample) upsample;
+    SHADER_HANDLE(Profiler) profiler;
+    SHADER_HANDLE(Text) text;
+};
+
+extern struct AssetHandles asset_handles;
+
+// Shaders are compiled when they are loaded, so this needs a GL context
+bool assethandles_load();
@@ -10,6 +10,48 @@
 
 #include "assets.h"
 #include "../shaders/shaderinfo.h"
+#include "../glstate.h"
+
+// Compile a shader with the defines put right after the #version line, which
+// has to come before anything else
+static GLuint compile_shader(const char* path, GLenum type, const char* source, const char* defines) {
+    GLuint shader = glCreateShader(type);
+    if(shader == 0) {
+        printf("Failed creating the shader object for %s\n", path);
+        return 0;
+    }
+
+    GLint version_len = 0;
+    if(strncmp(source, "#version", 8) == 0) {
+        const char* newline = strchr(source, '\n');
+        version_len = newline != NULL ? newline - source + 1 : strlen(source);
+    }
+
+    const char* strings[3] = {source, defines, source + version_len};
+    GLint lengths[3] = {version_len, -1, -1};
+    glShaderSource(shader, 3, strings, lengths);
+    glCompileShader(shader);
+
+    int status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(status == GL_FALSE) {
+        printf("Failed compiling shader %s\n", path);
+
+        GLint log_len = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &log_len);
+        if (log_len) {
+            char log[log_len + 1];
+            glGetShaderInfoLog(shader, log_len, NULL, log);
+            printf(" -- %s\n", log);
+            fflush(stdout);
+        }
+
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
 
 static struct shader* shader_load_file(const char* path, GLenum type) {
     FILE* file = fopen(path, "r");
@@ -39,36 +81,16 @@ static struct shader* shader_load_file(const char* path, GLenum type) {
 
     struct shader* shader = malloc(sizeof(struct shader));
 
-    shader->gl_shader = glCreateShader(type);
-    if(shader < 0) {
-        printf("Failed creating the shader object for %s\n", path);
+    shader->gl_shader = compile_shader(path, type, buffer, "");
+    if(shader->gl_shader == 0) {
         free(buffer);
         free(shader);
         return NULL;
     }
 
-    glShaderSource(shader->gl_shader, 1, (const char**)&buffer, NULL);
-    glCompileShader(shader->gl_shader);
-
-    // GL Lets you free the string right after the compile
-    free(buffer);
-
-    int status = GL_FALSE;
-    glGetShaderiv(shader->gl_shader, GL_COMPILE_STATUS, &status);
-    if(status == GL_FALSE) {
-        printf("Failed compiling shader %s\n", path);
-
-        GLint log_len = 0;
-        glGetShaderiv(shader->gl_shader, GL_INFO_LOG_LENGTH, &log_len);
-        if (log_len) {
-            char log[log_len + 1];
-            glGetShaderInfoLog(shader->gl_shader, log_len, NULL, log);
-            printf(" -- %s\n", log);
-            fflush(stdout);
-        }
-
-        return NULL;
-    }
+    // The source is kept around to compile the program variants from
+    shader->type = type;
+    shader->source = buffer;
 
     return shader;
 }
@@ -84,18 +106,19 @@ struct shader* frag_shader_load_file(const char* path) {
 
 void shader_unload_file(struct shader* asset) {
     glDeleteShader(asset->gl_shader);
+    free(asset->source);
     free(asset);
 }
 
-static void shader_program_link(struct shader_program* program) {
+static bool shader_program_link(struct shader_program* program, GLuint vertex, GLuint fragment) {
     program->gl_program = glCreateProgram();
     if(program->gl_program == 0) {
         printf("Failed creating program\n");
-        return;
+        return false;
     }
 
-    glAttachShader(program->gl_program, program->fragment->gl_shader);
-    glAttachShader(program->gl_program, program->vertex->gl_shader);
+    glAttachShader(program->gl_program, fragment);
+    glAttachShader(program->gl_program, vertex);
 
     // @FRAGILE 64 here is has to be the same as the MAXIMUM length of a shader
     // variable name
@@ -124,7 +147,9 @@ static void shader_program_link(struct shader_program* program) {
         }
 
         glDeleteProgram(program->gl_program);
+        return false;
     }
+    return true;
 }
 
 static int parse_type(char* def, struct shader_value* uniform) {
@@ -214,6 +239,118 @@ static int parse_type(char* def, struct shader_value* uniform) {
     return 0;
 }
 
+// What was parsed from the program file, needed again for every variant
+struct shader_defs {
+    const char* path;
+    char (*names)[64];
+    char (*block_names)[64];
+    const GLuint* block_bindings;
+    size_t blocks_num;
+};
+
+// Hook the uniforms and blocks up to the linked program
+static bool shader_program_bind(struct shader_program* program, const struct shader_defs* defs) {
+    struct shader_type_info* shader_info = program->shader_type_info;
+
+    program->shader_type = malloc(shader_info->size);
+    if(program->shader_type == NULL) {
+        printf("Failed to allocate space for the shader type\n");
+        return false;
+    }
+
+    // Bind the static shadertype members to the shader_value structs
+    for(int i = 0; i < shader_info->member_count; i++) {
+        struct shader_uniform_info* uniform_info = &shader_info->members[i];
+        struct shader_value** field = (struct shader_value**)(program->shader_type + uniform_info->offset);
+        *field = NULL;
+        for(int j = 0; j < program->uniforms_num; j++) {
+            if(strcmp(defs->names[j], uniform_info->name) == 0) {
+                *field = &program->uniforms[j];
+                break;
+            }
+        }
+        if(*field == NULL) {
+            printf("Uniform \"%s\" is not defined in shader %s\n", uniform_info->name, defs->path);
+            exit(1);
+        }
+    }
+
+    printf("Uniforms in shader \"%s\"\n", program->shader_type_info->name);
+    // Bind the uniforms to the shader program
+    for(int i = 0; i < program->uniforms_num; i++) {
+        struct shader_value* uniform = &program->uniforms[i];
+        uniform->gl_uniform = glGetUniformLocation(program->gl_program, defs->names[i]);
+        uniform->set = false;
+        uniform->uploaded = false;
+        printf("\tUniform \"%s\" has id %d, required %d\n", defs->names[i], uniform->gl_uniform, uniform->required);
+    }
+
+    // Point the uniform blocks at their shared buffers
+    for(int i = 0; i < defs->blocks_num; i++) {
+        GLuint index = glGetUniformBlockIndex(program->gl_program, defs->block_names[i]);
+        if(index == GL_INVALID_INDEX) {
+            printf("Uniform block \"%s\" is not used in shader %s\n", defs->block_names[i], defs->path);
+            continue;
+        }
+        glUniformBlockBinding(program->gl_program, index, defs->block_bindings[i]);
+    }
+
+    return true;
+}
+
+// Build the program again with a #define for each of the features
+static struct shader_program* shader_program_load_variant(struct shader_program* base,
+        unsigned int features, const struct shader_defs* defs) {
+    char defines[SHADER_FEATURES_MAX * 48] = {0};
+    for(size_t i = 0; i < base->features_num; i++) {
+        if((features & (1u << i)) == 0)
+            continue;
+        strcat(defines, "#define ");
+        strcat(defines, base->features[i]);
+        strcat(defines, "\n");
+    }
+
+    GLuint vertex = compile_shader(defs->path, GL_VERTEX_SHADER, base->vertex->source, defines);
+    GLuint fragment = compile_shader(defs->path, GL_FRAGMENT_SHADER, base->fragment->source, defines);
+    if(vertex == 0 || fragment == 0) {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return NULL;
+    }
+
+    struct shader_program* variant = malloc(sizeof(struct shader_program));
+    if(variant == NULL) {
+        printf("Failed allocating shader program variant\n");
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return NULL;
+    }
+    // The variant shares the definitions, but has GL objects of its own.
+    // It doesn't have any variants itself.
+    *variant = *base;
+    variant->features_num = 0;
+    variant->variants[0] = variant;
+
+    bool linked = shader_program_link(variant, vertex, fragment);
+
+    // The shaders stay alive for as long as the program is
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    if(!linked) {
+        free(variant);
+        return NULL;
+    }
+
+    if(!shader_program_bind(variant, defs)) {
+        glDeleteProgram(variant->gl_program);
+        free(variant);
+        return NULL;
+    }
+
+    return variant;
+}
+
 struct shader_program* shader_program_load_file(const char* path) {
     FILE* file = fopen(path, "r");
     if(file == NULL) {
@@ -232,6 +369,12 @@ struct shader_program* shader_program_load_file(const char* path) {
     size_t uniform_cursor = 0;
     char names[SHADER_UNIFORMS_MAX][64] = {{0}};
 
+    size_t block_cursor = 0;
+    char block_names[SHADER_BLOCKS_MAX][64] = {{0}};
+    GLuint block_bindings[SHADER_BLOCKS_MAX];
+
+    program->features_num = 0;
+
     char* line = NULL;
     size_t line_size = 0;
 
@@ -331,6 +474,35 @@ struct shader_program* shader_program_load_file(const char* path) {
                 continue;
 
             uniform_cursor++;
+        } else if(strcmp(type, "block") == 0) {
+            if(block_cursor == SHADER_BLOCKS_MAX) {
+                printf("Too many uniform blocks in shader %s\n", path);
+                continue;
+            }
+            int binding;
+            int matches = sscanf(value, "%63s %d", block_names[block_cursor], &binding);
+
+            if(matches != 2 || binding < 0) {
+                printf("Couldn't parse the block definition \"%s\"\n", value);
+                continue;
+            }
+            block_bindings[block_cursor] = binding;
+
+            block_cursor++;
+        } else if(strcmp(type, "feature") == 0) {
+            if(program->features_num == SHADER_FEATURES_MAX) {
+                printf("Too many features in shader %s\n", path);
+                continue;
+            }
+            char* name = program->features[program->features_num];
+            int matches = sscanf(value, "%31s", name);
+
+            if(matches != 1) {
+                printf("Couldn't parse the feature definition \"%s\"\n", value);
+                continue;
+            }
+
+            program->features_num++;
         } else {
             printf("Unknown directive \"%s\" in shader file %s, ignoring\n", line, path);
         }
@@ -365,66 +537,83 @@ struct shader_program* shader_program_load_file(const char* path) {
         return NULL;
     }
 
-    shader_program_link(program);
-
     struct shader_type_info* shader_info = get_shader_type_info(shader_type);
     if(shader_info == NULL) {
         printf("Failed to find shader type info for %s\n", shader_type);
         free(shader_type);
-        glDeleteProgram(program->gl_program);
         free(program);
         return NULL;
     }
+    free(shader_type);
 
     program->shader_type_info = shader_info;
+    program->uniforms_num = uniform_cursor;
 
-    program->shader_type = malloc(shader_info->size);
-    if(program->shader_type == NULL) {
-        printf("Failed to allocate space for the shader type\n");
-        free(shader_type);
+    struct shader_defs defs = {
+        .path = path,
+        .names = names,
+        .block_names = block_names,
+        .block_bindings = block_bindings,
+        .blocks_num = block_cursor,
+    };
+
+    if(!shader_program_link(program, program->vertex->gl_shader, program->fragment->gl_shader)) {
+        free(program);
+        return NULL;
+    }
+    if(!shader_program_bind(program, &defs)) {
         glDeleteProgram(program->gl_program);
         free(program);
         return NULL;
     }
 
-    program->uniforms_num = uniform_cursor;
-
-    // Bind the static shadertype members to the shader_value structs
-    for(int i = 0; i < shader_info->member_count; i++) {
-        struct shader_uniform_info* uniform_info = &shader_info->members[i];
-        struct shader_value** field = (struct shader_value**)(program->shader_type + uniform_info->offset);
-        *field = NULL;
-        for(int j = 0; j < uniform_cursor; j++) {
-            if(strcmp(names[j], uniform_info->name) == 0) {
-                *field = &program->uniforms[j];
-                break;
-            }
-        }
-        if(*field == NULL) {
-            printf("Uniform \"%s\" is not defined in shader %s\n", uniform_info->name, path);
-            exit(1);
+    // Every combination of the features gets a program of its own. If one
+    // of them fails we fall back to the plain program rather than failing
+    // the whole thing.
+    program->variants[0] = program;
+    for(unsigned int i = 1; i < (1u << program->features_num); i++) {
+        program->variants[i] = shader_program_load_variant(program, i, &defs);
+        if(program->variants[i] == NULL) {
+            printf("Failed building variant %u of %s, using the plain program\n", i, path);
+            program->variants[i] = program;
         }
     }
 
-    printf("Uniforms in shader \"%s\"\n", program->shader_type_info->name);
-    // Bind the uniforms to the shader program
-    for(int i = 0; i < uniform_cursor; i++) {
-        struct shader_value* uniform = &program->uniforms[i];
-        uniform->gl_uniform = glGetUniformLocation(program->gl_program, names[i]);
-        printf("\tUniform \"%s\" has id %d, required %d\n", names[i], uniform->gl_uniform, uniform->required);
-    }
-
     return program;
 }
 
 void shader_program_unload_file(struct shader_program* asset) {
+    for(unsigned int i = 1; i < (1u << asset->features_num); i++) {
+        struct shader_program* variant = asset->variants[i];
+        if(variant == asset)
+            continue;
+        glDeleteProgram(variant->gl_program);
+        glstate_deletedProgram(variant->gl_program);
+        free(variant->shader_type);
+        free(variant);
+    }
+
     glDeleteProgram(asset->gl_program);
+    glstate_deletedProgram(asset->gl_program);
     free(asset->shader_type);
     Word_t freed;
     JSLFA(freed, asset->attributes);
     free(asset);
 }
 
+struct shader_program* shader_program_variant(struct shader_program* program, unsigned int features) {
+    assert(features < (1u << program->features_num));
+    return program->variants[features];
+}
+
+unsigned int shader_program_feature(const struct shader_program* program, const char* name) {
+    for(size_t i = 0; i < program->features_num; i++) {
+        if(strcmp(program->features[i], name) == 0)
+            return 1u << i;
+    }
+    return 0;
+}
+
 static void set_shader_uniform(const struct shader_value* uniform, const union shader_uniform_value* value) {
     switch(uniform->type) {
         case SHADER_VALUE_BOOL:
@@ -448,6 +637,37 @@ static void set_shader_uniform(const struct shader_value* uniform, const union s
     }
 }
 
+static bool uniform_equal(enum shader_value_type type,
+        const union shader_uniform_value* a, const union shader_uniform_value* b) {
+    switch(type) {
+        case SHADER_VALUE_BOOL:
+            return a->boolean == b->boolean;
+        case SHADER_VALUE_FLOAT:
+            return a->flt == b->flt;
+        case SHADER_VALUE_VEC2:
+            return a->vector.x == b->vector.x && a->vector.y == b->vector.y;
+        case SHADER_VALUE_VEC3:
+            return a->vec3.x == b->vec3.x && a->vec3.y == b->vec3.y
+                && a->vec3.z == b->vec3.z;
+        case SHADER_VALUE_SAMPLER:
+            return a->sampler == b->sampler;
+        case SHADER_VALUE_IGNORED:
+            return true;
+    }
+    return false;
+}
+
+// Uniforms are program state, so the value stays until it's changed. The
+// program has to be in use.
+static void upload_uniform(struct shader_value* uniform, const union shader_uniform_value* value) {
+    if(uniform->uploaded && uniform_equal(uniform->type, &uniform->current, value))
+        return;
+
+    set_shader_uniform(uniform, value);
+    uniform->current = *value;
+    uniform->uploaded = true;
+}
+
 void shader_use(struct shader_program* shader) {
     for(size_t i = 0; i < shader->uniforms_num; i++) {
         const struct shader_value* uniform = &shader->uniforms[i];
@@ -457,37 +677,42 @@ void shader_use(struct shader_program* shader) {
         assert(!uniform->required || uniform->set);
     }
 
-    glUseProgram(shader->gl_program);
+    glstate_useProgram(shader->gl_program);
 
     for(size_t i = 0; i < shader->uniforms_num; i++) {
         struct shader_value* uniform = &shader->uniforms[i];
         if(uniform->set) {
-            set_shader_uniform(uniform, &uniform->value);
+            upload_uniform(uniform, &uniform->value);
         } else if(!uniform->required) {
-            set_shader_uniform(uniform, &uniform->stock);
+            upload_uniform(uniform, &uniform->stock);
         }
         shader_clear_future_uniform(uniform);
     }
 }
 
 void shader_set_uniform_bool(struct shader_value* uniform, bool value) {
-    glUniform1i(uniform->gl_uniform, value);
+    assert(uniform->type == SHADER_VALUE_BOOL);
+    upload_uniform(uniform, &(union shader_uniform_value){.boolean = value});
 }
 
 void shader_set_uniform_float(struct shader_value* uniform, float value) {
-    glUniform1f(uniform->gl_uniform, value);
+    assert(uniform->type == SHADER_VALUE_FLOAT);
+    upload_uniform(uniform, &(union shader_uniform_value){.flt = value});
 }
 
 void shader_set_uniform_vec2(struct shader_value* uniform, const Vector2* value) {
-    glUniform2f(uniform->gl_uniform, value->x, value->y);
+    assert(uniform->type == SHADER_VALUE_VEC2);
+    upload_uniform(uniform, &(union shader_uniform_value){.vector = *value});
 }
 
 void shader_set_uniform_vec3(struct shader_value* uniform, const Vector3* value) {
-    glUniform3f(uniform->gl_uniform, value->x, value->y, value->z);
+    assert(uniform->type == SHADER_VALUE_VEC3);
+    upload_uniform(uniform, &(union shader_uniform_value){.vec3 = *value});
 }
 
 void shader_set_uniform_sampler(struct shader_value* uniform, int value) {
-    glUniform1i(uniform->gl_uniform, value);
+    assert(uniform->type == SHADER_VALUE_SAMPLER);
+    upload_uniform(uniform, &(union shader_uniform_value){.sampler = value});
 }
 
 void shader_set_future_uniform_bool(struct shader_value* uniform, bool value) {
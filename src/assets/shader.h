@@ -9,6 +9,8 @@
 
 struct shader {
     GLuint gl_shader;
+    GLenum type;
+    char* source;
 };
 
 struct shader* vert_shader_load_file(const char* path);
@@ -17,6 +19,9 @@ struct shader* frag_shader_load_file(const char* path);
 void shader_unload_file(struct shader* asset);
 
 #define SHADER_UNIFORMS_MAX 8
+#define SHADER_BLOCKS_MAX 4
+#define SHADER_FEATURES_MAX 3
+#define SHADER_VARIANTS_MAX (1 << SHADER_FEATURES_MAX)
 
 enum shader_value_type {
     SHADER_VALUE_BOOL,
@@ -44,6 +49,10 @@ struct shader_value {
 
     bool set;
     union shader_uniform_value value;
+
+    // What the program holds right now, so unchanged values aren't sent again
+    bool uploaded;
+    union shader_uniform_value current;
 };
 
 struct shader_program {
@@ -56,10 +65,22 @@ struct shader_program {
 
     size_t uniforms_num;
     struct shader_value uniforms[SHADER_UNIFORMS_MAX];
+
+    // Features are #defines the program can be specialized with, the n'th
+    // feature being bit n of the variant index. Every combination is built
+    // when the program is loaded, with the program itself as variant 0.
+    size_t features_num;
+    char features[SHADER_FEATURES_MAX][32];
+    struct shader_program* variants[SHADER_VARIANTS_MAX];
 };
 struct shader_program* shader_program_load_file(const char* path);
 void shader_program_unload_file(struct shader_program* asset);
 
+// Get the variant with the given feature bits
+struct shader_program* shader_program_variant(struct shader_program* program, unsigned int features);
+// Get the bit of a feature, 0 if the program doesn't have it
+unsigned int shader_program_feature(const struct shader_program* program, const char* name);
+
 void shader_use(struct shader_program* shader);
 
 void shader_set_uniform_bool(struct shader_value* location, bool value);
@@ -17,6 +17,7 @@ void atoms_init(struct Atoms* atoms, struct X11Context* context) {
     atoms->atom_ewmh_active_win = get_atom(context, "_NET_ACTIVE_WINDOW");
     atoms->atom_compton_shadow = get_atom(context, "_COMPTON_SHADOW");
     atoms->atom_bypass = get_atom(context, "_NET_WM_BYPASS_COMPOSITOR");
+    atoms->atom_opaque_region = get_atom(context, "_NET_WM_OPAQUE_REGION");
 
     atoms->atom_win_type = get_atom(context, "_NET_WM_WINDOW_TYPE");
     atoms->atoms_wintypes[WINTYPE_UNKNOWN] = 0;
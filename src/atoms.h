@@ -31,6 +31,8 @@ struct Atoms {
   Atom atom_compton_shadow;
   // Atom of property _NET_BYPASS_COMPOSITOR.
   Atom atom_bypass;
+  // Atom of property _NET_WM_OPAQUE_REGION.
+  Atom atom_opaque_region;
   // Atom of property _NET_WM_WINDOW_TYPE.
   Atom atom_win_type;
   // Array of atoms of all possible window types.
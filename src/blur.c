@@ -5,6 +5,7 @@
 #include "assets/shader.h"
 #include "shaders/shaderinfo.h"
 #include "renderutil.h"
+#include "glstate.h"
 #include "window.h"
 #include "textureeffects.h"
 #include "framebuffer.h"
@@ -13,7 +14,7 @@
 
 void blur_init(struct blur* blur) {
     glGenVertexArrays(1, &blur->array);
-    glBindVertexArray(blur->array);
+    glstate_bindVertexArray(blur->array);
 
     // Generate FBO if needed
     if(!framebuffer_initialized(&blur->fbo)) {
@@ -26,41 +27,23 @@ void blur_init(struct blur* blur) {
 
 void blur_destroy(struct blur* blur) {
     glDeleteVertexArrays(1, &blur->array);
+    glstate_deletedVertexArray(blur->array);
 }
 
 bool blur_cache_resize(glx_blur_cache_t* cache, const Vector2* size) {
-    assert(renderbuffer_initialized(&cache->stencil));
-    assert(texture_initialized(&cache->texture[0]));
-    assert(texture_initialized(&cache->texture[1]));
+    assert(texture_initialized(&cache->texture));
 
     cache->size = *size;
 
-    renderbuffer_resize(&cache->stencil, size);
-    texture_resize(&cache->texture[0], size);
-    texture_resize(&cache->texture[1], size);
+    texture_resize(&cache->texture, size, cache->texture.format);
     return true;
 }
 
 int blur_cache_init(glx_blur_cache_t* cache) {
-    assert(!renderbuffer_initialized(&cache->stencil));
-    assert(!texture_initialized(&cache->texture[0]));
-    assert(!texture_initialized(&cache->texture[1]));
+    assert(!texture_initialized(&cache->texture));
 
-    if(renderbuffer_stencil_init(&cache->stencil, NULL) != 0) {
-        printf("Failed allocating stencil for cache\n");
-        return 1;
-    }
-
-    if(texture_init(&cache->texture[0], GL_TEXTURE_2D, NULL) != 0) {
-        printf("Failed allocating texture for cache\n");
-        renderbuffer_delete(&cache->stencil);
-        return 1;
-    }
-
-    if(texture_init(&cache->texture[1], GL_TEXTURE_2D, NULL) != 0) {
+    if(texture_init(&cache->texture, GL_TEXTURE_2D, NULL, TEXTUREFORMAT_RGBA8) != 0) {
         printf("Failed allocating texture for cache\n");
-        renderbuffer_delete(&cache->stencil);
-        texture_delete(&cache->texture[0]);
         return 1;
     }
 
@@ -68,11 +51,7 @@ int blur_cache_init(glx_blur_cache_t* cache) {
 }
 
 void blur_cache_delete(glx_blur_cache_t* cache) {
-    assert(renderbuffer_initialized(&cache->stencil));
-    assert(texture_initialized(&cache->texture[0]));
-    assert(texture_initialized(&cache->texture[1]));
+    assert(texture_initialized(&cache->texture));
 
-    renderbuffer_delete(&cache->stencil);
-    texture_delete(&cache->texture[0]);
-    texture_delete(&cache->texture[1]);
+    texture_delete(&cache->texture);
 }
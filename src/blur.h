@@ -17,9 +17,9 @@ struct blur {
 };
 
 typedef struct glx_blur_cache {
-    /// Textures used for blurring.
-    struct Texture texture[2];
-    struct RenderBuffer stencil;
+    /// The blurred background. The blurring itself happens in a borrowed
+    /// render target.
+    struct Texture texture;
     Vector2 size;
     /// Width of the textures.
     int width;
@@ -1220,6 +1220,106 @@ c2_get_atom_type(const c2_l_t *pleaf) {
     return AnyPropertyType;
 }
 
+/**
+ * Get the window a leaf condition targets.
+ */
+static Window c2_leaf_target(session_t *ps, win *w, const c2_l_t *pleaf) {
+    win_id wad = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
+
+    if(pleaf->tgt_onframe) {
+        struct HasClientComponent* client = swiss_getComponent(&ps->win_list, COMPONENT_HAS_CLIENT, wad);
+        return client->id;
+    }
+
+    struct TracksWindowComponent* window = swiss_getComponent(&ps->win_list, COMPONENT_TRACKS_WINDOW, wad);
+    return window->id;
+}
+
+/**
+ * Get the integer value of a raw window property, preferring the prefetched
+ * reply if there is one.
+ *
+ * @return true if the property exists
+ */
+static bool c2_get_prop_int(session_t *ps, Window wid, const c2_l_t *pleaf,
+        int idx, long *ptgt) {
+    size_t request = xbatch_findProp(&ps->xbatch, wid, pleaf->tgtatom, idx, 1L,
+            c2_get_atom_type(pleaf), pleaf->format);
+    if (request != XBATCH_NONE) {
+        const winprop_t *prop = xbatch_propReply(&ps->xbatch, request);
+        if (!prop->nitems)
+            return false;
+        *ptgt = winprop_get_int(*prop);
+        return true;
+    }
+
+    winprop_t prop = wid_get_prop_adv(&ps->xcontext, wid, pleaf->tgtatom,
+            idx, 1L, c2_get_atom_type(pleaf), pleaf->format);
+    bool found = prop.nitems != 0;
+    if (found)
+        *ptgt = winprop_get_int(prop);
+    free_winprop(&prop);
+    return found;
+}
+
+/**
+ * Get the string list of a raw window property, preferring the prefetched
+ * reply if there is one.
+ */
+static bool c2_get_prop_text(session_t *ps, Window wid, const c2_l_t *pleaf,
+        char ***pstrlst, int *pnstr) {
+    size_t request = xbatch_findProp(&ps->xbatch, wid, pleaf->tgtatom, 0L,
+            XBATCH_PROP_ALL, AnyPropertyType, 0);
+    if (request != XBATCH_NONE)
+        return xbatch_textReply(&ps->xbatch, request, pstrlst, pnstr);
+
+    return wid_get_text_prop(ps, wid, pleaf->tgtatom, pstrlst, pnstr);
+}
+
+/**
+ * Issue the requests for the raw properties a leaf condition will read.
+ */
+static void c2_prefetch_once(session_t *ps, win *w, const c2_ptr_t cond,
+        struct XBatch *batch) {
+    if (cond.isbranch) {
+        if (!cond.b)
+            return;
+        c2_prefetch_once(ps, w, cond.b->opr1, batch);
+        c2_prefetch_once(ps, w, cond.b->opr2, batch);
+        return;
+    }
+
+    const c2_l_t *pleaf = cond.l;
+    if (!pleaf || pleaf->predef)
+        return;
+
+    Window wid = c2_leaf_target(ps, w, pleaf);
+    if (!wid)
+        return;
+
+    const int idx = (pleaf->index < 0 ? 0: pleaf->index);
+
+    if (C2_L_PTSTRING == pleaf->ptntype && C2_L_TATOM != pleaf->type) {
+        xbatch_prop(batch, wid, pleaf->tgtatom, 0L, XBATCH_PROP_ALL,
+                AnyPropertyType, 0);
+    } else {
+        xbatch_prop(batch, wid, pleaf->tgtatom, idx, 1L,
+                c2_get_atom_type(pleaf), pleaf->format);
+    }
+}
+
+/**
+ * Issue the requests for all raw properties matching a window against a
+ * condition list will read, so matching doesn't wait on the server for
+ * every leaf.
+ */
+void c2_prefetch(session_t *ps, win *w, const c2_lptr_t *condlst,
+        struct XBatch *batch) {
+    for (; condlst; condlst = condlst->next) {
+        c2_prefetch_once(ps, w, condlst->ptr, batch);
+    }
+}
+
 /**
  * Match a window against a single leaf window condition.
  *
@@ -1230,15 +1330,8 @@ static void c2_match_once_leaf(session_t *ps, win *w, const c2_l_t *pleaf,
     assert(pleaf);
 
     win_id wad = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
-    struct TracksWindowComponent* window = swiss_getComponent(&ps->win_list, COMPONENT_TRACKS_WINDOW, wad);
 
-    Window wid;
-    if(pleaf->tgt_onframe) {
-        struct HasClientComponent* client = swiss_getComponent(&ps->win_list, COMPONENT_HAS_CLIENT, wad);
-        wid = client->id;
-    } else {
-        wid = window->id;
-    }
+    Window wid = c2_leaf_target(ps, w, pleaf);
 
     // Return if wid is missing
     if (!pleaf->predef && !wid)
@@ -1295,13 +1388,8 @@ static void c2_match_once_leaf(session_t *ps, win *w, const c2_l_t *pleaf,
                 }
                 // A raw window property
                 else {
-                    winprop_t prop = wid_get_prop_adv(&ps->xcontext, wid, pleaf->tgtatom,
-                            idx, 1L, c2_get_atom_type(pleaf), pleaf->format);
-                    if (prop.nitems) {
+                    if (c2_get_prop_int(ps, wid, pleaf, idx, &tgt))
                         *perr = false;
-                        tgt = winprop_get_int(prop);
-                    }
-                    free_winprop(&prop);
                 }
 
                 if (*perr)
@@ -1341,22 +1429,20 @@ static void c2_match_once_leaf(session_t *ps, win *w, const c2_l_t *pleaf,
                 }
                 // If it's an atom type property, convert atom to string
                 else if (C2_L_TATOM == pleaf->type) {
-                    winprop_t prop = wid_get_prop_adv(&ps->xcontext, wid, pleaf->tgtatom,
-                            idx, 1L, c2_get_atom_type(pleaf), pleaf->format);
-                    Atom atom = winprop_get_int(prop);
+                    long atom = 0;
+                    c2_get_prop_int(ps, wid, pleaf, idx, &atom);
                     if (atom) {
                         tgt_free = XGetAtomName(ps->dpy, atom);
                     }
                     if (tgt_free) {
                         tgt = tgt_free;
                     }
-                    free_winprop(&prop);
                 }
                 // Otherwise, just fetch the string list
                 else {
                     char **strlst = NULL;
                     int nstr;
-                    if (wid_get_text_prop(ps, wid, pleaf->tgtatom, &strlst,
+                    if (c2_get_prop_text(ps, wid, pleaf, &strlst,
                                 &nstr) && nstr > idx) {
                         tgt_free = mstrcpy(strlst[idx]);
                         tgt = tgt_free;
@@ -227,47 +227,6 @@ typedef GLXContext (*f_glXCreateContextAttribsARB) (Display *dpy,
 /* typedef void (*GLDEBUGPROC) (GLenum source, GLenum type, */
 /*     GLuint id, GLenum severity, GLsizei length, const GLchar* message, */
 /*     GLvoid* userParam); */
-#ifdef CONFIG_GLX_SYNC
-// Looks like duplicate typedef of the same type is safe?
-typedef int64_t GLint64;
-typedef uint64_t GLuint64;
-typedef struct __GLsync *GLsync;
-
-#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
-#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
-#endif
-
-#ifndef GL_TIMEOUT_IGNORED
-#define GL_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
-#endif
-
-#ifndef GL_ALREADY_SIGNALED
-#define GL_ALREADY_SIGNALED 0x911A
-#endif
-
-#ifndef GL_TIMEOUT_EXPIRED
-#define GL_TIMEOUT_EXPIRED 0x911B
-#endif
-
-#ifndef GL_CONDITION_SATISFIED
-#define GL_CONDITION_SATISFIED 0x911C
-#endif
-
-#ifndef GL_WAIT_FAILED
-#define GL_WAIT_FAILED 0x911D
-#endif
-
-typedef GLsync (*f_FenceSync) (GLenum condition, GLbitfield flags);
-typedef GLboolean (*f_IsSync) (GLsync sync);
-typedef void (*f_DeleteSync) (GLsync sync);
-typedef GLenum (*f_ClientWaitSync) (GLsync sync, GLbitfield flags,
-    GLuint64 timeout);
-typedef void (*f_WaitSync) (GLsync sync, GLbitfield flags,
-    GLuint64 timeout);
-typedef GLsync (*f_ImportSyncEXT) (GLenum external_sync_type,
-    GLintptr external_sync, GLbitfield flags);
-#endif
-
 #ifdef DEBUG_GLX_MARK
 typedef void (*f_StringMarkerGREMEDY) (GLsizei len, const void *string);
 typedef void (*f_FrameTerminatorGREMEDY) (void);
@@ -899,12 +858,10 @@ static inline win * find_toplevel(session_t *ps, Window id) {
     if (!id)
         return NULL;
 
-    for_components(it, &ps->win_list,
-            COMPONENT_STATEFUL, COMPONENT_HAS_CLIENT, CQ_END) {
-        struct HasClientComponent* client = swiss_getComponent(&ps->win_list, COMPONENT_HAS_CLIENT, it.id);
-        struct StatefulComponent* stateful = swiss_getComponent(&ps->win_list, COMPONENT_STATEFUL, it.id);
+    for_indexed(it, &ps->win_list, COMPONENT_HAS_CLIENT, id) {
+        struct StatefulComponent* stateful = swiss_godComponent(&ps->win_list, COMPONENT_STATEFUL, it.id);
 
-        if (client->id == id && stateful->state != STATE_DESTROYING)
+        if (stateful != NULL && stateful->state != STATE_DESTROYING)
             return swiss_getComponent(&ps->win_list, COMPONENT_MUD, it.id);
     }
 
@@ -1074,11 +1031,6 @@ vsync_deinit(session_t *ps);
  */
 ///@{
 
-#ifdef CONFIG_GLX_SYNC
-void
-xr_glx_sync(session_t *ps, Drawable d, XSyncFence *pfence);
-#endif
-
 bool
 glx_init(session_t *ps, bool need_render);
 
@@ -1220,6 +1172,10 @@ c2_matchd(session_t *ps, win *w, const c2_lptr_t *condlst,
 
 #define c2_match(ps, w, condlst, cache) c2_matchd((ps), (w), (condlst), \
     (cache), NULL)
+
+void
+c2_prefetch(session_t *ps, win *w, const c2_lptr_t *condlst,
+    struct XBatch *batch);
 #endif
 
 ///@}
@@ -24,6 +24,7 @@
 #include "windowlist.h"
 #include "blur.h"
 #include "shadow.h"
+#include "gpumem.h"
 #include "xtexture.h"
 #include "timer.h"
 #include "timeout.h"
@@ -31,8 +32,10 @@
 
 #include "assets/assets.h"
 #include "assets/shader.h"
+#include "assets/handles.h"
 
 #include "renderutil.h"
+#include "glstate.h"
 
 #include "shaders/shaderinfo.h"
 
@@ -78,11 +81,8 @@ static inline win * find_win(session_t *ps, Window id) {
   if (!id)
     return NULL;
 
-  for_components(it, &ps->win_list,
-      COMPONENT_MUD, COMPONENT_TRACKS_WINDOW, CQ_END) {
-      struct TracksWindowComponent* w = swiss_getComponent(&ps->win_list, COMPONENT_TRACKS_WINDOW, it.id);
-
-      if (w->id == id)
+  for_indexed(it, &ps->win_list, COMPONENT_TRACKS_WINDOW, id) {
+      if (swiss_hasComponent(&ps->win_list, COMPONENT_MUD, it.id))
           return swiss_getComponent(&ps->win_list, COMPONENT_MUD, it.id);
   }
 
@@ -243,26 +243,7 @@ static void win_recheck_client(session_t *ps, win *w);
 
 static void configure_win(session_t *ps, XConfigureEvent *ce);
 
-static bool wid_get_name(session_t *ps, Window w, char **name);
-
-static bool wid_get_role(session_t *ps, Window w, char **role);
-
-static int win_get_prop_str(session_t *ps, win *w, char **tgt,
-        bool (*func_wid_get_prop_str)(session_t *ps, Window wid, char **tgt));
-
-static int win_get_name(session_t *ps, win *w) {
-    int ret = win_get_prop_str(ps, w, &w->name, wid_get_name);
-
-    return ret;
-}
-
-static int win_get_role(session_t *ps, win *w) {
-    int ret = win_get_prop_str(ps, w, &w->role, wid_get_role);
-
-    return ret;
-}
-
-static bool win_get_class(session_t *ps, win *w);
+static struct WdataChangedComponent* win_wdata_changed(session_t *ps, win_id wid);
 
 #ifdef DEBUG_EVENTS
 static int ev_serial(XEvent *ev);
@@ -669,7 +650,7 @@ static bool get_root_tile(session_t *ps) {
 
     XWindowAttributes attribs;
     XGetWindowAttributes(ps->xcontext.display, ps->root, &attribs);
-    GLXFBConfig* fbconfig = xorgContext_selectConfig(&ps->xcontext, XVisualIDFromVisual(attribs.visual));
+    const glx_fbconfig_t* fbconfig = xorgContext_selectConfig(&ps->xcontext, XVisualIDFromVisual(attribs.visual));
 
     if(!xtexture_bind(&ps->root_texture, fbconfig, pixmap)) {
         printf_errf("Failed binding the root texture to gl");
@@ -694,13 +675,13 @@ static void paint_root(session_t *ps) {
 
     glViewport(0, 0, ps->root_size.x, ps->root_size.y);
 
-    glEnable(GL_DEPTH_TEST);
+    glstate_enable(GL_DEPTH_TEST);
 
-    struct face* face = assets_load("window.face");
+    struct face* face = asset_handles.window_face;
     Vector3 pos = {{0, 0, 0.9999}};
     draw_tex(face, &ps->root_texture.texture, &pos, &ps->root_size);
 
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_DEPTH_TEST);
 }
 
 /**
@@ -803,6 +784,17 @@ static void map_win(session_t *ps, win_id wid) {
         attribs.width + w->border_size * 2,
         attribs.height + w->border_size * 2,
     }};
+    map->visual = XVisualIDFromVisual(attribs.visual);
+    map->bypassRequest = XBATCH_NONE;
+
+    // The client was marked before we were mapped, so the strings haven't
+    // been fetched yet
+    if (ps->o.track_wdata) {
+        struct WdataChangedComponent* wdataChanged = win_wdata_changed(ps, wid);
+        wdataChanged->name = true;
+        wdataChanged->class = true;
+        wdataChanged->role = true;
+    }
 
     struct StatefulComponent* stateful = swiss_getComponent(&ps->win_list, COMPONENT_STATEFUL, wid);
     stateful->state = STATE_WAITING;
@@ -882,12 +874,14 @@ win_mark_client(session_t *ps, win *w, Window client) {
   XFlush(ps->dpy);
 
   swiss_ensureComponent(&ps->win_list, COMPONENT_WINTYPE_CHANGE, wid);
+  swiss_ensureComponent(&ps->win_list, COMPONENT_OPAQUE_REGION_CHANGE, wid);
 
   // Get window name and class if we are tracking them
   if (ps->o.track_wdata) {
-    win_get_name(ps, w);
-    win_get_class(ps, w);
-    win_get_role(ps, w);
+    struct WdataChangedComponent* wdataChanged = win_wdata_changed(ps, wid);
+    wdataChanged->name = true;
+    wdataChanged->class = true;
+    wdataChanged->role = true;
   }
 
   // Update everything related to conditions
@@ -907,6 +901,10 @@ static void win_unmark_client(session_t *ps, win *w) {
     // Recheck event mask
     XSelectInput(ps->dpy, client->id, determine_evmask(ps, client->id, WIN_EVMODE_UNKNOWN));
 
+    // The opaque region was set by the client
+    if(swiss_hasComponent(&ps->win_list, COMPONENT_OPAQUE_REGION, wid))
+        swiss_removeComponent(&ps->win_list, COMPONENT_OPAQUE_REGION, wid);
+
     swiss_removeComponent(&ps->win_list, COMPONENT_HAS_CLIENT, wid);
 }
 
@@ -1025,6 +1023,7 @@ add_win(session_t *ps, Window id) {
   {
       struct ShapedComponent* shaped = swiss_addComponent(&ps->win_list, COMPONENT_SHAPED, slot);
       shaped->face = NULL;
+      shaped->rectangular = false;
   }
   swiss_addComponent(&ps->win_list, COMPONENT_SHAPE_DAMAGED, slot);
 
@@ -1078,6 +1077,24 @@ add_win(session_t *ps, Window id) {
   return true;
 }
 
+// Damage the screen everywhere the window is currently drawn
+static void
+damage_window(session_t *ps, win_id wid) {
+    Swiss* em = &ps->win_list;
+    if(!swiss_hasComponent(em, COMPONENT_PHYSICAL, wid))
+        return;
+
+    struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, wid);
+    screendamage_add(&ps->screen_damage, &physical->position, &physical->size);
+
+    if(swiss_hasComponent(em, COMPONENT_SHADOW, wid)) {
+        struct glx_shadow_cache* shadow = swiss_getComponent(em, COMPONENT_SHADOW, wid);
+        Vector2 pos = physical->position;
+        vec2_sub(&pos, &shadow->border);
+        screendamage_add(&ps->screen_damage, &pos, &shadow->effect.size);
+    }
+}
+
 static void
 restack_win(session_t *ps, win *w, Window new_above) {
     win_id w_id = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
@@ -1117,6 +1134,7 @@ restack_win(session_t *ps, win *w, Window new_above) {
         return;
 
     vector_circulate(&ps->order, w_loc, above_loc);
+    damage_window(ps, w_id);
 }
 
 static bool
@@ -1130,6 +1148,8 @@ configure_win(session_t *ps, XConfigureEvent *ce) {
     ps->root_size = (Vector2) {{
         ce->width, ce->height
     }};
+    ps->cutout_dirty = true;
+    screendamage_resize(&ps->screen_damage, &ps->root_size);
 
     // Re-redirect screen if required
     if (ps->o.reredir_on_root_change) {
@@ -1247,6 +1267,7 @@ static void destroy_win(session_t *ps, win_id wid) {
 
 static inline void
 root_damaged(session_t *ps) {
+  screendamage_addAll(&ps->screen_damage);
   if (ps->root_texture.bound) {
     xtexture_unbind(&ps->root_texture);
   }
@@ -1270,13 +1291,16 @@ static void damage_win(session_t *ps, XDamageNotifyEvent *de) {
   if (!win_mapped(&ps->win_list, wid))
         return;
 
-    //Reset the XDamage region, so we continue to recieve new damage
-    XDamageSubtract(ps->dpy, w->damage, None, None);
+    // The damaged region is fetched (and reset, so we continue to recieve new
+    // damage) with the other requests of the frame
+    win_damageContentsPending(&ps->win_list, wid);
 
-    swiss_ensureComponent(&ps->win_list, COMPONENT_CONTENTS_DAMAGED, wid);
+    // The shadow is built from the alpha of the contents, which can't change
+    // when the window has no alpha channel
     // @CLEANUP: We shouldn't damage the shadow here. It's more of an update
     // thing. Maybe make a function for quick or?
-    swiss_ensureComponent(&ps->win_list, COMPONENT_SHADOW_DAMAGED, wid);
+    if(!win_opaqueContents(&ps->win_list, wid))
+        swiss_ensureComponent(&ps->win_list, COMPONENT_SHADOW_DAMAGED, wid);
 }
 
 static int xerror(Display __attribute__((unused)) *dpy, XErrorEvent *ev) {
@@ -1449,134 +1473,19 @@ bool wid_get_text_prop(session_t *ps, Window wid, Atom prop,
 }
 
 /**
- * Get the name of a window from window ID.
- */
-static bool
-wid_get_name(session_t *ps, Window wid, char **name) {
-  XTextProperty text_prop = { NULL, None, 0, 0 };
-  char **strlst = NULL;
-  int nstr = 0;
-
-  if (!(wid_get_text_prop(ps, wid, ps->atoms.atom_name_ewmh, &strlst, &nstr))) {
-#ifdef DEBUG_WINDATA
-    printf_dbgf("(%#010lx): _NET_WM_NAME unset, falling back to WM_NAME.\n", wid);
-#endif
-
-    if (!(XGetWMName(ps->dpy, wid, &text_prop) && text_prop.value)) {
-      return false;
-    }
-    if (Success !=
-        XmbTextPropertyToTextList(ps->dpy, &text_prop, &strlst, &nstr)
-        || !nstr || !strlst) {
-      if (strlst)
-        XFreeStringList(strlst);
-      cxfree(text_prop.value);
-      return false;
-    }
-    cxfree(text_prop.value);
-  }
-
-  *name = mstrcpy(strlst[0]);
-
-  XFreeStringList(strlst);
-
-  return true;
-}
-
-/**
- * Get the role of a window from window ID.
- */
-static bool
-wid_get_role(session_t *ps, Window wid, char **role) {
-  char **strlst = NULL;
-  int nstr = 0;
-
-  if (!wid_get_text_prop(ps, wid, ps->atoms.atom_role, &strlst, &nstr)) {
-    return false;
-  }
-
-  *role = mstrcpy(strlst[0]);
-
-  XFreeStringList(strlst);
-
-  return true;
-}
-
-/**
- * Retrieve a string property of a window and update its <code>win</code>
- * structure.
- */
-static int
-win_get_prop_str(session_t *ps, win *w, char **tgt,
-    bool (*func_wid_get_prop_str)(session_t *ps, Window wid, char **tgt)) {
-  int ret = -1;
-  char *prop_old = *tgt;
-
-  win_id wid = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
-
-  if(swiss_hasComponent(&ps->win_list, COMPONENT_HAS_CLIENT, wid))
-    return false;
-
-  struct HasClientComponent* client = swiss_getComponent(&ps->win_list, COMPONENT_HAS_CLIENT, wid);
-  ret = func_wid_get_prop_str(ps, client->id, tgt);
-
-  // Return -1 if func_wid_get_prop_str() failed, 0 if the property
-  // doesn't change, 1 if it changes
-  if (!ret)
-    ret = -1;
-  else if (prop_old && !strcmp(*tgt, prop_old))
-    ret = 0;
-  else
-    ret = 1;
-
-  // Keep the old property if there's no new one
-  if (*tgt != prop_old)
-    free(prop_old);
-
-  return ret;
-}
-
-/**
- * Retrieve the <code>WM_CLASS</code> of a window and update its
- * <code>win</code> structure.
+ * Mark the strings of a window as changed, so they are refetched next frame.
+ *
+ * @return the change component, for setting which strings have changed
  */
-static bool
-win_get_class(session_t *ps, win *w) {
-  char **strlst = NULL;
-  int nstr = 0;
+static struct WdataChangedComponent* win_wdata_changed(session_t *ps, win_id wid) {
+    if (swiss_hasComponent(&ps->win_list, COMPONENT_WDATA_CHANGE, wid))
+        return swiss_getComponent(&ps->win_list, COMPONENT_WDATA_CHANGE, wid);
 
-  win_id wid = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
-
-  if(swiss_hasComponent(&ps->win_list, COMPONENT_HAS_CLIENT, wid))
-    return false;
-
-
-
-  // Free and reset old strings
-  free(w->class_instance);
-  free(w->class_general);
-  w->class_instance = NULL;
-  w->class_general = NULL;
-
-  struct HasClientComponent* client = swiss_getComponent(&ps->win_list, COMPONENT_HAS_CLIENT, wid);
-  if (!wid_get_text_prop(ps, client->id, ps->atoms.atom_class, &strlst, &nstr))
-    return false;
-
-  // Copy the strings if successful
-  w->class_instance = mstrcpy(strlst[0]);
-
-  if (nstr > 1)
-    w->class_general = mstrcpy(strlst[1]);
-
-  XFreeStringList(strlst);
-
-#ifdef DEBUG_WINDATA
-  printf_dbgf("(%#010lx): client = %#010lx, "
-      "instance = \"%s\", general = \"%s\"\n",
-      w->id, client->id, w->class_instance, w->class_general);
-#endif
-
-  return true;
+    struct WdataChangedComponent* wdataChanged = swiss_addComponent(&ps->win_list, COMPONENT_WDATA_CHANGE, wid);
+    wdataChanged->name = false;
+    wdataChanged->class = false;
+    wdataChanged->role = false;
+    return wdataChanged;
 }
 
 #ifdef CONFIG_DBUS
@@ -1964,12 +1873,21 @@ ev_property_notify(session_t *ps, XPropertyEvent *ev) {
             }
         }
 
+        if (ev->atom == ps->atoms.atom_opaque_region) {
+            win *w = find_toplevel(ps, ev->window);
+            if (w) {
+                win_id wid = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
+                swiss_ensureComponent(&ps->win_list, COMPONENT_OPAQUE_REGION_CHANGE, wid);
+            }
+        }
+
         // If name changes
         if (ps->o.track_wdata
                 && (ps->atoms.atom_name == ev->atom || ps->atoms.atom_name_ewmh == ev->atom)) {
             win *w = find_toplevel(ps, ev->window);
-            if (w && 1 == win_get_name(ps, w)) {
-                /* win_on_factor_change(ps, w); */
+            if (w) {
+                win_id wid = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
+                win_wdata_changed(ps, wid)->name = true;
             }
         }
 
@@ -1977,16 +1895,17 @@ ev_property_notify(session_t *ps, XPropertyEvent *ev) {
         if (ps->o.track_wdata && ps->atoms.atom_class == ev->atom) {
             win *w = find_toplevel(ps, ev->window);
             if (w) {
-                win_get_class(ps, w);
-                /* win_on_factor_change(ps, w); */
+                win_id wid = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
+                win_wdata_changed(ps, wid)->class = true;
             }
         }
 
         // If role changes
         if (ps->o.track_wdata && ps->atoms.atom_role == ev->atom) {
             win *w = find_toplevel(ps, ev->window);
-            if (w && 1 == win_get_role(ps, w)) {
-                /* win_on_factor_change(ps, w); */
+            if (w) {
+                win_id wid = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
+                win_wdata_changed(ps, wid)->role = true;
             }
         }
 
@@ -2033,6 +1952,120 @@ static void ev_screen_change_notify(session_t *ps, XRRScreenChangeNotifyEvent __
         cxinerama_upd_scrs(ps);
 }
 
+// X never sends events with type 0 (that's an error), so we use it to mark
+// events we have coalesced away.
+#define EV_DROPPED 0
+
+#define COALESCE_DAMAGE (1 << 0)
+#define COALESCE_CONFIGURE (1 << 1)
+#define COALESCE_UNMAP (1 << 2)
+
+struct EventCoalesce {
+    uint8_t seen;
+    // Above sibling of the latest ConfigureNotify
+    Window above;
+    // Index of the latest UnmapNotify
+    size_t unmap;
+};
+
+/**
+ * Drop events in a batch that are superseded by later events for the same
+ * window.
+ *
+ * We walk the batch backwards, so the first event we see for a window is
+ * the newest one.
+ * - DamageNotify: Only the newest one is needed, we reset the whole damage
+ *   region anyway.
+ * - ConfigureNotify: Older events with the same above sibling are pure
+ *   moves/resizes, which are overridden by the newer one. Restacks are kept
+ *   because they depend on the order of everything else.
+ * - MapNotify followed by UnmapNotify on an unmapped window: The window was
+ *   never visible to us, so both are dropped.
+ */
+static void ev_coalesce(session_t *ps, Vector* events) {
+    Vector* state = &ps->event_coalesce;
+    vector_clear(state);
+    struct EventCoalesce* entries = vector_reserve(state, ps->win_list.capacity);
+    memset(entries, 0, sizeof(struct EventCoalesce) * ps->win_list.capacity);
+
+    size_t index;
+    XEvent* ev = vector_getLast(events, &index);
+    while(ev != NULL) {
+        Window wid = None;
+        switch (ev->type) {
+            case ConfigureNotify:
+                wid = ev->xconfigure.window;
+                break;
+            case MapNotify:
+                wid = ev->xmap.window;
+                break;
+            case UnmapNotify:
+                wid = ev->xunmap.window;
+                break;
+            case CreateNotify:
+                wid = ev->xcreatewindow.window;
+                break;
+            case DestroyNotify:
+                wid = ev->xdestroywindow.window;
+                break;
+            case ReparentNotify:
+                wid = ev->xreparent.window;
+                break;
+            default:
+                if (isdamagenotify(ps, ev))
+                    wid = ((XDamageNotifyEvent *)ev)->drawable;
+                break;
+        }
+
+        win* w = find_win(ps, wid);
+        if(w == NULL) {
+            ev = vector_getPrev(events, &index);
+            continue;
+        }
+        win_id slot = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
+        struct EventCoalesce* entry = &entries[slot];
+
+        switch (ev->type) {
+            case ConfigureNotify:
+                if((entry->seen & COALESCE_CONFIGURE) && entry->above == ev->xconfigure.above) {
+                    ev->type = EV_DROPPED;
+                    break;
+                }
+                entry->seen |= COALESCE_CONFIGURE;
+                entry->above = ev->xconfigure.above;
+                break;
+            case UnmapNotify:
+                entry->seen |= COALESCE_UNMAP;
+                entry->unmap = index;
+                break;
+            case MapNotify:
+                if((entry->seen & COALESCE_UNMAP) && !win_mapped(&ps->win_list, slot)) {
+                    XEvent* unmap = vector_get(events, entry->unmap);
+                    unmap->type = EV_DROPPED;
+                    ev->type = EV_DROPPED;
+                }
+                entry->seen &= ~COALESCE_UNMAP;
+                break;
+            case CreateNotify:
+            case DestroyNotify:
+            case ReparentNotify:
+                // Events before these might refer to another incarnation of
+                // the window
+                entry->seen = 0;
+                break;
+            default:
+                if(entry->seen & COALESCE_DAMAGE) {
+                    ev->type = EV_DROPPED;
+                    break;
+                }
+                entry->seen |= COALESCE_DAMAGE;
+                break;
+        }
+
+        ev = vector_getPrev(events, &index);
+    }
+}
+
 static void
 ev_handle(session_t *ps, XEvent *ev) {
   if ((ev->type & 0x7f) != KeymapNotify) {
@@ -2081,6 +2114,12 @@ ev_handle(session_t *ps, XEvent *ev) {
       ev_circulate_notify(ps, (XCirculateEvent *)ev);
       break;
     case Expose:
+      {
+        // Whatever was drawn there is gone
+        XExposeEvent *ee = (XExposeEvent *)ev;
+        screendamage_add(&ps->screen_damage,
+            &(Vector2){{ee->x, ee->y}}, &(Vector2){{ee->width, ee->height}});
+      }
       break;
     case PropertyNotify:
       ev_property_notify(ps, (XPropertyEvent *)ev);
@@ -2261,6 +2300,11 @@ usage(int ret) {
     "--blur-background-exclude condition\n"
     "  Exclude conditions for background blur.\n"
     "\n"
+    "--gpu-memory-budget megabytes\n"
+    "  Free the cached textures of windows that can't be seen when using\n"
+    "  more video memory than this. They are redrawn once the windows\n"
+    "  are visible again. Defaults to 0, which means no budget.\n"
+    "\n"
     "--invert-color-include condition\n"
     "  Specify a list of conditions of windows that should be painted with\n"
     "  inverted color. Resource-hogging, and is not well tested.\n"
@@ -2285,12 +2329,18 @@ usage(int ret) {
     "--glx-swap-method undefined/copy/exchange/3/4/5/6/buffer-age\n"
     "  GLX backend: GLX buffer swap method we assume. Could be\n"
     "  undefined (0), copy (1), exchange (2), 3-6, or buffer-age (-1).\n"
-    "  \"undefined\" is the slowest and the safest, and the default value.\n"
+    "  \"undefined\" is the slowest and the safest.\n"
     "  1 is fastest, but may fail on some drivers, 2-6 are gradually slower\n"
     "  but safer (6 is still faster than 0). -1 means auto-detect using\n"
-    "  GLX_EXT_buffer_age, supported by some drivers. Useless with\n"
+    "  GLX_EXT_buffer_age, supported by some drivers, and falls back to\n"
+    "  \"undefined\" otherwise. Defaults to buffer-age. Useless with\n"
     "  --glx-use-copysubbuffermesa.\n"
     "\n"
+    "--glx-use-copysubbuffermesa\n"
+    "  GLX backend: Use MESA_copy_sub_buffer to present only the damaged\n"
+    "  part of the screen. May break VSync and is not available on some\n"
+    "  drivers.\n"
+    "\n"
 #undef WARNING
 #ifndef CONFIG_DBUS
 #define WARNING WARNING_DISABLED
@@ -2841,10 +2891,14 @@ parse_config(session_t *ps, struct options_tmp *pcfgtmp) {
   lcfg_lookup_bool(&cfg, "blur-background", &ps->o.blur_background);
   // --blur-level
   lcfg_lookup_int(&cfg, "blur-level", &ps->o.blur_level);
+  // --gpu-memory-budget
+  lcfg_lookup_int(&cfg, "gpu-memory-budget", &ps->o.gpu_memory_budget);
   // --glx-swap-method
   if (config_lookup_string(&cfg, "glx-swap-method", &sval)
       && !parse_glx_swap_method(ps, sval))
     exit(1);
+  // --glx-use-copysubbuffermesa
+  lcfg_lookup_bool(&cfg, "glx-use-copysubbuffermesa", &ps->o.glx_use_copysubbuffermesa);
   // Wintype settings
   {
     wintype_t i;
@@ -2934,6 +2988,7 @@ get_cfg(session_t *ps, int argc, char *const *argv, bool first_pass) {
     { "no-fading-destroyed-argb", no_argument, NULL, 315 },
     { "version", no_argument, NULL, 318 },
     { "no-x-selection", no_argument, NULL, 319 },
+    { "gpu-memory-budget", required_argument, NULL, 321 },
     { "reredir-on-root-change", no_argument, NULL, 731 },
     { "glx-reinit-on-root-change", no_argument, NULL, 732 },
     // Must terminate with a NULL entry
@@ -3092,6 +3147,7 @@ get_cfg(session_t *ps, int argc, char *const *argv, bool first_pass) {
         // --benchmark-wid
         ps->o.benchmark_wid = strtol(optarg, NULL, 0);
         break;
+      P_CASEBOOL(295, glx_use_copysubbuffermesa);
       case 296:
         // --blur-background-exclude
         condlst_add(ps, &ps->o.blur_background_blacklist, optarg);
@@ -3126,6 +3182,7 @@ get_cfg(session_t *ps, int argc, char *const *argv, bool first_pass) {
         break;
       P_CASEBOOL(315, no_fading_destroyed_argb);
       P_CASEBOOL(319, no_x_selection);
+      P_CASELONG(321, gpu_memory_budget);
       P_CASEBOOL(731, reredir_on_root_change);
       P_CASEBOOL(732, glx_reinit_on_root_change);
       default:
@@ -3142,6 +3199,8 @@ get_cfg(session_t *ps, int argc, char *const *argv, bool first_pass) {
   // Range checking and option assignments
   ps->o.inactive_dim = normalize_d(ps->o.inactive_dim) * 100;
   cfgtmp.menu_opacity = normalize_d(cfgtmp.menu_opacity);
+  if (ps->o.gpu_memory_budget < 0)
+    ps->o.gpu_memory_budget = 0;
   if (shadow_enable)
     wintype_arr_enable(ps->o.wintype_shadow);
   ps->o.wintype_shadow[WINTYPE_DESKTOP] = false;
@@ -3167,7 +3226,7 @@ get_cfg(session_t *ps, int argc, char *const *argv, bool first_pass) {
 static bool
 vsync_opengl_swc_init(session_t *ps) {
 
-    if(!glx_hasglext(ps, "EXT_swap_control")) {
+    if(!glx_hasglxext(ps, "GLX_EXT_swap_control")) {
         printf_errf("No swap control extension, can't set the swap inteval. Expect no vsync");
         return false;
     }
@@ -3475,18 +3534,25 @@ mainloop(session_t *ps) {
   // causing XNextEvent() to block, I have no idea what's wrong, so we
   // check for the number of events here.
   while(XEventsQueued(ps->dpy, QueuedAfterReading)) {
-    XEvent ev = { };
+    XEvent* ev = vector_reserve(&ps->event_batch, 1);
+    XNextEvent(ps->dpy, ev);
+  }
 
-    XNextEvent(ps->dpy, &ev);
-    ev_handle(ps, &ev);
+  if(vector_size(&ps->event_batch) > 0) {
+    ev_coalesce(ps, &ps->event_batch);
 
-    ps->skip_poll = true;
+    size_t index;
+    XEvent* ev = vector_getFirst(&ps->event_batch, &index);
+    while(ev != NULL) {
+      if(ev->type != EV_DROPPED)
+        ev_handle(ps, ev);
+      ev = vector_getNext(&ps->event_batch, &index);
+    }
+    vector_clear(&ps->event_batch);
 
-    return true;
+    ps->skip_poll = true;
   }
 
-  /* return false; */
-
 #ifdef CONFIG_DBUS
   if (ps->o.dbus) {
     cdbus_loop(ps);
@@ -3582,6 +3648,7 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
     .depth = 0,
     .root = None,
     .root_size = {{0}},
+    .cutout_dirty = true,
     // .root_damage = None,
     .overlay = None,
     .reg_win = None,
@@ -3592,6 +3659,7 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
       .fork_after_register = false,
       .synchronize = false,
       .blur_level = 0,
+      .gpu_memory_budget = 0,
       .stoppaint_force = UNSET,
       .dbus = false,
       .benchmark = 0,
@@ -3599,6 +3667,8 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
       .logpath = NULL,
 
       .vsync = VSYNC_NONE,
+      .glx_swap_method = SWAPM_BUFFER_AGE,
+      .glx_use_copysubbuffermesa = false,
 
       .wintype_shadow = { false },
       .shadow_blacklist = NULL,
@@ -3696,16 +3766,25 @@ session_t * session_init(session_t *ps_old, int argc, char **argv) {
   swiss_setComponentSize(&ps->win_list, COMPONENT_BLUR, sizeof(struct glx_blur_cache));
   swiss_disableAutoRemove(&ps->win_list, COMPONENT_BLUR);
   swiss_setComponentSize(&ps->win_list, COMPONENT_WINTYPE_CHANGE, sizeof(struct WintypeChangedComponent));
+  swiss_setComponentSize(&ps->win_list, COMPONENT_WDATA_CHANGE, sizeof(struct WdataChangedComponent));
   swiss_setComponentSize(&ps->win_list, COMPONENT_SHAPED, sizeof(struct ShapedComponent));
   swiss_disableAutoRemove(&ps->win_list, COMPONENT_SHAPED);
+  swiss_setComponentSize(&ps->win_list, COMPONENT_OPAQUE_REGION, sizeof(struct OpaqueRegionComponent));
+  swiss_setComponentSize(&ps->win_list, COMPONENT_OPAQUE_REGION_CHANGE, sizeof(struct OpaqueRegionChangedComponent));
   swiss_setComponentSize(&ps->win_list, COMPONENT_SHAPE_DAMAGED, sizeof(struct ShapeDamagedEvent));
   swiss_disableAutoRemove(&ps->win_list, COMPONENT_SHAPE_DAMAGED);
+  swiss_setComponentSize(&ps->win_list, COMPONENT_CONTENTS_DAMAGED, sizeof(struct ContentsDamagedComponent));
+  swiss_disableAutoRemove(&ps->win_list, COMPONENT_CONTENTS_DAMAGED);
   swiss_setComponentSize(&ps->win_list, COMPONENT_STATEFUL, sizeof(struct StatefulComponent));
 
   swiss_setComponentSize(&ps->win_list, COMPONENT_DEBUGGED, sizeof(struct DebuggedComponent));
   swiss_init(&ps->win_list, 512);
+  swiss_enableIndex(&ps->win_list, COMPONENT_TRACKS_WINDOW, sizeof(Window));
+  swiss_enableIndex(&ps->win_list, COMPONENT_HAS_CLIENT, sizeof(Window));
 
   vector_init(&ps->order, sizeof(win_id), 512);
+  vector_init(&ps->event_batch, sizeof(XEvent), 512);
+  vector_init(&ps->event_coalesce, sizeof(struct EventCoalesce), 512);
 
   // Inherit old Display if possible, primarily for resource leak checking
   if (ps_old && ps_old->dpy)
@@ -3746,6 +3825,7 @@ XSynchronize(ps->dpy, 1);
   ps->root_size = (Vector2) {{
       DisplayWidth(ps->dpy, ps->scr), DisplayHeight(ps->dpy, ps->scr)
   }};
+  screendamage_init(&ps->screen_damage, &ps->root_size);
 
   // Build a safe representation of display name
   {
@@ -3773,6 +3853,8 @@ XSynchronize(ps->dpy, 1);
     exit(1);
   }
 
+  xbatch_init(&ps->xbatch, &ps->xcontext);
+
   atoms_init(&ps->atoms, &ps->xcontext);
 
   // Second pass
@@ -3791,6 +3873,7 @@ XSynchronize(ps->dpy, 1);
   add_shader_type(&shadow_info);
   add_shader_type(&stencil_info);
   add_shader_type(&colored_info);
+  add_shader_type(&instanced_info);
 
   assets_add_handler(struct shader, "vs", vert_shader_load_file, shader_unload_file);
   assets_add_handler(struct shader, "fs", frag_shader_load_file, shader_unload_file);
@@ -3806,6 +3889,9 @@ XSynchronize(ps->dpy, 1);
   if (!glx_init(ps, true))
     exit(1);
 
+  if (!assethandles_load())
+    exit(1);
+
   if(xorgContext_capabilities(&ps->capabilities, &ps->xcontext) != 0) {
       printf_errf("Failed getting xorg capabilities");
       exit(1);
@@ -3911,6 +3997,17 @@ XSynchronize(ps->dpy, 1);
   return ps;
 }
 
+// Rectangular windows share the window face asset, only shaped windows own
+// their face
+static void shaped_release_face(struct ShapedComponent* shaped) {
+    if(shaped->face == NULL || shaped->face == asset_handles.window_face)
+        return;
+
+    face_arena_release(shaped->face);
+    free(shaped->face);
+    shaped->face = NULL;
+}
+
 /**
  * Destroy a session.
  *
@@ -3949,7 +4046,6 @@ void session_destroy(session_t *ps) {
       COMPONENT_TEXTURED, CQ_END) {
       struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, it.id);
       texture_delete(&textured->texture);
-      renderbuffer_delete(&textured->stencil);
   }
   swiss_resetComponent(&ps->win_list, COMPONENT_TEXTURED);
   for_components(it, &ps->win_list,
@@ -3973,7 +4069,7 @@ void session_destroy(session_t *ps) {
   for_components(it, &ps->win_list,
       COMPONENT_SHAPED, CQ_END) {
       struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, it.id);
-      face_unload_file(shaped->face);
+      shaped_release_face(shaped);
   }
   swiss_resetComponent(&ps->win_list, COMPONENT_SHAPED);
   for_components(it, &ps->win_list,
@@ -3982,6 +4078,7 @@ void session_destroy(session_t *ps) {
       vector_kill(&damaged->rects);
   }
   swiss_resetComponent(&ps->win_list, COMPONENT_SHAPE_DAMAGED);
+  win_clearContentsDamage(&ps->win_list);
 
 #ifdef CONFIG_C2
   // Free blacklists
@@ -4011,6 +4108,9 @@ void session_destroy(session_t *ps) {
     ps->ignore_tail = &ps->ignore_head;
   }
 
+  vector_kill(&ps->event_batch);
+  vector_kill(&ps->event_coalesce);
+
   xtexture_delete(&ps->root_texture);
 
   free(ps->o.config_file);
@@ -4023,6 +4123,7 @@ void session_destroy(session_t *ps) {
   free(ps->pfds_except);
   free_xinerama_info(ps);
 
+  xbatch_delete(&ps->xbatch);
   xorgContext_delete(&ps->xcontext);
 
   glx_destroy(ps);
@@ -4165,11 +4266,153 @@ bool do_win_fade(struct Bezier* curve, double dt, Swiss* em) {
     return skip_poll;
 }
 
-void update_window_textures(Swiss* em, struct X11Context* xcontext, struct Framebuffer* fbo) {
+static float rect_area(const struct Rect* rect) {
+    return rect->size.x * rect->size.y;
+}
+
+static struct Rect rect_union(const struct Rect* a, const struct Rect* b) {
+    Vector2 min = a->pos;
+    vec2_min(&min, &b->pos);
+
+    Vector2 amax = a->pos;
+    vec2_add(&amax, &a->size);
+    Vector2 bmax = b->pos;
+    vec2_add(&bmax, &b->size);
+    vec2_max(&amax, &bmax);
+
+    vec2_sub(&amax, &min);
+    return (struct Rect) {
+        .pos = min,
+        .size = amax,
+    };
+}
+
+// Merge the damaged rects into at most TEXTURE_DAMAGE_BOXES boxes. Rects
+// that don't fit are merged into the box that grows the least from it.
+size_t merge_damage_boxes(const Vector* rects, struct Rect* boxes) {
+    size_t count = 0;
+
+    size_t index;
+    const struct Rect* rect = vector_getFirst(rects, &index);
+    while(rect != NULL) {
+        if(count < TEXTURE_DAMAGE_BOXES) {
+            boxes[count++] = *rect;
+        } else {
+            size_t best = 0;
+            float bestGrowth = INFINITY;
+            for(size_t i = 0; i < count; i++) {
+                struct Rect merged = rect_union(&boxes[i], rect);
+                float growth = rect_area(&merged) - rect_area(&boxes[i]);
+                if(growth < bestGrowth) {
+                    best = i;
+                    bestGrowth = growth;
+                }
+            }
+            boxes[best] = rect_union(&boxes[best], rect);
+        }
+        rect = vector_getNext(rects, &index);
+    }
+    return count;
+}
+
+// Prepare the framebuffer and shader for copying pixmaps into the window
+// textures.
+static struct Stencil* begin_texture_copy(struct Framebuffer* fbo) {
+    framebuffer_resetTarget(fbo);
+    framebuffer_bind(fbo);
+
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
+    glstate_disable(GL_BLEND);
+
+    struct shader_program* program = asset_handles.stencil.program;
+    struct Stencil* shader_type = asset_handles.stencil.type;
+
+    shader_set_future_uniform_sampler(shader_type->tex_scr, 0);
+
+    shader_use(program);
+    return shader_type;
+}
+
+// Copy the bound pixmap of the window into its texture. If the copy isn't
+// full, only the damaged parts are copied.
+static void copy_window_texture(Swiss* em, win_id wid, struct Framebuffer* fbo, struct Stencil* shader_type, bool full) {
+    struct ShapedComponent* shaped = swiss_getComponent(em, COMPONENT_SHAPED, wid);
+    struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, wid);
+    struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, wid);
+
+    // The storage might have been evicted while we sampled the pixmap
+    // directly, then there's nothing to keep
+    if(textured->texture.evicted) {
+        texture_restore(&textured->texture);
+        full = true;
+    }
+
+    framebuffer_resetTarget(fbo);
+    framebuffer_targetTexture(fbo, &textured->texture);
+    framebuffer_rebind(fbo);
+
+    Vector2 offset = textured->texture.size;
+    vec2_sub(&offset, &bindsTexture->drawable.texture.size);
+
+    Matrix old_view = view;
+    view = mat4_orthogonal(0, textured->texture.size.x, 0, textured->texture.size.y, -1, 1);
+    glViewport(0, 0, textured->texture.size.x, textured->texture.size.y);
+
+    glClearColor(0, 0, 0, 0);
+
+    assert(bindsTexture->drawable.bound);
+    texture_bind(&bindsTexture->drawable.texture, GL_TEXTURE0);
+
+    shader_set_uniform_bool(shader_type->flip, bindsTexture->drawable.texture.flipped);
+
+    if(full) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        draw_rect(shaped->face, shader_type->mvp, (Vector3){{0, offset.y, 0}}, bindsTexture->drawable.texture.size);
+    } else {
+        // Only redraw the damaged parts, the rest of the texture is
+        // still valid from the last update
+        struct ContentsDamagedComponent* contentsDamaged = swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, wid);
+        struct Rect boxes[TEXTURE_DAMAGE_BOXES];
+        size_t box_count = merge_damage_boxes(&contentsDamaged->rects, boxes);
+
+        glstate_enable(GL_SCISSOR_TEST);
+        for(size_t i = 0; i < box_count; i++) {
+            // The damage is in X coordinates, with y going down from
+            // the top of the texture
+            glstate_scissor(boxes[i].pos.x,
+                    textured->texture.size.y - boxes[i].pos.y - boxes[i].size.y,
+                    boxes[i].size.x, boxes[i].size.y);
+            glClear(GL_COLOR_BUFFER_BIT);
+            draw_rect(shaped->face, shader_type->mvp, (Vector3){{0, offset.y, 0}}, bindsTexture->drawable.texture.size);
+        }
+        glstate_disable(GL_SCISSOR_TEST);
+    }
+
+    view = old_view;
+}
+
+// When there's no pixmap to copy from, an evicted texture gets cleared
+// storage instead, so nothing ends up sampling a texture without any.
+// Expects the copy to have begun.
+static void clear_evicted_texture(struct TexturedComponent* textured, struct Framebuffer* fbo) {
+    assert(textured->texture.evicted);
+    texture_restore(&textured->texture);
+
+    framebuffer_resetTarget(fbo);
+    framebuffer_targetTexture(fbo, &textured->texture);
+    framebuffer_rebind(fbo);
+
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void update_window_textures(Swiss* em, struct X11Context* xcontext, glx_session_t* psglx, struct Framebuffer* fbo) {
     static const enum ComponentType req_types[] = {
         COMPONENT_BINDS_TEXTURE,
         COMPONENT_TEXTURED,
         COMPONENT_CONTENTS_DAMAGED,
+        CQ_NOT, COMPONENT_OCCLUDED,
         CQ_END
     };
     struct SwissIterator it = {0};
@@ -4177,81 +4420,115 @@ void update_window_textures(Swiss* em, struct X11Context* xcontext, struct Frame
     if(it.done)
         return;
 
-    framebuffer_resetTarget(fbo);
-    framebuffer_bind(fbo);
-
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
-    glDisable(GL_BLEND);
-
-    struct shader_program* program = assets_load("stencil.shader");
-    if(program->shader_type_info != &stencil_info) {
-        printf_errf("Shader was not a stencil shader\n");
-        return;
-    }
-    struct Stencil* shader_type = program->shader_type;
-
-    shader_set_future_uniform_sampler(shader_type->tex_scr, 0);
-
-    shader_use(program);
+    struct Stencil* shader_type = begin_texture_copy(fbo);
 
     // @RESEARCH: According to the spec (https://www.khronos.org/registry/OpenGL/extensions/EXT/GLX_EXT_texture_from_pixmap.txt)
     // we should always grab the server before binding glx textures, and keep
     // server until we are done with the textures. Experiments show that it
     // completely kills rendering performance for chrome and electron.
     // - Delusional 19/08-2018
-    XGrabServer(xcontext->display);
-    glXWaitX();
+    // Instead we have the server trigger a fence for every window once it's
+    // done drawing it, and wait for those before reading the pixmaps.
+    bool gpuWait = false;
+#ifdef CONFIG_GLX_SYNC
+    gpuWait = psglx->has_x11_sync;
+#endif
+
+    Vector fences;
+    vector_init(&fences, sizeof(XSyncFence), 16);
+    for_componentsArr(fit, em, req_types) {
+        struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, fit.id);
+        struct XFence* fence = &bindsTexture->drawable.fence;
+
+        if(fence->id == None && !xorgContext_acquireFence(xcontext, fence))
+            continue;
+
+        xorgContext_triggerFence(xcontext, fence);
+        vector_putBack(&fences, &fence->id);
+    }
+
+    if(!gpuWait && vector_size(&fences) > 0) {
+        XSyncAwaitFence(xcontext->display, vector_get(&fences, 0), vector_size(&fences));
+        glXWaitX();
+    } else {
+        XFlush(xcontext->display);
+    }
+    vector_kill(&fences);
 
     while(!it.done) {
         struct ShapedComponent* shaped = swiss_getComponent(em, COMPONENT_SHAPED, it.id);
         struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, it.id);
         struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, it.id);
-
-        XSyncFence fence = XSyncCreateFence(xcontext->display, bindsTexture->drawable.wid, false);
-        XSyncTriggerFence(xcontext->display, fence);
-        XSyncAwaitFence(xcontext->display, &fence, 1);
-        XSyncDestroyFence(xcontext->display, fence);
+        struct ContentsDamagedComponent* contentsDamaged = swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+
+#ifdef CONFIG_GLX_SYNC
+        if(gpuWait && bindsTexture->drawable.fence.id != None) {
+            GLsync sync = psglx->glImportSyncEXT(GL_SYNC_X11_FENCE_EXT,
+                    bindsTexture->drawable.fence.id, 0);
+            psglx->glWaitSyncProc(sync, 0, GL_TIMEOUT_IGNORED);
+            psglx->glDeleteSyncProc(sync);
+        }
+#endif
 
         if(!wd_bind(&bindsTexture->drawable)) {
             // If we fail to bind we just assume that the window must have been
             // closed and keep the old texture
             printf_err("Failed binding drawable for %zu", it.id);
+            if(textured->texture.evicted)
+                clear_evicted_texture(textured, fbo);
+            textured->direct = false;
             swiss_getNext(em, &it);
             continue;
         }
 
-        framebuffer_resetTarget(fbo);
-        framebuffer_targetTexture(fbo, &textured->texture);
-        framebuffer_targetRenderBuffer_stencil(fbo, &textured->stencil);
-        framebuffer_rebind(fbo);
-
-        Vector2 offset = textured->texture.size;
-        vec2_sub(&offset, &bindsTexture->drawable.texture.size);
-
-        Matrix old_view = view;
-        view = mat4_orthogonal(0, textured->texture.size.x, 0, textured->texture.size.y, -1, 1);
-        glViewport(0, 0, textured->texture.size.x, textured->texture.size.y);
+        if(shaped->rectangular) {
+            // Rectangular windows don't need the shape cut out, so we can
+            // skip the copy and draw straight from the pixmap
+            textured->direct = true;
+        } else {
+            // Coming out of direct mode the texture hasn't been kept up to
+            // date, so all of it has to be copied
+            copy_window_texture(em, it.id, fbo, shader_type,
+                    contentsDamaged->full || textured->direct);
+            textured->direct = false;
+        }
 
-        glClearColor(0, 0, 0, 0);
-        glClear(GL_COLOR_BUFFER_BIT);
+        swiss_getNext(em, &it);
+    }
+}
 
-        assert(bindsTexture->drawable.bound);
-        texture_bind(&bindsTexture->drawable.texture, GL_TEXTURE0);
+// The pixmap of a window that is going away can vanish at any point, so the
+// windows that were sampling it directly need a copy to fade out with.
+static void capture_direct_textures(Swiss* em, struct Framebuffer* fbo) {
+    const enum ComponentType events[] = {
+        COMPONENT_UNMAP,
+        COMPONENT_DESTROY,
+    };
 
-        shader_set_uniform_bool(shader_type->flip, bindsTexture->drawable.texture.flipped);
+    struct Stencil* shader_type = NULL;
+    for(size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+        for_components(it, em,
+                events[i], COMPONENT_BINDS_TEXTURE, COMPONENT_TEXTURED, CQ_END) {
+            struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, it.id);
+            struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, it.id);
 
-        draw_rect(shaped->face, shader_type->mvp, (Vector3){{0, offset.y, 0}}, bindsTexture->drawable.texture.size);
+            if(!textured->direct)
+                continue;
+            textured->direct = false;
 
-        view = old_view;
+            if(shader_type == NULL) {
+                shader_type = begin_texture_copy(fbo);
+            }
 
-        wd_unbind(&bindsTexture->drawable);
+            if(!bindsTexture->drawable.bound) {
+                if(textured->texture.evicted)
+                    clear_evicted_texture(textured, fbo);
+                continue;
+            }
 
-        swiss_getNext(em, &it);
+            copy_window_texture(em, it.id, fbo, shader_type, true);
+        }
     }
-
-    XUngrabServer(xcontext->display);
-    glXWaitX();
 }
 
 static void commit_opacity_change(Swiss* em, double fade_time) {
@@ -4373,12 +4650,22 @@ static void finish_destroyed_windows(Swiss* em, session_t* ps) {
         struct StatefulComponent* stateful = swiss_getComponent(&ps->win_list, COMPONENT_STATEFUL, it.id);
 
         if(stateful->state == STATE_DESTROYED) {
-            if(shaped->face != NULL)
-                face_unload_file(shaped->face);
+            shaped_release_face(shaped);
             swiss_removeComponent(em, COMPONENT_SHAPED, it.id);
         }
     }
 
+    for_components(it, em,
+            COMPONENT_STATEFUL, COMPONENT_CONTENTS_DAMAGED, CQ_END) {
+        struct ContentsDamagedComponent* contentsDamaged = swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+        struct StatefulComponent* stateful = swiss_getComponent(&ps->win_list, COMPONENT_STATEFUL, it.id);
+
+        if(stateful->state == STATE_DESTROYED) {
+            vector_kill(&contentsDamaged->rects);
+            swiss_removeComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+        }
+    }
+
     for_components(it, em,
             COMPONENT_STATEFUL, CQ_END) {
         struct StatefulComponent* stateful = swiss_getComponent(&ps->win_list, COMPONENT_STATEFUL, it.id);
@@ -4418,7 +4705,6 @@ static void remove_texture_invis_windows(Swiss* em) {
 
         if(stateful->state == STATE_INVISIBLE || stateful->state == STATE_DESTROYED) {
             texture_delete(&textured->texture);
-            renderbuffer_delete(&textured->stencil);
             swiss_removeComponent(em, COMPONENT_TEXTURED, it.id);
         }
     }
@@ -4531,7 +4817,17 @@ static void start_focus_fade(Swiss* em, double fade_time, double dim_fade_time)
 static void commit_resize(Swiss* em) {
     for_components(it, em,
             COMPONENT_RESIZE, CQ_END) {
-        swiss_ensureComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+        win_damageContents(em, it.id);
+    }
+
+    // The server allocates a new pixmap when a window is resized, so the one
+    // we have named is stale
+    for_components(it, em,
+            COMPONENT_RESIZE, COMPONENT_BINDS_TEXTURE, CQ_END) {
+        struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, it.id);
+        if(bindsTexture->drawable.bound) {
+            wd_unbind(&bindsTexture->drawable);
+        }
     }
 
     for_components(it, em,
@@ -4560,8 +4856,7 @@ static void commit_resize(Swiss* em) {
         struct ResizeComponent* resize = swiss_getComponent(em, COMPONENT_RESIZE, it.id);
         struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, it.id);
 
-        texture_resize(&textured->texture, &resize->newSize);
-        renderbuffer_resize(&textured->stencil, &resize->newSize);
+        texture_resize(&textured->texture, &resize->newSize, textured->texture.format);
     }
 
     for_components(it, em,
@@ -4579,16 +4874,44 @@ static void commit_reshape(Swiss* em, struct X11Context* context) {
         struct ShapedComponent* shaped = swiss_getComponent(em, COMPONENT_SHAPED, it.id);
         struct ShapeDamagedEvent* shapeDamaged = swiss_getComponent(em, COMPONENT_SHAPE_DAMAGED, it.id);
 
-        if(shaped->face != NULL)
-            face_unload_file(shaped->face);
+        // The rects are clipped to the window, so a single rect of the
+        // full size covers all of it
+        bool rectangular = false;
+        if(vector_size(&shapeDamaged->rects) == 1) {
+            struct Rect* rect = vector_get(&shapeDamaged->rects, 0);
+            rectangular = rect->size.x == 1.0 && rect->size.y == 1.0;
+        }
 
-        struct face* face = malloc(sizeof(struct face));
-        // Triangulate the rectangles into a triangle vertex stream
-        face_init_rects(face, &shapeDamaged->rects);
-        vector_kill(&shapeDamaged->rects);
-        face_upload(face);
+        // The texture copy is cut by the shape, so it has to be redone when
+        // we stop or start sampling the pixmap directly
+        if(rectangular != shaped->rectangular
+                && swiss_hasComponent(em, COMPONENT_BINDS_TEXTURE, it.id)) {
+            win_damageContents(em, it.id);
+        }
+        shaped->rectangular = rectangular;
+
+        if(rectangular) {
+            shaped_release_face(shaped);
+            shaped->face = asset_handles.window_face;
+            vector_kill(&shapeDamaged->rects);
+            continue;
+        }
+
+        // Keep the face of the last shape, so the new one can go in the same
+        // slot of the arena if it fits
+        if(shaped->face == NULL || shaped->face == asset_handles.window_face) {
+            shaped->face = calloc(1, sizeof(struct face));
+            if(shaped->face == NULL) {
+                printf_errf("Failed allocating face for window");
+                vector_kill(&shapeDamaged->rects);
+                continue;
+            }
+        }
 
-        shaped->face = face;
+        if(!face_arena_store(shaped->face, &shapeDamaged->rects)) {
+            printf_errf("Failed storing the shape of a window");
+        }
+        vector_kill(&shapeDamaged->rects);
     }
 }
 
@@ -4666,21 +4989,25 @@ static void commit_unmap(Swiss* em, struct X11Context* xcontext) {
     }
 }
 
-static void commit_map(Swiss* em, struct Atoms* atoms, struct X11Context* xcontext) {
+static void commit_map(Swiss* em, struct XBatch* batch, struct X11Context* xcontext) {
     // Mapping a window causes us to start redirecting it
     {
         zone_enter(&ZONE_fetch_prop);
         for_components(it, em,
                 COMPONENT_MAP, COMPONENT_HAS_CLIENT, COMPONENT_TRACKS_WINDOW, CQ_END) {
-            struct HasClientComponent* hasClient = swiss_godComponent(em, COMPONENT_HAS_CLIENT, it.id);
+            struct MapComponent* map = swiss_getComponent(em, COMPONENT_MAP, it.id);
+
+            if(map->bypassRequest == XBATCH_NONE) {
+                swiss_ensureComponent(em, COMPONENT_REDIRECTED, it.id);
+                continue;
+            }
 
-            winprop_t prop = wid_get_prop(xcontext, hasClient->id, atoms->atom_bypass, 1L, XA_CARDINAL, 32);
+            const winprop_t* prop = xbatch_propReply(batch, map->bypassRequest);
             // A value of 1 means that the window has taken special care to ask
             // us not to do compositing.
-            if(prop.nitems == 0 || *prop.data.p32 != 1) {
+            if(prop->nitems == 0 || *prop->data.p32 != 1) {
                 swiss_ensureComponent(em, COMPONENT_REDIRECTED, it.id);
             }
-            free_winprop(&prop);
         }
         zone_leave(&ZONE_fetch_prop);
 
@@ -4695,10 +5022,11 @@ static void commit_map(Swiss* em, struct Atoms* atoms, struct X11Context* xconte
     // Mapping a window causes it to bind from X
     for_components(it, em,
             COMPONENT_MAP, COMPONENT_TRACKS_WINDOW, COMPONENT_REDIRECTED, CQ_END) {
+        struct MapComponent* map = swiss_getComponent(em, COMPONENT_MAP, it.id);
         struct TracksWindowComponent* tracksWindow = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, it.id);
         struct BindsTextureComponent* bindsTexture = swiss_addComponent(em, COMPONENT_BINDS_TEXTURE, it.id);
 
-        if(!wd_init(&bindsTexture->drawable, xcontext, tracksWindow->id)) {
+        if(!wd_init(&bindsTexture->drawable, xcontext, tracksWindow->id, map->visual)) {
             printf_errf("Failed initializing window drawable on map");
         }
     }
@@ -4709,8 +5037,8 @@ static void commit_map(Swiss* em, struct Atoms* atoms, struct X11Context* xconte
         struct MapComponent* map = swiss_getComponent(em, COMPONENT_MAP, it.id);
         struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, it.id);
 
-        texture_resize(&textured->texture, &map->size);
-        renderbuffer_resize(&textured->stencil, &map->size);
+        // The window might have been remapped with another visual
+        texture_resize(&textured->texture, &map->size, win_contentsFormat(em, it.id));
     }
 
     // Create a texture when mapping windows without one
@@ -4720,13 +5048,11 @@ static void commit_map(Swiss* em, struct Atoms* atoms, struct X11Context* xconte
 
         struct TexturedComponent* textured = swiss_addComponent(em, COMPONENT_TEXTURED, it.id);
 
-        if(texture_init(&textured->texture, GL_TEXTURE_2D, &map->size) != 0)  {
+        if(texture_init(&textured->texture, GL_TEXTURE_2D, &map->size,
+                    win_contentsFormat(em, it.id)) != 0)  {
             printf_errf("Failed initializing window contents texture");
         }
-
-        if(renderbuffer_stencil_init(&textured->stencil, &map->size) != 0)  {
-            printf_errf("Failed initializing window contents stencil");
-        }
+        textured->direct = false;
     }
 
     // When we map a window, and blur/shadow isn't there, we want to add them.
@@ -4791,7 +5117,7 @@ static void commit_map(Swiss* em, struct Atoms* atoms, struct X11Context* xconte
     // After a map we'd like to immediately bind the window.
     for_components(it, em,
             COMPONENT_MAP, COMPONENT_BINDS_TEXTURE, CQ_END) {
-        swiss_ensureComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+        win_damageContents(em, it.id);
     }
 
     for_components(it, em,
@@ -4810,28 +5136,176 @@ static void commit_map(Swiss* em, struct Atoms* atoms, struct X11Context* xconte
     }
 }
 
+/**
+ * Issue every property request the systems need this frame.
+ *
+ * Nothing here waits for a reply, so the whole frame costs a single round
+ * trip instead of one per window and property.
+ */
+static void issue_window_requests(Swiss* em, session_t* ps) {
+    struct XBatch* batch = &ps->xbatch;
+
+    for_components(it, em, COMPONENT_MAP, COMPONENT_HAS_CLIENT, CQ_END) {
+        struct MapComponent* map = swiss_getComponent(em, COMPONENT_MAP, it.id);
+        struct HasClientComponent* client = swiss_getComponent(em, COMPONENT_HAS_CLIENT, it.id);
+
+        map->bypassRequest = xbatch_prop(batch, client->id, ps->atoms.atom_bypass,
+                0L, 1L, XA_CARDINAL, 32);
+    }
+
+    for_components(it, em, COMPONENT_WINTYPE_CHANGE, COMPONENT_HAS_CLIENT, CQ_END) {
+        struct WintypeChangedComponent* wintypeChanged = swiss_getComponent(em, COMPONENT_WINTYPE_CHANGE, it.id);
+        struct HasClientComponent* client = swiss_getComponent(em, COMPONENT_HAS_CLIENT, it.id);
+
+        wintypeChanged->request = xbatch_prop(batch, client->id, ps->atoms.atom_win_type,
+                0L, 32L, XA_ATOM, 32);
+    }
+
+    for_components(it, em,
+            COMPONENT_OPAQUE_REGION_CHANGE, COMPONENT_HAS_CLIENT, COMPONENT_TRACKS_WINDOW, CQ_END) {
+        struct OpaqueRegionChangedComponent* opaqueRegionChanged = swiss_getComponent(em, COMPONENT_OPAQUE_REGION_CHANGE, it.id);
+        struct HasClientComponent* client = swiss_getComponent(em, COMPONENT_HAS_CLIENT, it.id);
+        struct TracksWindowComponent* window = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, it.id);
+
+        opaqueRegionChanged->request = xbatch_prop(batch, client->id, ps->atoms.atom_opaque_region,
+                0L, XBATCH_PROP_ALL, XA_CARDINAL, 32);
+        opaqueRegionChanged->translateRequest = XBATCH_NONE;
+        if(client->id != window->id) {
+            opaqueRegionChanged->translateRequest = xbatch_translate(batch, client->id, window->id);
+        }
+    }
+
+    for_components(it, em, COMPONENT_WDATA_CHANGE, COMPONENT_HAS_CLIENT, CQ_END) {
+        struct WdataChangedComponent* wdataChanged = swiss_getComponent(em, COMPONENT_WDATA_CHANGE, it.id);
+        struct HasClientComponent* client = swiss_getComponent(em, COMPONENT_HAS_CLIENT, it.id);
+
+        if(wdataChanged->name) {
+            wdataChanged->nameRequest = xbatch_prop(batch, client->id, ps->atoms.atom_name_ewmh,
+                    0L, XBATCH_PROP_ALL, AnyPropertyType, 0);
+            wdataChanged->legacyNameRequest = xbatch_prop(batch, client->id, ps->atoms.atom_name,
+                    0L, XBATCH_PROP_ALL, AnyPropertyType, 0);
+        }
+        if(wdataChanged->class) {
+            wdataChanged->classRequest = xbatch_prop(batch, client->id, ps->atoms.atom_class,
+                    0L, XBATCH_PROP_ALL, AnyPropertyType, 0);
+        }
+        if(wdataChanged->role) {
+            wdataChanged->roleRequest = xbatch_prop(batch, client->id, ps->atoms.atom_role,
+                    0L, XBATCH_PROP_ALL, AnyPropertyType, 0);
+        }
+    }
+
+    for_components(it, em,
+            COMPONENT_PHYSICAL, COMPONENT_TRACKS_WINDOW, COMPONENT_SHAPE_DAMAGED, CQ_END) {
+        struct TracksWindowComponent* window = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, it.id);
+        struct ShapeDamagedEvent* shapeDamaged = swiss_getComponent(em, COMPONENT_SHAPE_DAMAGED, it.id);
+
+        shapeDamaged->geometryRequest = xbatch_geometry(batch, window->id);
+        shapeDamaged->shapeRequest = xbatch_shapeRects(batch, window->id, XCB_SHAPE_SK_BOUNDING);
+    }
+
+    for_components(it, em, COMPONENT_MUD, COMPONENT_CONTENTS_DAMAGED, CQ_END) {
+        struct _win* w = swiss_getComponent(em, COMPONENT_MUD, it.id);
+        struct ContentsDamagedComponent* contentsDamaged = swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+
+        if(contentsDamaged->fetch && w->damage != None) {
+            contentsDamaged->request = xbatch_damageRects(batch, w->damage);
+        }
+    }
+
+#ifdef CONFIG_C2
+    // The blacklists are matched against all mapped windows every frame
+    const c2_lptr_t* condlsts[] = {
+        ps->o.shadow_blacklist,
+        ps->o.fade_blacklist,
+        ps->o.focus_blacklist,
+        ps->o.invert_color_list,
+        ps->o.blur_background_blacklist,
+        ps->o.opacity_rules,
+        ps->o.paint_blacklist,
+    };
+    for_components(it, em, COMPONENT_MUD, COMPONENT_HAS_CLIENT, COMPONENT_TRACKS_WINDOW, CQ_END) {
+        struct _win* w = swiss_getComponent(em, COMPONENT_MUD, it.id);
+        if(!win_mapped(em, it.id))
+            continue;
+
+        for(size_t i = 0; i < sizeof(condlsts) / sizeof(condlsts[0]); i++) {
+            c2_prefetch(ps, w, condlsts[i], batch);
+        }
+    }
+#endif
+
+    xbatch_flush(batch);
+}
+
+/**
+ * Replace the strings of windows with the freshly fetched ones.
+ */
+static void commit_wdata_change(Swiss* em, session_t* ps) {
+    struct XBatch* batch = &ps->xbatch;
+
+    for_components(it, em, COMPONENT_MUD, COMPONENT_WDATA_CHANGE, COMPONENT_HAS_CLIENT, CQ_END) {
+        struct _win* w = swiss_getComponent(em, COMPONENT_MUD, it.id);
+        struct WdataChangedComponent* wdataChanged = swiss_getComponent(em, COMPONENT_WDATA_CHANGE, it.id);
+
+        char **strlst = NULL;
+        int nstr = 0;
+
+        if(wdataChanged->name) {
+            // Keep the old name if there's no new one
+            if (xbatch_textReply(batch, wdataChanged->nameRequest, &strlst, &nstr)
+                    || xbatch_textReply(batch, wdataChanged->legacyNameRequest, &strlst, &nstr)) {
+                free(w->name);
+                w->name = mstrcpy(strlst[0]);
+                XFreeStringList(strlst);
+            }
+        }
+
+        if(wdataChanged->class) {
+            free(w->class_instance);
+            free(w->class_general);
+            w->class_instance = NULL;
+            w->class_general = NULL;
+
+            if (xbatch_textReply(batch, wdataChanged->classRequest, &strlst, &nstr)) {
+                w->class_instance = mstrcpy(strlst[0]);
+                if (nstr > 1)
+                    w->class_general = mstrcpy(strlst[1]);
+                XFreeStringList(strlst);
+            }
+        }
+
+        if(wdataChanged->role) {
+            // Keep the old role if there's no new one
+            if (xbatch_textReply(batch, wdataChanged->roleRequest, &strlst, &nstr)) {
+                free(w->role);
+                w->role = mstrcpy(strlst[0]);
+                XFreeStringList(strlst);
+            }
+        }
+    }
+
+    swiss_resetComponent(em, COMPONENT_WDATA_CHANGE);
+}
+
 void fill_wintype_changes(Swiss* em, session_t* ps) {
     // Fetch the new window type
     for_components(it, em,
             COMPONENT_WINTYPE_CHANGE, COMPONENT_HAS_CLIENT, CQ_END) {
         struct WintypeChangedComponent* wintypeChanged = swiss_getComponent(em, COMPONENT_WINTYPE_CHANGE, it.id);
-        struct HasClientComponent* client = swiss_getComponent(em, COMPONENT_HAS_CLIENT, it.id);
 
         // Detect window type here
-        set_ignore_next(ps);
-        winprop_t prop = wid_get_prop(&ps->xcontext, client->id, ps->atoms.atom_win_type, 32L, XA_ATOM, 32);
+        const winprop_t* prop = xbatch_propReply(&ps->xbatch, wintypeChanged->request);
 
         wintypeChanged->newType = WINTYPE_UNKNOWN;
 
-        for (unsigned i = 0; i < prop.nitems; ++i) {
+        for (unsigned i = 0; i < prop->nitems; ++i) {
             for (wintype_t j = 1; j < NUM_WINTYPES; ++j) {
-                if (ps->atoms.atoms_wintypes[j] == (Atom) prop.data.p32[i]) {
+                if (ps->atoms.atoms_wintypes[j] == (Atom) prop->data.p32[i]) {
                     wintypeChanged->newType = j;
                 }
             }
         }
-
-        free_winprop(&prop);
     }
 
     // Guess the window type if not provided
@@ -4865,6 +5339,253 @@ void fill_wintype_changes(Swiss* em, session_t* ps) {
     }
 }
 
+// Window events that change what's on screen. This is run both before and
+// after the commit systems, to damage where the windows were as well as where
+// they are going.
+static void damage_window_events(session_t* ps) {
+    Swiss* em = &ps->win_list;
+    const enum ComponentType events[] = {
+        COMPONENT_MAP,
+        COMPONENT_UNMAP,
+        COMPONENT_DESTROY,
+        COMPONENT_MOVE,
+        COMPONENT_RESIZE,
+        COMPONENT_SHAPE_DAMAGED,
+        COMPONENT_WINTYPE_CHANGE,
+        COMPONENT_FOCUS_CHANGE,
+    };
+    for(size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+        for_components(it, em, events[i], CQ_END) {
+            damage_window(ps, it.id);
+        }
+    }
+}
+
+// Damage that has to be redrawn this frame
+static void damage_window_contents(session_t* ps) {
+    Swiss* em = &ps->win_list;
+
+    for_components(it, em, COMPONENT_PHYSICAL, COMPONENT_CONTENTS_DAMAGED,
+            CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
+        struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, it.id);
+        struct ContentsDamagedComponent* contentsDamaged = swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+
+        if(contentsDamaged->full) {
+            damage_window(ps, it.id);
+            continue;
+        }
+
+        size_t index;
+        struct Rect* rect = vector_getFirst(&contentsDamaged->rects, &index);
+        while(rect != NULL) {
+            Vector2 pos = physical->position;
+            vec2_add(&pos, &rect->pos);
+            screendamage_add(&ps->screen_damage, &pos, &rect->size);
+            rect = vector_getNext(&contentsDamaged->rects, &index);
+        }
+    }
+
+    const enum ComponentType damage[] = {
+        COMPONENT_SHADOW_DAMAGED,
+        COMPONENT_BLUR_DAMAGED,
+    };
+    for(size_t i = 0; i < sizeof(damage) / sizeof(damage[0]); i++) {
+        for_components(it, em, damage[i], CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
+            damage_window(ps, it.id);
+        }
+    }
+}
+
+// Windows that are still fading change every frame
+static void damage_fading_windows(session_t* ps) {
+    Swiss* em = &ps->win_list;
+    for_components(it, em, COMPONENT_FADES_OPACITY, CQ_END) {
+        struct FadesOpacityComponent* fo = swiss_getComponent(em, COMPONENT_FADES_OPACITY, it.id);
+        if(!fade_done(&fo->fade))
+            damage_window(ps, it.id);
+    }
+    for_components(it, em, COMPONENT_FADES_DIM, CQ_END) {
+        struct FadesDimComponent* fd = swiss_getComponent(em, COMPONENT_FADES_DIM, it.id);
+        if(!fade_done(&fd->fade))
+            damage_window(ps, it.id);
+    }
+}
+
+// The age of the back buffer we are about to draw into, 0 when unknown
+static int back_buffer_age(session_t* ps) {
+    // Copying the damage to the front buffer leaves the back buffer as it
+    // was after the last frame
+    if (ps->o.glx_use_copysubbuffermesa)
+        return 1;
+
+    if (ps->o.glx_swap_method == SWAPM_BUFFER_AGE) {
+        if (!ps->psglx->has_buffer_age)
+            return 0;
+
+        unsigned int age = 0;
+        glXQueryDrawable(ps->dpy, get_tgt_window(ps), GLX_BACK_BUFFER_AGE_EXT, &age);
+        return age;
+    }
+
+    return ps->o.glx_swap_method;
+}
+
+// The cutout only covers mapped windows we aren't redirecting, so it only
+// changes when one of those changes geometry. Unmapped windows have already
+// lost their redirection at this point, so they are caught as well.
+static bool cutout_damaged(Swiss* em) {
+    const enum ComponentType events[] = {
+        COMPONENT_MAP,
+        COMPONENT_UNMAP,
+        COMPONENT_MOVE,
+        COMPONENT_RESIZE,
+        COMPONENT_SHAPE_DAMAGED,
+    };
+    for(size_t i = 0; i < sizeof(events) / sizeof(events[0]); i++) {
+        for_components(it, em,
+                events[i], CQ_NOT, COMPONENT_REDIRECTED, CQ_END) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void fill_shape_damage(Swiss* em, session_t* ps) {
+    struct XBatch* batch = &ps->xbatch;
+
+    for_components(it, em,
+            COMPONENT_PHYSICAL, COMPONENT_TRACKS_WINDOW, COMPONENT_SHAPE_DAMAGED, CQ_END) {
+        struct ShapeDamagedEvent* shapeDamaged = swiss_getComponent(em, COMPONENT_SHAPE_DAMAGED, it.id);
+
+        const xcb_get_geometry_reply_t* geometry = xbatch_geometryReply(batch, shapeDamaged->geometryRequest);
+        size_t rect_count;
+        const xcb_rectangle_t* shape = xbatch_shapeRectsReply(batch, shapeDamaged->shapeRequest, &rect_count);
+        if (geometry == NULL || shape == NULL) {
+            printf_errf("Failed getting window shape");
+            swiss_removeComponent(em, COMPONENT_SHAPE_DAMAGED, it.id);
+            continue;
+        }
+
+        Vector2 extents = {{geometry->width + geometry->border_width * 2, geometry->height + geometry->border_width * 2}};
+        // X has some insane notion that borders aren't part of the window.
+        // Therefore a window with a border will have a bounding shape with
+        // a negative upper left corner. This offset corrects for that, so
+        // we don't have to deal with it downstream
+        Vector2 offset = {{-geometry->border_width, -geometry->border_width}};
+
+        // Clip the shape to the window, like intersecting with the default
+        // bounding region would.
+        XRectangle* rects = malloc(sizeof(XRectangle) * rect_count);
+        size_t clipped_count = 0;
+        for(size_t i = 0; i < rect_count; i++) {
+            int x1 = max_i(shape[i].x, offset.x);
+            int y1 = max_i(shape[i].y, offset.y);
+            int x2 = min_i(shape[i].x + shape[i].width, offset.x + extents.x);
+            int y2 = min_i(shape[i].y + shape[i].height, offset.y + extents.y);
+            if(x2 <= x1 || y2 <= y1)
+                continue;
+
+            rects[clipped_count++] = (XRectangle) {
+                .x = x1,
+                .y = y1,
+                .width = x2 - x1,
+                .height = y2 - y1,
+            };
+        }
+
+        vector_init(&shapeDamaged->rects, sizeof(struct Rect), clipped_count);
+
+        convert_xrects_to_relative_rect(rects, clipped_count, &extents, &offset, &shapeDamaged->rects);
+        free(rects);
+    }
+}
+
+void fill_contents_damage(Swiss* em, session_t* ps) {
+    struct XBatch* batch = &ps->xbatch;
+
+    for_components(it, em,
+            COMPONENT_MUD, COMPONENT_CONTENTS_DAMAGED, CQ_END) {
+        struct _win* w = swiss_getComponent(em, COMPONENT_MUD, it.id);
+        struct ContentsDamagedComponent* contentsDamaged = swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+
+        if(contentsDamaged->request == XBATCH_NONE)
+            continue;
+
+        size_t rect_count;
+        const xcb_rectangle_t* rects = xbatch_damageRectsReply(batch, contentsDamaged->request, &rect_count);
+        contentsDamaged->fetch = false;
+        contentsDamaged->request = XBATCH_NONE;
+        if(rects == NULL) {
+            printf_errf("Failed getting window damage");
+            win_damageContents(em, it.id);
+            continue;
+        }
+
+        // The damage is relative to the window origin inside the border,
+        // while we include the border.
+        for(size_t i = 0; i < rect_count; i++) {
+            Vector2 pos = {{rects[i].x + w->border_size, rects[i].y + w->border_size}};
+            Vector2 size = {{rects[i].width, rects[i].height}};
+            win_damageContentsRect(em, it.id, &pos, &size);
+        }
+    }
+}
+
+// Keep the largest rect of the opaque region. Clients usually set the window
+// minus its rounded corners, which comes as a few rects where one covers
+// almost everything.
+void fill_opaque_regions(Swiss* em, session_t* ps) {
+    struct XBatch* batch = &ps->xbatch;
+
+    for_components(it, em,
+            COMPONENT_MUD, COMPONENT_OPAQUE_REGION_CHANGE, COMPONENT_HAS_CLIENT, CQ_END) {
+        struct _win* w = swiss_getComponent(em, COMPONENT_MUD, it.id);
+        struct OpaqueRegionChangedComponent* opaqueRegionChanged = swiss_getComponent(em, COMPONENT_OPAQUE_REGION_CHANGE, it.id);
+
+        // The region is relative to the client, which sits somewhere inside
+        // the frame
+        Vector2 offset = {{w->border_size, w->border_size}};
+        if(opaqueRegionChanged->translateRequest != XBATCH_NONE) {
+            int x, y;
+            if(!xbatch_translateReply(batch, opaqueRegionChanged->translateRequest, &x, &y)) {
+                if(swiss_hasComponent(em, COMPONENT_OPAQUE_REGION, it.id))
+                    swiss_removeComponent(em, COMPONENT_OPAQUE_REGION, it.id);
+                continue;
+            }
+            offset.x += x;
+            offset.y += y;
+        }
+
+        const winprop_t* prop = xbatch_propReply(batch, opaqueRegionChanged->request);
+
+        struct Rect largest = {{{0, 0}}, {{0, 0}}};
+        for(size_t i = 0; i + 3 < prop->nitems; i += 4) {
+            struct Rect rect = {
+                .pos = {{prop->data.p32[i] + offset.x, prop->data.p32[i + 1] + offset.y}},
+                .size = {{prop->data.p32[i + 2], prop->data.p32[i + 3]}},
+            };
+            if(rect.size.x * rect.size.y > largest.size.x * largest.size.y)
+                largest = rect;
+        }
+
+        if(largest.size.x <= 0 || largest.size.y <= 0) {
+            if(swiss_hasComponent(em, COMPONENT_OPAQUE_REGION, it.id))
+                swiss_removeComponent(em, COMPONENT_OPAQUE_REGION, it.id);
+            continue;
+        }
+
+        struct OpaqueRegionComponent* opaqueRegion;
+        if(swiss_hasComponent(em, COMPONENT_OPAQUE_REGION, it.id)) {
+            opaqueRegion = swiss_getComponent(em, COMPONENT_OPAQUE_REGION, it.id);
+        } else {
+            opaqueRegion = swiss_addComponent(em, COMPONENT_OPAQUE_REGION, it.id);
+        }
+        opaqueRegion->rect = largest;
+    }
+
+    swiss_resetComponent(em, COMPONENT_OPAQUE_REGION_CHANGE);
+}
+
 static void fetchSortedWindowsWithArr(Swiss* em, Vector* result, CType* query) {
     for_componentsArr(it, em, query) {
         vector_putBack(result, &it.id);
@@ -4897,60 +5618,30 @@ void session_run(session_t *ps) {
 
     // Initialize idling
     ps->idling = false;
+    screendamage_addAll(&ps->screen_damage);
 
     // Main loop
     while (!ps->reset) {
 
         zone_start(&ZONE_global);
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
         zone_enter(&ZONE_input);
 
         while (mainloop(ps));
 
         Swiss* em = &ps->win_list;
 
-        for_components(it, em,
-                COMPONENT_PHYSICAL, COMPONENT_TRACKS_WINDOW, COMPONENT_SHAPE_DAMAGED, CQ_END) {
-            struct TracksWindowComponent* window = swiss_getComponent(em, COMPONENT_TRACKS_WINDOW, it.id);
-            struct ShapeDamagedEvent* shapeDamaged = swiss_getComponent(em, COMPONENT_SHAPE_DAMAGED, it.id);
-
-            // @HACK @MUD: The first half of this would be better placed in the X11
-            // input processor.
-
-            XWindowAttributes attribs;
-            if (!XGetWindowAttributes(ps->xcontext.display, window->id, &attribs)) {
-                printf_errf("Failed getting window attributes while mapping");
-                swiss_removeComponent(em, COMPONENT_SHAPE_DAMAGED, it.id);
-                continue;
-            }
-
-            Vector2 extents = {{attribs.width + attribs.border_width * 2, attribs.height + attribs.border_width * 2}};
-            // X has some insane notion that borders aren't part of the window.
-            // Therefore a window with a border will have a bounding shape with
-            // a negative upper left corner. This offset corrects for that, so
-            // we don't have to deal with it downstream
-            Vector2 offset = {{-attribs.border_width, -attribs.border_width}};
-
-            XserverRegion window_region = XFixesCreateRegionFromWindow(ps->xcontext.display, window->id, ShapeBounding);
-
-            XRectangle default_clip = {.x = offset.x, .y = offset.y, .width = extents.x, .height = extents.y};
-            XserverRegion default_clip_region = XFixesCreateRegion(ps->xcontext.display, &default_clip, 1);
-            XFixesIntersectRegion(ps->xcontext.display, window_region, window_region, default_clip_region);
-
-            int rect_count;
-            XRectangle* rects = XFixesFetchRegion(ps->xcontext.display, window_region, &rect_count);
-
-            XFixesDestroyRegion(ps->xcontext.display, window_region);
-
-            vector_init(&shapeDamaged->rects, sizeof(struct Rect), rect_count);
-
-            convert_xrects_to_relative_rect(rects, rect_count, &extents, &offset, &shapeDamaged->rects);
-        }
+        // Send all the requests for the frame before anything waits on them
+        issue_window_requests(&ps->win_list, ps);
 
         // Process all the events added by X
+        commit_wdata_change(&ps->win_list, ps);
         fill_wintype_changes(&ps->win_list, ps);
+        fill_shape_damage(&ps->win_list, ps);
+        fill_contents_damage(&ps->win_list, ps);
+        fill_opaque_regions(&ps->win_list, ps);
+
+        damage_window_events(ps);
 
         zone_leave(&ZONE_input);
 
@@ -4966,6 +5657,8 @@ void session_run(session_t *ps) {
         ps->skip_poll = false;
 
         if (ps->o.benchmark) {
+            // The benchmark wants every frame painted in full
+            screendamage_addAll(&ps->screen_damage);
             if (ps->o.benchmark_wid) {
                 win *w = find_win(ps, ps->o.benchmark_wid);
                 if (!w) {
@@ -4976,9 +5669,6 @@ void session_run(session_t *ps) {
             }
         }
 
-        // idling will be turned off later if desired.
-        ps->idling = true;
-
         zone_enter(&ZONE_preprocess);
 
         paint_preprocess(ps);
@@ -5014,9 +5704,12 @@ void session_run(session_t *ps) {
                     COMPONENT_MUD, CQ_END) {
                 struct _win* w = swiss_getComponent(em, COMPONENT_MUD, it.id);
                 if (win_mapped(em, it.id)) {
-                    w->shadow = (ps->o.wintype_shadow[w->window_type]
+                    bool shadow_new = (ps->o.wintype_shadow[w->window_type]
                             && !win_match(ps, w, ps->o.shadow_blacklist)
                             && !(ps->o.respect_prop_shadow));
+                    if (w->shadow != shadow_new)
+                        damage_window(ps, it.id);
+                    w->shadow = shadow_new;
                 }
             }
             zone_leave(&ZONE_update_shadow_blacklist);
@@ -5048,6 +5741,8 @@ void session_run(session_t *ps) {
                 struct _win* w = swiss_getComponent(em, COMPONENT_MUD, it.id);
                 if(win_mapped(em, it.id)) {
                     bool invert_color_new = win_match(ps, w, ps->o.invert_color_list);
+                    if (w->invert_color != invert_color_new)
+                        damage_window(ps, it.id);
                     win_set_invert_color(ps, w, invert_color_new);
                 }
             }
@@ -5062,6 +5757,8 @@ void session_run(session_t *ps) {
                 if(win_mapped(em, it.id)) {
                     bool blur_background_new = ps->o.blur_background
                         && !win_match(ps, w, ps->o.blur_background_blacklist);
+                    if (w->blur_background != blur_background_new)
+                        damage_window(ps, it.id);
 
                     win_set_blur_background(ps, w, blur_background_new);
                 }
@@ -5075,24 +5772,29 @@ void session_run(session_t *ps) {
                     COMPONENT_MUD, CQ_END) {
                 struct _win* w = swiss_getComponent(em, COMPONENT_MUD, it.id);
                 if(win_mapped(em, it.id)) {
-                    w->paint_excluded = win_match(ps, w, ps->o.paint_blacklist);
+                    bool paint_excluded_new = win_match(ps, w, ps->o.paint_blacklist);
+                    if (w->paint_excluded != paint_excluded_new)
+                        damage_window(ps, it.id);
+                    w->paint_excluded = paint_excluded_new;
                 }
             }
             zone_leave(&ZONE_update_paint_blacklist);
         }
 
         zone_enter(&ZONE_input_react);
+        capture_direct_textures(&ps->win_list, &ps->psglx->blur.fbo);
         commit_destroy(&ps->win_list);
-        commit_map(&ps->win_list, &ps->atoms, &ps->xcontext);
+        commit_map(&ps->win_list, &ps->xbatch, &ps->xcontext);
         commit_unmap(&ps->win_list, &ps->xcontext);
         commit_opacity_change(&ps->win_list, ps->o.opacity_fade_time);
         commit_move(&ps->win_list);
         commit_resize(&ps->win_list);
         commit_reshape(&ps->win_list, &ps->xcontext);
+        damage_window_events(ps);
         zone_leave(&ZONE_input_react);
 
         zone_enter(&ZONE_make_cutout);
-        {
+        if (ps->cutout_dirty || cutout_damaged(em)) {
             XserverRegion newShape = XFixesCreateRegion(ps->dpy, NULL, 0);
             for_components(it, em,
                     COMPONENT_MUD, COMPONENT_TRACKS_WINDOW, COMPONENT_PHYSICAL, CQ_NOT, COMPONENT_REDIRECTED, CQ_END) {
@@ -5109,6 +5811,7 @@ void session_run(session_t *ps) {
             XFixesInvertRegion(ps->dpy, newShape, &(XRectangle){0, 0, ps->root_size.x, ps->root_size.y}, newShape);
             XFixesSetWindowShapeRegion(ps->dpy, ps->overlay, ShapeBounding, 0, 0, newShape);
             XFixesDestroyRegion(ps->xcontext.display, newShape);
+            ps->cutout_dirty = false;
         }
         zone_leave(&ZONE_make_cutout);
 
@@ -5145,7 +5848,7 @@ void session_run(session_t *ps) {
             win_id* other_id = vector_getNext(&ps->order, &order_slot);
             while(other_id != NULL) {
 
-                if(win_overlap(&ps->win_list, it.id, *other_id)) {
+                if(win_damageOverlap(&ps->win_list, it.id, *other_id)) {
                     swiss_ensureComponent(&ps->win_list, COMPONENT_BLUR_DAMAGED, *other_id);
                 }
 
@@ -5154,10 +5857,6 @@ void session_run(session_t *ps) {
         }
         zone_leave(&ZONE_prop_blur_damage);
 
-        zone_enter(&ZONE_update_textures);
-        update_window_textures(&ps->win_list, &ps->xcontext, &ps->psglx->blur.fbo);
-        zone_leave(&ZONE_update_textures);
-
         update_focused_state(&ps->win_list, ps);
         calculate_window_opacity(ps, &ps->win_list);
         start_focus_fade(&ps->win_list, ps->o.opacity_fade_time, ps->o.dim_fade_time);
@@ -5167,12 +5866,30 @@ void session_run(session_t *ps) {
 
         damage_blur_over_fade(&ps->win_list);
         syncronize_fade_opacity(&ps->win_list);
+        damage_fading_windows(ps);
         if(do_win_fade(&ps->curve, dt, &ps->win_list)) {
             ps->skip_poll = true;
         }
 
         zone_leave(&ZONE_update_fade);
 
+        // The opacity has to be settled before we know what covers what, and
+        // the textures of the covered windows are skipped
+        windowlist_updateOcclusion(ps);
+
+        // Evicting and restoring depends on what's visible, and has to
+        // happen before anything is redrawn
+        gpumem_restore(&ps->win_list);
+        gpumem_evict(&ps->win_list, &ps->order,
+                (size_t)ps->o.gpu_memory_budget * 1024 * 1024);
+
+        zone_enter(&ZONE_update_textures);
+        update_window_textures(&ps->win_list, &ps->xcontext, ps->psglx, &ps->psglx->blur.fbo);
+        zone_leave(&ZONE_update_textures);
+
+        damage_window_contents(ps);
+        ps->idling = screendamage_empty(&ps->screen_damage);
+
         transition_faded_entities(&ps->win_list);
         remove_texture_invis_windows(&ps->win_list);
         finish_destroyed_windows(&ps->win_list, ps);
@@ -5181,14 +5898,16 @@ void session_run(session_t *ps) {
         Vector opaque;
         vector_init(&opaque, sizeof(win_id), ps->order.size);
         for_components(it, &ps->win_list,
-                COMPONENT_MUD, COMPONENT_TEXTURED, CQ_NOT, COMPONENT_OPACITY, COMPONENT_PHYSICAL, CQ_END) {
+                COMPONENT_MUD, COMPONENT_TEXTURED, COMPONENT_PHYSICAL,
+                CQ_NOT, COMPONENT_OPACITY, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
             vector_putBack(&opaque, &it.id);
         }
         vector_qsort(&opaque, window_zcmp, &ps->win_list);
         Vector transparent;
         vector_init(&transparent, sizeof(win_id), ps->order.size);
         for_components(it, &ps->win_list,
-                COMPONENT_MUD, COMPONENT_TEXTURED, /* COMPONENT_OPACITY, */ COMPONENT_PHYSICAL, CQ_END) {
+                COMPONENT_MUD, COMPONENT_TEXTURED, /* COMPONENT_OPACITY, */ COMPONENT_PHYSICAL,
+                CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
             vector_putBack(&transparent, &it.id);
         }
         vector_qsort(&transparent, window_zcmp, &ps->win_list);
@@ -5196,7 +5915,8 @@ void session_run(session_t *ps) {
         Vector opaque_shadow;
         vector_init(&opaque_shadow, sizeof(win_id), ps->order.size);
         fetchSortedWindowsWith(&ps->win_list, &opaque_shadow,
-                COMPONENT_MUD, COMPONENT_Z, COMPONENT_PHYSICAL, CQ_NOT, COMPONENT_OPACITY, COMPONENT_SHADOW, CQ_END);
+                COMPONENT_MUD, COMPONENT_Z, COMPONENT_PHYSICAL, COMPONENT_SHADOW,
+                CQ_NOT, COMPONENT_OPACITY, CQ_NOT, COMPONENT_OCCLUDED, CQ_END);
 
         zone_enter(&ZONE_effect_textures);
 
@@ -5208,26 +5928,56 @@ void session_run(session_t *ps) {
 
         zone_leave(&ZONE_effect_textures);
 
-        {
+        // Nothing changed on screen, so there's no reason to draw or present
+        // anything.
+        bool present = !ps->idling;
+        Vector2 damagePos;
+        Vector2 damageSize;
+        if (present) {
             static int paint = 0;
 
             zone_enter(&ZONE_paint);
 
-            glDepthMask(GL_TRUE);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glstate_depthMask(GL_TRUE);
+            glstate_bindFramebuffer(GL_FRAMEBUFFER, 0);
             static const GLenum DRAWBUFS[2] = { GL_BACK_LEFT };
             glDrawBuffers(1, DRAWBUFS);
             glViewport(0, 0, ps->root_size.x, ps->root_size.y);
+            uniformbuffer_setFrame(&ps->psglx->uniforms, &view, &ps->root_size);
+
+            // Only repaint what changed since the back buffer was last
+            // drawn. The clear is scissored as well.
+            screendamage_region(&ps->screen_damage, back_buffer_age(ps), &damagePos, &damageSize);
+            Vector2 glDamagePos = X11_rectpos_to_gl(ps, &damagePos, &damageSize);
+            glstate_enable(GL_SCISSOR_TEST);
+            glstate_scissor(glDamagePos.x, glDamagePos.y, damageSize.x, damageSize.y);
 
             glClearDepth(1.0);
-            glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+            glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
             glDepthFunc(GL_LESS);
 
             windowlist_drawBackground(ps, &opaque);
-            windowlist_drawTint(ps);
             windowlist_draw(ps, &opaque);
 
-            paint_root(ps);
+            // The root only has to be painted where no opaque window
+            // covers it
+            Vector2 rootPos = ps->root_visible_pos;
+            Vector2 rootMax = ps->root_visible_pos;
+            vec2_add(&rootMax, &ps->root_visible_size);
+            Vector2 damageMax = damagePos;
+            vec2_add(&damageMax, &damageSize);
+            vec2_max(&rootPos, &damagePos);
+            vec2_min(&rootMax, &damageMax);
+            if(rootMax.x > rootPos.x && rootMax.y > rootPos.y) {
+                Vector2 rootSize = rootMax;
+                vec2_sub(&rootSize, &rootPos);
+                Vector2 glRootPos = X11_rectpos_to_gl(ps, &rootPos, &rootSize);
+                glstate_scissor(glRootPos.x, glRootPos.y, rootSize.x, rootSize.y);
+
+                paint_root(ps);
+
+                glstate_scissor(glDamagePos.x, glDamagePos.y, damageSize.x, damageSize.y);
+            }
 
             windowlist_drawTransparent(ps, &transparent);
 
@@ -5235,14 +5985,12 @@ void session_run(session_t *ps) {
             windowlist_drawDebug(&ps->win_list, ps);
 #endif
 
-            vector_kill(&opaque_shadow);
-            vector_kill(&transparent);
-            vector_kill(&opaque);
+            glstate_disable(GL_SCISSOR_TEST);
 
             /* { */
-            /*     glDisable(GL_DEPTH_TEST); */
-            /*     glDisable(GL_BLEND); */
-            /*     struct face* face = assets_load("window.face"); */
+            /*     glstate_disable(GL_DEPTH_TEST); */
+            /*     glstate_disable(GL_BLEND); */
+            /*     struct face* face = asset_handles.window_face; */
             /*     for_components(it, &ps->win_list, */
             /*             COMPONENT_PHYSICAL, COMPONENT_BLUR, COMPONENT_Z, CQ_END) { */
             /*         struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, it.id); */
@@ -5252,7 +6000,7 @@ void session_run(session_t *ps) {
             /*         Vector2 glPos = X11_rectpos_to_gl(ps, &physical->position, &physical->size); */
             /*         Vector3 dglPos = vec3_from_vec2(&glPos, z->z + 0.000001); */
 
-            /*         draw_tex(face, &blur->texture[0], &dglPos, &(Vector2){{100, 100}}); */
+            /*         draw_tex(face, &blur->texture, &dglPos, &(Vector2){{100, 100}}); */
             /*     } */
             /* } */
             zone_leave(&ZONE_paint);
@@ -5266,8 +6014,14 @@ void session_run(session_t *ps) {
             XSync(ps->dpy, False);
         }
 
+        vector_kill(&opaque_shadow);
+        vector_kill(&transparent);
+        vector_kill(&opaque);
 
-        swiss_resetComponent(&ps->win_list, COMPONENT_CONTENTS_DAMAGED);
+        win_clearContentsDamage(&ps->win_list);
+
+        // Replies are only valid for the frame they were requested in
+        xbatch_clear(&ps->xbatch);
 
         // Finish the profiling before the vsync, since we don't want that to drag out the time
         struct ZoneEventStream* event_stream = zone_package(&ZONE_global);
@@ -5276,8 +6030,26 @@ void session_run(session_t *ps) {
         profilerWriter_emitFrame(&profSess, event_stream);
 #endif
 
-        glXSwapBuffers(ps->dpy, get_tgt_window(ps));
-        glFinish();
+        if (present) {
+            if (ps->o.glx_use_copysubbuffermesa) {
+                // The copy happens in GL coordinates as well
+                screendamage_region(&ps->screen_damage, 1, &damagePos, &damageSize);
+                Vector2 glDamagePos = X11_rectpos_to_gl(ps, &damagePos, &damageSize);
+                ps->psglx->glXCopySubBufferProc(ps->dpy, get_tgt_window(ps),
+                        glDamagePos.x, glDamagePos.y, damageSize.x, damageSize.y);
+            } else {
+                glXSwapBuffers(ps->dpy, get_tgt_window(ps));
+            }
+            glFinish();
+            screendamage_next(&ps->screen_damage);
+            rendertargetpool_trim(&ps->psglx->targets);
+#ifdef DEBUG_GLSTATE
+            glstate_printStats();
+#endif
+#ifdef DEBUG_GPUMEM
+            gpumem_report(&ps->win_list);
+#endif
+        }
 
         lastTime = currentTime;
     }
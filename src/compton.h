@@ -35,6 +35,11 @@ void convert_xrects_to_relative_rect(XRectangle* rects, size_t rect_count, Vecto
 bool do_win_fade(struct Bezier* curve, double dt, Swiss* em);
 void commit_destroy(Swiss* em);
 
+// Every box is a separate draw, so we don't want too many of them
+#define TEXTURE_DAMAGE_BOXES 4
+// boxes must hold TEXTURE_DAMAGE_BOXES rects, returns how many are used
+size_t merge_damage_boxes(const Vector* rects, struct Rect* boxes);
+
 session_t * session_init(session_t *ps_old, int argc, char **argv);
 void session_destroy(session_t *ps);
 
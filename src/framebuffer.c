@@ -1,5 +1,7 @@
 #include "framebuffer.h"
 
+#include "glstate.h"
+
 #include <stdio.h>
 #include <assert.h>
 
@@ -8,6 +10,11 @@ bool framebuffer_init(struct Framebuffer* framebuffer) {
     if(framebuffer->gl_fbo == 0) {
         return false;
     }
+    framebuffer->attached_generation = glstate_attachmentGeneration();
+    framebuffer->attached_texture = 0;
+    framebuffer->attached_buffer = 0;
+    framebuffer->attached_stencil = 0;
+    framebuffer->attached_drawbuf = GL_NONE;
     framebuffer_resetTarget(framebuffer);
     return true;
 }
@@ -59,7 +66,7 @@ void framebuffer_targetBack(struct Framebuffer* framebuffer) {
 }
 
 int framebuffer_bind(struct Framebuffer* framebuffer) {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer->gl_fbo);
+    glstate_bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer->gl_fbo);
 
     if(framebuffer->target == 0)
         return 0;
@@ -71,38 +78,71 @@ int framebuffer_rebind(struct Framebuffer* framebuffer) {
     GLenum DRAWBUFS[4] = {0};
     size_t i = 0;
 
+    // A deleted texture or renderbuffer might have had its name reused, so
+    // we can't tell if what's attached is what we think
+    unsigned long generation = glstate_attachmentGeneration();
+    if(framebuffer->attached_generation != generation) {
+        framebuffer->attached_generation = generation;
+        framebuffer->attached_texture = 0;
+        framebuffer->attached_buffer = 0;
+        framebuffer->attached_stencil = 0;
+        framebuffer->attached_drawbuf = GL_NONE;
+    }
+    bool changed = false;
+
     if((framebuffer->target & FBT_BACKBUFFER) != 0) {
         DRAWBUFS[i++] = GL_BACK_LEFT;
     }
     if((framebuffer->target & FBT_TEXTURE)) {
-        texture_bind_to_framebuffer_2(framebuffer->texture, GL_COLOR_ATTACHMENT1);
+        if(framebuffer->attached_texture != framebuffer->texture->gl_texture) {
+            texture_bind_to_framebuffer_2(framebuffer->texture, GL_COLOR_ATTACHMENT1);
+            framebuffer->attached_texture = framebuffer->texture->gl_texture;
+            changed = true;
+        }
         DRAWBUFS[i++] = GL_COLOR_ATTACHMENT1;
     }
     if((framebuffer->target & FBT_RENDERBUFFER)) {
-        renderbuffer_bind_to_framebuffer(framebuffer->buffer, GL_COLOR_ATTACHMENT0);
+        if(framebuffer->attached_buffer != framebuffer->buffer->gl_buffer) {
+            renderbuffer_bind_to_framebuffer(framebuffer->buffer, GL_COLOR_ATTACHMENT0);
+            framebuffer->attached_buffer = framebuffer->buffer->gl_buffer;
+            changed = true;
+        }
         DRAWBUFS[i++] = GL_COLOR_ATTACHMENT0;
     }
 
     if((framebuffer->target & FBT_RENDERBUFFER_STENCIL)) {
-        renderbuffer_bind_to_framebuffer(framebuffer->buffer_stencil, GL_DEPTH_STENCIL_ATTACHMENT);
+        if(framebuffer->attached_stencil != framebuffer->buffer_stencil->gl_buffer) {
+            renderbuffer_bind_to_framebuffer(framebuffer->buffer_stencil, GL_DEPTH_STENCIL_ATTACHMENT);
+            framebuffer->attached_stencil = framebuffer->buffer_stencil->gl_buffer;
+            changed = true;
+        }
     }
 
-    if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    // Resizing an attachment doesn't change its name, so the completeness
+    // is checked every time something was attached
+    if (changed && glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         printf("Framebuffer attachment failed\n");
+        framebuffer->attached_texture = 0;
+        framebuffer->attached_buffer = 0;
+        framebuffer->attached_stencil = 0;
         return 1;
     }
 
-    glDrawBuffers(1, DRAWBUFS);
+    if(framebuffer->attached_drawbuf != DRAWBUFS[0]) {
+        glDrawBuffers(1, DRAWBUFS);
+        framebuffer->attached_drawbuf = DRAWBUFS[0];
+    }
     return 0;
 }
 
 int framebuffer_bind_read(struct Framebuffer* framebuffer) {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->gl_fbo);
+    glstate_bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->gl_fbo);
     return 0;
 }
 
 void framebuffer_delete(struct Framebuffer* framebuffer) {
     glDeleteFramebuffers(1, &framebuffer->gl_fbo);
+    glstate_deletedFramebuffer(framebuffer->gl_fbo);
     framebuffer_resetTarget(framebuffer);
     framebuffer->gl_fbo = 0;
 }
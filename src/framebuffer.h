@@ -25,6 +25,14 @@ struct Framebuffer {
     // If we target a renderbuffer
     struct RenderBuffer* buffer;
     struct RenderBuffer* buffer_stencil;
+
+    // What's attached to the GL object, so rebinding the same targets is
+    // free. Only valid while the attachment generation matches.
+    unsigned long attached_generation;
+    GLuint attached_texture;
+    GLuint attached_buffer;
+    GLuint attached_stencil;
+    GLenum attached_drawbuf;
 };
 
 bool framebuffer_init(struct Framebuffer* framebuffer);
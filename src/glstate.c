@@ -0,0 +1,291 @@
+#include "glstate.h"
+
+#include "logging.h"
+
+#include <stdio.h>
+
+#include <string.h>
+
+// Value for state we don't know the value of
+#define UNKNOWN ((GLuint)-1)
+
+enum Cap {
+    CAP_DEPTH_TEST,
+    CAP_BLEND,
+    CAP_STENCIL_TEST,
+    CAP_SCISSOR_TEST,
+    NUM_CAPS,
+    CAP_UNTRACKED,
+};
+
+enum CapState {
+    CAP_STATE_UNKNOWN = 0,
+    CAP_STATE_ENABLED,
+    CAP_STATE_DISABLED,
+};
+
+static struct {
+    enum CapState caps[NUM_CAPS];
+
+    GLuint program;
+    GLuint vao;
+    GLuint active_unit;
+    GLuint textures[GLSTATE_TEXTURE_UNITS];
+    GLuint draw_fbo;
+    GLuint read_fbo;
+
+    GLenum blend_src;
+    GLenum blend_dst;
+    GLenum blend_rgb;
+    GLenum blend_alpha;
+    GLuint depth_mask;
+    bool scissor_known;
+    GLint scissor[4];
+
+    unsigned long attachment_generation;
+} state;
+
+#ifdef DEBUG_GLSTATE
+static size_t issued;
+static size_t skipped;
+#define COUNT(changed) ((changed) ? issued++ : skipped++)
+#else
+#define COUNT(changed)
+#endif
+
+void glstate_reset(void) {
+    unsigned long generation = state.attachment_generation;
+
+    memset(&state.caps, 0, sizeof(state.caps));
+    state.program = UNKNOWN;
+    state.vao = UNKNOWN;
+    state.active_unit = UNKNOWN;
+    for(size_t i = 0; i < GLSTATE_TEXTURE_UNITS; i++) {
+        state.textures[i] = UNKNOWN;
+    }
+    state.draw_fbo = UNKNOWN;
+    state.read_fbo = UNKNOWN;
+    state.blend_src = UNKNOWN;
+    state.blend_dst = UNKNOWN;
+    state.blend_rgb = UNKNOWN;
+    state.blend_alpha = UNKNOWN;
+    state.depth_mask = UNKNOWN;
+    state.scissor_known = false;
+
+    state.attachment_generation = generation + 1;
+}
+
+static enum Cap cap_index(GLenum cap) {
+    switch(cap) {
+        case GL_DEPTH_TEST:
+            return CAP_DEPTH_TEST;
+        case GL_BLEND:
+            return CAP_BLEND;
+        case GL_STENCIL_TEST:
+            return CAP_STENCIL_TEST;
+        case GL_SCISSOR_TEST:
+            return CAP_SCISSOR_TEST;
+        default:
+            return CAP_UNTRACKED;
+    }
+}
+
+void glstate_enable(GLenum cap) {
+    enum Cap index = cap_index(cap);
+    if(index == CAP_UNTRACKED) {
+        glEnable(cap);
+        return;
+    }
+
+    bool changed = state.caps[index] != CAP_STATE_ENABLED;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glEnable(cap);
+    state.caps[index] = CAP_STATE_ENABLED;
+}
+
+void glstate_disable(GLenum cap) {
+    enum Cap index = cap_index(cap);
+    if(index == CAP_UNTRACKED) {
+        glDisable(cap);
+        return;
+    }
+
+    bool changed = state.caps[index] != CAP_STATE_DISABLED;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glDisable(cap);
+    state.caps[index] = CAP_STATE_DISABLED;
+}
+
+bool glstate_isEnabled(GLenum cap) {
+    enum Cap index = cap_index(cap);
+    if(index == CAP_UNTRACKED || state.caps[index] == CAP_STATE_UNKNOWN)
+        return glIsEnabled(cap);
+
+    return state.caps[index] == CAP_STATE_ENABLED;
+}
+
+void glstate_useProgram(GLuint program) {
+    bool changed = state.program != program;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glUseProgram(program);
+    state.program = program;
+}
+
+void glstate_bindVertexArray(GLuint vao) {
+    bool changed = state.vao != vao;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glBindVertexArray(vao);
+    state.vao = vao;
+}
+
+void glstate_activeTexture(GLenum unit) {
+    bool changed = state.active_unit != unit;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glActiveTexture(unit);
+    state.active_unit = unit;
+}
+
+void glstate_bindTexture(GLenum target, GLuint texture) {
+    size_t unit = state.active_unit - GL_TEXTURE0;
+    if(target != GL_TEXTURE_2D || state.active_unit == UNKNOWN
+            || unit >= GLSTATE_TEXTURE_UNITS) {
+        glBindTexture(target, texture);
+        return;
+    }
+
+    bool changed = state.textures[unit] != texture;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glBindTexture(target, texture);
+    state.textures[unit] = texture;
+}
+
+void glstate_bindFramebuffer(GLenum target, GLuint fbo) {
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+
+    bool changed = (draw && state.draw_fbo != fbo) || (read && state.read_fbo != fbo);
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glBindFramebuffer(target, fbo);
+    if(draw)
+        state.draw_fbo = fbo;
+    if(read)
+        state.read_fbo = fbo;
+}
+
+void glstate_blendFunc(GLenum sfactor, GLenum dfactor) {
+    bool changed = state.blend_src != sfactor || state.blend_dst != dfactor;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glBlendFunc(sfactor, dfactor);
+    state.blend_src = sfactor;
+    state.blend_dst = dfactor;
+}
+
+void glstate_blendEquationSeparate(GLenum modeRGB, GLenum modeAlpha) {
+    bool changed = state.blend_rgb != modeRGB || state.blend_alpha != modeAlpha;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glBlendEquationSeparate(modeRGB, modeAlpha);
+    state.blend_rgb = modeRGB;
+    state.blend_alpha = modeAlpha;
+}
+
+void glstate_depthMask(GLboolean flag) {
+    bool changed = state.depth_mask != flag;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glDepthMask(flag);
+    state.depth_mask = flag;
+}
+
+void glstate_scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+    const GLint box[4] = {x, y, width, height};
+
+    bool changed = !state.scissor_known || memcmp(state.scissor, box, sizeof(box)) != 0;
+    COUNT(changed);
+    if(!changed)
+        return;
+
+    glScissor(x, y, width, height);
+    memcpy(state.scissor, box, sizeof(box));
+    state.scissor_known = true;
+}
+
+void glstate_getScissor(GLint box[4]) {
+    if(!state.scissor_known) {
+        glGetIntegerv(GL_SCISSOR_BOX, state.scissor);
+        state.scissor_known = true;
+    }
+    memcpy(box, state.scissor, sizeof(state.scissor));
+}
+
+// GL unbinds deleted objects, except programs which stay in use until
+// another one is. Either way the name might come back for a new object.
+
+void glstate_deletedProgram(GLuint program) {
+    if(state.program == program)
+        state.program = UNKNOWN;
+}
+
+void glstate_deletedVertexArray(GLuint vao) {
+    if(state.vao == vao)
+        state.vao = 0;
+}
+
+void glstate_deletedTexture(GLuint texture) {
+    for(size_t i = 0; i < GLSTATE_TEXTURE_UNITS; i++) {
+        if(state.textures[i] == texture)
+            state.textures[i] = 0;
+    }
+    state.attachment_generation++;
+}
+
+void glstate_deletedRenderbuffer(GLuint buffer) {
+    state.attachment_generation++;
+}
+
+void glstate_deletedFramebuffer(GLuint fbo) {
+    if(state.draw_fbo == fbo)
+        state.draw_fbo = 0;
+    if(state.read_fbo == fbo)
+        state.read_fbo = 0;
+}
+
+unsigned long glstate_attachmentGeneration(void) {
+    return state.attachment_generation;
+}
+
+#ifdef DEBUG_GLSTATE
+void glstate_printStats(void) {
+    printf_dbgf("%zu state changes issued, %zu skipped", issued, skipped);
+    issued = 0;
+    skipped = 0;
+}
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glx.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A cache of the GL state we change the most. Calls that wouldn't change
+// anything are skipped, which saves a trip into the driver.
+//
+// For this to work everything that binds programs, vertex arrays, textures
+// and framebuffers, or touches the tracked capabilities, blending, depth
+// mask and scissor box, has to go through here. Deleting any of the objects has to be
+// reported as well, since GL hands out the names again.
+//
+// Building with DEBUG_GLSTATE counts how many calls were issued and skipped.
+
+#define GLSTATE_TEXTURE_UNITS 16
+
+// Forget everything, must be called when we get a new context
+void glstate_reset(void);
+
+// Only GL_DEPTH_TEST, GL_BLEND, GL_STENCIL_TEST and GL_SCISSOR_TEST are
+// tracked, other capabilities are passed straight through
+void glstate_enable(GLenum cap);
+void glstate_disable(GLenum cap);
+bool glstate_isEnabled(GLenum cap);
+
+void glstate_useProgram(GLuint program);
+void glstate_bindVertexArray(GLuint vao);
+void glstate_activeTexture(GLenum unit);
+// Binds to the active unit. Only GL_TEXTURE_2D is tracked.
+void glstate_bindTexture(GLenum target, GLuint texture);
+void glstate_bindFramebuffer(GLenum target, GLuint fbo);
+
+void glstate_blendFunc(GLenum sfactor, GLenum dfactor);
+void glstate_blendEquationSeparate(GLenum modeRGB, GLenum modeAlpha);
+void glstate_depthMask(GLboolean flag);
+
+void glstate_scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+// Get the scissor box as x, y, width and height. Only queries GL if we
+// don't know it yet.
+void glstate_getScissor(GLint box[4]);
+
+void glstate_deletedProgram(GLuint program);
+void glstate_deletedVertexArray(GLuint vao);
+void glstate_deletedTexture(GLuint texture);
+void glstate_deletedRenderbuffer(GLuint buffer);
+void glstate_deletedFramebuffer(GLuint fbo);
+
+// Changes whenever a texture or renderbuffer is deleted. A framebuffer that
+// remembers its attachments by name can't trust them after that, since a new
+// object might have been given the same name.
+unsigned long glstate_attachmentGeneration(void);
+
+#ifdef DEBUG_GLSTATE
+// Print the counts since the last call, and start over
+void glstate_printStats(void);
+#endif
@@ -0,0 +1,162 @@
+#include "gpumem.h"
+
+#include "window.h"
+#include "blur.h"
+#include "shadow.h"
+#include "texture.h"
+#include "renderbuffer.h"
+
+#include <stdio.h>
+
+// The contents of a window can only be evicted if we can copy them from the
+// pixmap again. Windows on the way out might not have one anymore.
+static bool contents_refetchable(Swiss* em, win_id wid) {
+    if(!swiss_hasComponent(em, COMPONENT_BINDS_TEXTURE, wid))
+        return false;
+    if(!swiss_hasComponent(em, COMPONENT_STATEFUL, wid))
+        return false;
+
+    struct StatefulComponent* stateful = swiss_getComponent(em, COMPONENT_STATEFUL, wid);
+    switch(stateful->state) {
+        case STATE_HIDING:
+        case STATE_INVISIBLE:
+        case STATE_DESTROYING:
+        case STATE_DESTROYED:
+            return false;
+        default:
+            return true;
+    }
+}
+
+size_t gpumem_windowBytes(Swiss* em, win_id wid) {
+    size_t bytes = 0;
+
+    if(swiss_hasComponent(em, COMPONENT_TEXTURED, wid)) {
+        struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, wid);
+        bytes += textured->texture.bytes;
+    }
+
+    if(swiss_hasComponent(em, COMPONENT_SHADOW, wid)) {
+        struct glx_shadow_cache* shadow = swiss_getComponent(em, COMPONENT_SHADOW, wid);
+        bytes += shadow->effect.bytes;
+    }
+
+    if(swiss_hasComponent(em, COMPONENT_BLUR, wid)) {
+        struct glx_blur_cache* blur = swiss_getComponent(em, COMPONENT_BLUR, wid);
+        bytes += blur->texture.bytes;
+    }
+
+    return bytes;
+}
+
+size_t gpumem_totalBytes() {
+    return texture_allocatedBytes() + renderbuffer_allocatedBytes();
+}
+
+static void evict_window(Swiss* em, win_id wid) {
+    if(swiss_hasComponent(em, COMPONENT_SHADOW, wid)) {
+        struct glx_shadow_cache* shadow = swiss_getComponent(em, COMPONENT_SHADOW, wid);
+        if(shadow->initialized && shadow->effect.hasSpace)
+            texture_evict(&shadow->effect);
+    }
+
+    if(swiss_hasComponent(em, COMPONENT_BLUR, wid)) {
+        struct glx_blur_cache* blur = swiss_getComponent(em, COMPONENT_BLUR, wid);
+        if(blur->texture.hasSpace)
+            texture_evict(&blur->texture);
+    }
+
+    if(swiss_hasComponent(em, COMPONENT_TEXTURED, wid) && contents_refetchable(em, wid)) {
+        struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, wid);
+        if(textured->texture.hasSpace)
+            texture_evict(&textured->texture);
+    }
+}
+
+void gpumem_evict(Swiss* em, const Vector* order, size_t budget) {
+    // No budget, we can use as much as we like
+    if(budget == 0)
+        return;
+
+    if(gpumem_totalBytes() <= budget)
+        return;
+
+    // The contents texture of a window we sample directly isn't used at
+    // all, so it's free to give up
+    for_components(it, em,
+            COMPONENT_TEXTURED, CQ_END) {
+        struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, it.id);
+        if(!textured->direct || !textured->texture.hasSpace)
+            continue;
+
+        texture_evict(&textured->texture);
+        if(gpumem_totalBytes() <= budget)
+            return;
+    }
+
+    // The windows at the bottom of the stack are the least likely to be
+    // uncovered soon
+    size_t index;
+    const win_id* wid = vector_getFirst(order, &index);
+    while(wid != NULL) {
+        if(swiss_hasComponent(em, COMPONENT_OCCLUDED, *wid)) {
+            evict_window(em, *wid);
+            if(gpumem_totalBytes() <= budget)
+                return;
+        }
+        wid = vector_getNext(order, &index);
+    }
+}
+
+void gpumem_restore(Swiss* em) {
+    for_components(it, em,
+            COMPONENT_SHADOW, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
+        struct glx_shadow_cache* shadow = swiss_getComponent(em, COMPONENT_SHADOW, it.id);
+        if(!shadow->effect.evicted)
+            continue;
+
+        texture_restore(&shadow->effect);
+        swiss_ensureComponent(em, COMPONENT_SHADOW_DAMAGED, it.id);
+    }
+
+    for_components(it, em,
+            COMPONENT_BLUR, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
+        struct glx_blur_cache* blur = swiss_getComponent(em, COMPONENT_BLUR, it.id);
+        if(!blur->texture.evicted)
+            continue;
+
+        texture_restore(&blur->texture);
+        swiss_ensureComponent(em, COMPONENT_BLUR_DAMAGED, it.id);
+    }
+
+    // Windows we sample directly get their contents back when they stop
+    // doing that, see copy_window_texture
+    for_components(it, em,
+            COMPONENT_TEXTURED, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
+        struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, it.id);
+        if(!textured->texture.evicted || textured->direct)
+            continue;
+
+        texture_restore(&textured->texture);
+        if(swiss_hasComponent(em, COMPONENT_BINDS_TEXTURE, it.id))
+            win_damageContents(em, it.id);
+    }
+}
+
+void gpumem_report(Swiss* em) {
+    static size_t last_total = 0;
+
+    size_t total = gpumem_totalBytes();
+    if(total == last_total)
+        return;
+    last_total = total;
+
+    printf("GPU memory: %zu KiB, %zu KiB in textures, %zu KiB in render buffers\n",
+            total / 1024, texture_allocatedBytes() / 1024,
+            renderbuffer_allocatedBytes() / 1024);
+
+    for_components(it, em,
+            COMPONENT_TEXTURED, CQ_END) {
+        printf("    Window %zu: %zu KiB\n", it.id, gpumem_windowBytes(em, it.id) / 1024);
+    }
+}
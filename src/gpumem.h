@@ -0,0 +1,35 @@
+#pragma once
+
+#include "swiss.h"
+#include "vector.h"
+
+#include <stddef.h>
+
+// Every window keeps a few textures around: its contents, and the shadow and
+// blurred background if it has those. The textures and render buffers count
+// the storage they allocate, and this is where we add that up per window.
+//
+// With a budget set, we free the storage of the textures we can draw again
+// later until we are under it. That's the contents of windows we sample
+// straight from the pixmap, followed by everything of the windows nobody can
+// see, lowest in the stack first. When a window comes back into view the
+// storage is allocated again, and the damage from becoming visible redraws
+// it.
+
+// Bytes held by the textures of a single window
+size_t gpumem_windowBytes(Swiss* em, win_id wid);
+
+// Bytes held by all textures and render buffers
+size_t gpumem_totalBytes();
+
+// Evict textures until we use less than budget bytes, or we run out of
+// things to evict. order is the stacking order of the windows, bottom first.
+void gpumem_evict(Swiss* em, const Vector* order, size_t budget);
+
+// Allocate the evicted textures of windows that have become visible again.
+// Has to run after the occlusion is known, and before any of the textures are
+// redrawn.
+void gpumem_restore(Swiss* em);
+
+// Print the total and per window usage, if it changed since last time
+void gpumem_report(Swiss* em);
@@ -22,6 +22,7 @@
 #include "shaders/shaderinfo.h"
 
 #include "renderutil.h"
+#include "glstate.h"
 
 static inline GLXFBConfig get_fbconfig_from_visualinfo(session_t *ps, const XVisualInfo *visualinfo) {
   int nelements = 0;
@@ -146,6 +147,9 @@ glx_init(session_t *ps, bool need_render) {
       goto glx_init_end;
     }
 
+    // Nothing we knew about the old context holds for this one
+    glstate_reset();
+
 #ifdef DEBUG_GLX_DEBUG_CONTEXT
     {
       f_DebugMessageCallback p_DebugMessageCallback =
@@ -201,6 +205,20 @@ glx_init(session_t *ps, bool need_render) {
       goto glx_init_end;
     }
 
+    if (ps->o.glx_use_copysubbuffermesa) {
+      psglx->glXCopySubBufferProc = (f_CopySubBuffer)
+        glXGetProcAddress((const GLubyte *) "glXCopySubBufferMESA");
+      if (!psglx->glXCopySubBufferProc) {
+        printf_errf("(): Failed to acquire glXCopySubBufferMESA().");
+        goto glx_init_end;
+      }
+    }
+
+    // Without buffer age we don't know what's in the back buffer, and have
+    // to repaint all of it
+    psglx->has_buffer_age = ps->o.glx_swap_method == SWAPM_BUFFER_AGE
+      && glx_hasglxext(ps, "GLX_EXT_buffer_age");
+
 #ifdef CONFIG_GLX_SYNC
     psglx->glFenceSyncProc = (f_FenceSync)
       glXGetProcAddress((const GLubyte *) "glFenceSync");
@@ -215,11 +233,18 @@ glx_init(session_t *ps, bool need_render) {
     psglx->glImportSyncEXT = (f_ImportSyncEXT)
       glXGetProcAddress((const GLubyte *) "glImportSyncEXT");
     if (!psglx->glFenceSyncProc || !psglx->glIsSyncProc || !psglx->glDeleteSyncProc
-        || !psglx->glClientWaitSyncProc || !psglx->glWaitSyncProc
-        || !psglx->glImportSyncEXT) {
+        || !psglx->glClientWaitSyncProc || !psglx->glWaitSyncProc) {
       printf_errf("(): Failed to acquire GLX sync functions.");
       goto glx_init_end;
     }
+
+    // Without X11 sync objects we fall back to waiting for the fences from
+    // the CPU
+    psglx->has_x11_sync = psglx->glImportSyncEXT
+      && glx_hasglext(ps, "GL_EXT_x11_sync_object");
+    if (!psglx->has_x11_sync) {
+      printf_dbgf("No GL_EXT_x11_sync_object, waiting for X on the CPU.");
+    }
 #endif
   }
 
@@ -233,6 +258,29 @@ glx_init(session_t *ps, bool need_render) {
       goto glx_init_end;
   }
 
+  if (need_render && !uniformbuffer_init(&psglx->uniforms)) {
+    printf_errf("Failed initializing the uniform buffers");
+    goto glx_init_end;
+  }
+
+  if (need_render && !rendertargetpool_init(&psglx->targets)) {
+    printf_errf("Failed initializing the render target pool");
+    goto glx_init_end;
+  }
+
+  if (need_render && !face_arena_init()) {
+    printf_errf("Failed initializing the face arena");
+    goto glx_init_end;
+  }
+
+  // Without instanced arrays every window is drawn on its own
+  if (need_render && glx_hasglext(ps, "GL_ARB_instanced_arrays")) {
+    if (!windowbatch_init(&psglx->window_batch)) {
+      printf_errf("Failed initializing the window batch");
+      goto glx_init_end;
+    }
+  }
+
   success = true;
 
 glx_init_end:
@@ -270,15 +318,11 @@ glx_destroy(session_t *ps) {
 
   glx_check_err(ps);
 
-  // Free FBConfigs
-  for (int i = 0; i <= OPENGL_MAX_DEPTH; ++i) {
-    free(ps->psglx->fbconfigs[i]);
-    ps->psglx->fbconfigs[i] = NULL;
-  }
-
-  xorgContext_delete(&ps->xcontext);
-
   framebuffer_delete(&ps->psglx->stencil_fbo);
+  windowbatch_delete(&ps->psglx->window_batch);
+  uniformbuffer_delete(&ps->psglx->uniforms);
+  face_arena_delete();
+  rendertargetpool_delete(&ps->psglx->targets);
 
   // Destroy GLX context
   if (ps->psglx->context) {
@@ -7,8 +7,10 @@
 #include "../assets/assets.h"
 #include "../assets/face.h"
 #include "../assets/shader.h"
+#include "../assets/handles.h"
 #include "../shaders/shaderinfo.h"
 #include "../renderutil.h"
+#include "../glstate.h"
 
 #define NS_PER_MS  1000000L
 #define NS_PER_SEC 1000000000L
@@ -120,22 +122,18 @@ static void process(struct ZoneEventStream* stream) {
 }
 
 static void draw(const Vector2* pos, const Vector2* size) {
-    struct face* face = assets_load("window.face");
+    struct face* face = asset_handles.window_face;
 
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glstate_bindFramebuffer(GL_FRAMEBUFFER, 0);
 
     static const GLenum DRAWBUFS[2] = { GL_BACK_LEFT };
     glDrawBuffers(1, DRAWBUFS);
 
-    struct shader_program* profiler_program = assets_load("profiler.shader");
-    if(profiler_program->shader_type_info != &profiler_info) {
-        printf("Shader was not a profiler shader\n");
-        return;
-    }
-    struct Profiler* profiler_type = profiler_program->shader_type;
+    struct shader_program* profiler_program = asset_handles.profiler.program;
+    struct Profiler* profiler_type = asset_handles.profiler.type;
     Vector3 color = {{.45, .2, .3}};
     shader_set_future_uniform_vec3(profiler_type->color, &color);
     shader_use(profiler_program);
@@ -168,7 +166,7 @@ static void draw(const Vector2* pos, const Vector2* size) {
         }
     }
 
-    glEnable(GL_SCISSOR_TEST);
+    glstate_enable(GL_SCISSOR_TEST);
 
     Vector2 textscale = {{1, 1}};
     {
@@ -177,7 +175,7 @@ static void draw(const Vector2* pos, const Vector2* size) {
 
         Vector2 boxScale = {{size->x, bar_height}};
         Vector2 boxPos = {{pos->x, pos->y}};
-        glScissor(boxPos.x, boxPos.y, boxScale.x, boxScale.y);
+        glstate_scissor(boxPos.x, boxPos.y, boxScale.x, boxScale.y);
 
         {
             text_size(&debug_font, root_zone->name, &textscale, &scale);
@@ -208,7 +206,7 @@ static void draw(const Vector2* pos, const Vector2* size) {
             float width = (block->end - block->start) * size->x;
             Vector2 boxScale = {{width, bar_height}};
             Vector2 boxPos = {{block->start * size->x, bar_height * (track+1) + pos->y}};
-            glScissor(boxPos.x, boxPos.y, boxScale.x, boxScale.y);
+            glstate_scissor(boxPos.x, boxPos.y, boxScale.x, boxScale.y);
 
             {
                 text_size(&debug_font, block->zone->name, &textscale, &scale);
@@ -235,7 +233,7 @@ static void draw(const Vector2* pos, const Vector2* size) {
             }
         }
     }
-    glDisable(GL_SCISSOR_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
 }
 
 void profiler_render(struct ZoneEventStream* event_stream) {
@@ -1,7 +1,25 @@
 #include "renderbuffer.h"
 
+#include "glstate.h"
+
 #include <assert.h>
 
+// All the storage we have allocated for render buffers
+static size_t allocated_bytes = 0;
+
+static void account(struct RenderBuffer* buffer, const Vector2* size) {
+    size_t bytes = 0;
+    // Both the color and the depth/stencil formats we use are 4 bytes a
+    // pixel
+    if(size != NULL)
+        bytes = (size_t)size->x * (size_t)size->y * 4;
+
+    assert(allocated_bytes >= buffer->bytes);
+    allocated_bytes -= buffer->bytes;
+    allocated_bytes += bytes;
+    buffer->bytes = bytes;
+}
+
 static GLuint generate_buffer(const Vector2* size, GLenum type) {
     GLuint b = 0;
 
@@ -29,6 +47,8 @@ int renderbuffer_init(struct RenderBuffer* buffer, const Vector2* size) {
     }
 
     buffer->type = BUFFERTYPE_COLOR;
+    buffer->bytes = 0;
+    account(buffer, size);
     if(size != NULL)
         buffer->size = *size;
 
@@ -43,6 +63,8 @@ int renderbuffer_stencil_init(struct RenderBuffer* buffer, const Vector2* size)
     }
 
     buffer->type = BUFFERTYPE_STENCIL;
+    buffer->bytes = 0;
+    account(buffer, size);
 
     // If the size was NULL, then we didn't allocate any space in the
     // generate_buffer call
@@ -65,6 +87,7 @@ void renderbuffer_resize(struct RenderBuffer* buffer, const Vector2* size) {
 
     glBindRenderbuffer(GL_RENDERBUFFER, buffer->gl_buffer);
     glRenderbufferStorage(GL_RENDERBUFFER, buffer->gl_type, size->x, size->y);
+    account(buffer, size);
 
     buffer->hasSpace = true;
     buffer->size = *size;
@@ -72,12 +95,18 @@ void renderbuffer_resize(struct RenderBuffer* buffer, const Vector2* size) {
 
 
 void renderbuffer_delete(struct RenderBuffer* buffer) {
+    account(buffer, NULL);
     glDeleteRenderbuffers(1, &buffer->gl_buffer);
+    glstate_deletedRenderbuffer(buffer->gl_buffer);
     buffer->gl_buffer = 0;
     buffer->size.x = 0;
     buffer->size.y = 0;
 }
 
+size_t renderbuffer_allocatedBytes() {
+    return allocated_bytes;
+}
+
 void renderbuffer_bind_to_framebuffer(struct RenderBuffer* buffer, GLenum attachment) {
     assert(buffer != NULL);
     assert(renderbuffer_initialized(buffer));
@@ -5,6 +5,8 @@
 
 #include "vmath.h"
 
+#include <stddef.h>
+
 enum BufferType {
     BUFFERTYPE_COLOR,
     BUFFERTYPE_STENCIL,
@@ -18,6 +20,9 @@ struct RenderBuffer {
     bool hasSpace;
 
     enum BufferType type;
+
+    // Bytes of storage we allocated for this buffer
+    size_t bytes;
 };
 
 int renderbuffer_init(struct RenderBuffer* buffer, const Vector2* size);
@@ -27,4 +32,7 @@ void renderbuffer_delete(struct RenderBuffer* buffer);
 bool renderbuffer_initialized(struct RenderBuffer* buffer);
 void renderbuffer_resize(struct RenderBuffer* buffer, const Vector2* size);
 
+// The storage allocated by all render buffers together
+size_t renderbuffer_allocatedBytes();
+
 void renderbuffer_bind_to_framebuffer(struct RenderBuffer* buffer, GLenum attachment);
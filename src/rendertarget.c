@@ -0,0 +1,141 @@
+#include "rendertarget.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "logging.h"
+
+static Vector2 bucket_of(const Vector2* size) {
+    Vector2 bucket = {{
+        ceil(size->x / RENDERTARGET_BUCKET) * RENDERTARGET_BUCKET,
+        ceil(size->y / RENDERTARGET_BUCKET) * RENDERTARGET_BUCKET,
+    }};
+    return bucket;
+}
+
+static struct RenderTarget* target_create(const Vector2* bucket, enum TextureFormat format) {
+    struct RenderTarget* target = calloc(1, sizeof(struct RenderTarget));
+    if(target == NULL)
+        return NULL;
+
+    target->bucket = *bucket;
+    target->format = format;
+
+    if(!framebuffer_init(&target->fbo)) {
+        printf_errf("Failed creating render target framebuffer");
+        free(target);
+        return NULL;
+    }
+
+    if(texture_init(&target->texture, GL_TEXTURE_2D, NULL, format) != 0) {
+        printf_errf("Failed creating render target texture");
+        framebuffer_delete(&target->fbo);
+        free(target);
+        return NULL;
+    }
+
+    if(renderbuffer_stencil_init(&target->stencil, bucket) != 0) {
+        printf_errf("Failed creating render target stencil");
+        texture_delete(&target->texture);
+        framebuffer_delete(&target->fbo);
+        free(target);
+        return NULL;
+    }
+
+    return target;
+}
+
+static void target_delete(struct RenderTarget* target) {
+    framebuffer_delete(&target->fbo);
+    texture_delete(&target->texture);
+    renderbuffer_delete(&target->stencil);
+    free(target);
+}
+
+bool rendertargetpool_init(struct RenderTargetPool* pool) {
+    vector_init(&pool->targets, sizeof(struct RenderTarget*), 16);
+    pool->frame = 0;
+    pool->initialized = true;
+    return true;
+}
+
+void rendertargetpool_delete(struct RenderTargetPool* pool) {
+    if(!pool->initialized)
+        return;
+
+    size_t index;
+    struct RenderTarget** target = vector_getFirst(&pool->targets, &index);
+    while(target != NULL) {
+        assert(!(*target)->in_use);
+        target_delete(*target);
+        target = vector_getNext(&pool->targets, &index);
+    }
+    vector_kill(&pool->targets);
+    pool->initialized = false;
+}
+
+struct RenderTarget* rendertargetpool_acquire(struct RenderTargetPool* pool, const Vector2* size,
+        enum TextureFormat format) {
+    assert(pool->initialized);
+
+    Vector2 bucket = bucket_of(size);
+
+    struct RenderTarget* found = NULL;
+    size_t index;
+    struct RenderTarget** target = vector_getFirst(&pool->targets, &index);
+    while(target != NULL) {
+        if(!(*target)->in_use && (*target)->format == format
+                && vec2_eq(&(*target)->bucket, &bucket)) {
+            found = *target;
+            break;
+        }
+        target = vector_getNext(&pool->targets, &index);
+    }
+
+    if(found == NULL) {
+        found = target_create(&bucket, format);
+        if(found == NULL)
+            return NULL;
+        vector_putBack(&pool->targets, &found);
+    }
+
+    // Within the bucket this doesn't touch the storage
+    texture_resize(&found->texture, size, format);
+
+    found->in_use = true;
+    found->last_used = pool->frame;
+    return found;
+}
+
+void rendertargetpool_release(struct RenderTargetPool* pool, struct RenderTarget* target) {
+    assert(target->in_use);
+    target->in_use = false;
+}
+
+void rendertargetpool_trim(struct RenderTargetPool* pool) {
+    assert(pool->initialized);
+
+    size_t index = 0;
+    while(index < vector_size(&pool->targets)) {
+        struct RenderTarget* target = *(struct RenderTarget**)vector_get(&pool->targets, index);
+        assert(!target->in_use);
+
+        if(pool->frame - target->last_used > RENDERTARGET_IDLE_FRAMES) {
+            target_delete(target);
+            vector_remove(&pool->targets, index);
+            continue;
+        }
+        index++;
+    }
+
+    pool->frame++;
+}
+
+int rendertarget_bind(struct RenderTarget* target) {
+    framebuffer_resetTarget(&target->fbo);
+    framebuffer_targetTexture(&target->fbo, &target->texture);
+    framebuffer_targetRenderBuffer_stencil(&target->fbo, &target->stencil);
+    return framebuffer_bind(&target->fbo);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vmath.h"
+#include "vector.h"
+#include "texture.h"
+#include "renderbuffer.h"
+#include "framebuffer.h"
+
+#include <stdbool.h>
+
+// Passes like rendering a shadow or blurring the background need a scratch
+// color texture and a depth/stencil buffer, but only while the pass runs.
+// Instead of every cache owning those they borrow a render target from the
+// pool, and only keep their final texture.
+//
+// Targets are grouped by format and size, rounded up to a bucket. The buckets match
+// the texture size classes, so every size in a bucket fits the storage of
+// the texture and the depth/stencil buffer without reallocating.
+
+#define RENDERTARGET_BUCKET TEXTURE_SIZE_CLASS
+
+// Targets nobody has borrowed for this many frames are freed
+#define RENDERTARGET_IDLE_FRAMES 120
+
+struct RenderTarget {
+    bool in_use;
+    Vector2 bucket;
+    enum TextureFormat format;
+    unsigned long last_used;
+
+    struct Framebuffer fbo;
+    struct Texture texture;
+    struct RenderBuffer stencil;
+};
+
+struct RenderTargetPool {
+    bool initialized;
+    unsigned long frame;
+
+    // Of struct RenderTarget*, so borrowed targets don't move when the pool
+    // grows
+    Vector targets;
+};
+
+bool rendertargetpool_init(struct RenderTargetPool* pool);
+void rendertargetpool_delete(struct RenderTargetPool* pool);
+
+// Borrow a target with a texture of the given size and format, or NULL if
+// one couldn't be created. Has to be given back before the end of the frame.
+struct RenderTarget* rendertargetpool_acquire(struct RenderTargetPool* pool, const Vector2* size,
+        enum TextureFormat format);
+void rendertargetpool_release(struct RenderTargetPool* pool, struct RenderTarget* target);
+
+// Free the targets that have been idle for a while, called once a frame
+void rendertargetpool_trim(struct RenderTargetPool* pool);
+
+// Bind the framebuffer of the target with its own texture and stencil
+int rendertarget_bind(struct RenderTarget* target);
@@ -0,0 +1,93 @@
+#include "screendamage.h"
+
+static struct ScreenDamageBox* box_at(struct ScreenDamage* damage, size_t age) {
+    return &damage->history[(damage->head + age) % SCREENDAMAGE_HISTORY];
+}
+
+static const struct ScreenDamageBox* box_at_const(const struct ScreenDamage* damage, size_t age) {
+    return &damage->history[(damage->head + age) % SCREENDAMAGE_HISTORY];
+}
+
+static void box_full(struct ScreenDamageBox* box, const Vector2* size) {
+    box->empty = false;
+    box->min = (Vector2){{0, 0}};
+    box->max = *size;
+}
+
+static void box_union(struct ScreenDamageBox* box, const struct ScreenDamageBox* other) {
+    if(other->empty)
+        return;
+
+    if(box->empty) {
+        *box = *other;
+        return;
+    }
+
+    vec2_min(&box->min, &other->min);
+    vec2_max(&box->max, &other->max);
+}
+
+void screendamage_init(struct ScreenDamage* damage, const Vector2* size) {
+    damage->head = 0;
+    screendamage_resize(damage, size);
+}
+
+void screendamage_resize(struct ScreenDamage* damage, const Vector2* size) {
+    damage->size = *size;
+    for(size_t i = 0; i < SCREENDAMAGE_HISTORY; i++) {
+        box_full(&damage->history[i], size);
+    }
+}
+
+void screendamage_add(struct ScreenDamage* damage, const Vector2* pos, const Vector2* size) {
+    struct ScreenDamageBox box = {
+        .empty = false,
+        .min = *pos,
+        .max = *pos,
+    };
+    vec2_add(&box.max, size);
+
+    // Clip to the screen
+    vec2_max(&box.min, &(Vector2){{0, 0}});
+    vec2_min(&box.max, &damage->size);
+    if(box.max.x <= box.min.x || box.max.y <= box.min.y)
+        return;
+
+    box_union(box_at(damage, 0), &box);
+}
+
+void screendamage_addAll(struct ScreenDamage* damage) {
+    box_full(box_at(damage, 0), &damage->size);
+}
+
+bool screendamage_empty(const struct ScreenDamage* damage) {
+    return box_at_const(damage, 0)->empty;
+}
+
+void screendamage_region(const struct ScreenDamage* damage, int age, Vector2* pos, Vector2* size) {
+    struct ScreenDamageBox region;
+    if(age <= 0 || age > SCREENDAMAGE_HISTORY) {
+        box_full(&region, &damage->size);
+    } else {
+        region.empty = true;
+        for(size_t i = 0; i < (size_t)age; i++) {
+            box_union(&region, box_at_const(damage, i));
+        }
+    }
+
+    if(region.empty) {
+        *pos = (Vector2){{0, 0}};
+        *size = (Vector2){{0, 0}};
+        return;
+    }
+
+    *pos = region.min;
+    *size = region.max;
+    vec2_sub(size, &region.min);
+}
+
+void screendamage_next(struct ScreenDamage* damage) {
+    // Step the head back, making the oldest box the new current one
+    damage->head = (damage->head + SCREENDAMAGE_HISTORY - 1) % SCREENDAMAGE_HISTORY;
+    box_at(damage, 0)->empty = true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "vmath.h"
+
+#include <stdbool.h>
+
+// The screen damage is the part of the screen that has to be repainted this
+// frame, in X coordinates. It's kept as a bounding box, which is a lot
+// cheaper than a proper region and is all a single scissor rect can use
+// anyway.
+//
+// With buffer age the back buffer we are drawing into holds a frame from a
+// few swaps ago, so the damage of the frames since then has to be repainted
+// as well. To allow for that we keep the boxes of the last few frames.
+
+// Matches the largest age allowed for --glx-swap-method
+#define SCREENDAMAGE_HISTORY 6
+
+struct ScreenDamageBox {
+    bool empty;
+    Vector2 min;
+    Vector2 max;
+};
+
+struct ScreenDamage {
+    Vector2 size;
+    // The current frame is at the head, then in order of age
+    struct ScreenDamageBox history[SCREENDAMAGE_HISTORY];
+    size_t head;
+};
+
+void screendamage_init(struct ScreenDamage* damage, const Vector2* size);
+
+// Everything we have painted is of the wrong size, so this damages the entire
+// history
+void screendamage_resize(struct ScreenDamage* damage, const Vector2* size);
+
+void screendamage_add(struct ScreenDamage* damage, const Vector2* pos, const Vector2* size);
+void screendamage_addAll(struct ScreenDamage* damage);
+
+bool screendamage_empty(const struct ScreenDamage* damage);
+
+// Get the box that has to be repainted into a back buffer of the given age.
+// Unknown ages (0 or older than the history) get the whole screen.
+void screendamage_region(const struct ScreenDamage* damage, int age, Vector2* pos, Vector2* size);
+
+// Move on to the next frame, should be called after every present
+void screendamage_next(struct ScreenDamage* damage);
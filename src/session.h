@@ -11,6 +11,11 @@
 #include "swiss.h"
 #include "vector.h"
 #include "winprop.h"
+#include "xbatch.h"
+#include "screendamage.h"
+#include "windowbatch.h"
+#include "uniformbuffer.h"
+#include "rendertarget.h"
 
 #include <X11/extensions/Xinerama.h>
 
@@ -33,6 +38,51 @@ typedef void (*f_ReleaseTexImageEXT) (Display *display, GLXDrawable drawable, in
 
 typedef void (*f_CopySubBuffer) (Display *dpy, GLXDrawable drawable, int x, int y, int width, int height);
 
+#ifdef CONFIG_GLX_SYNC
+// Looks like duplicate typedef of the same type is safe?
+typedef int64_t GLint64;
+typedef uint64_t GLuint64;
+typedef struct __GLsync *GLsync;
+
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+#ifndef GL_TIMEOUT_IGNORED
+#define GL_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
+#endif
+
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED 0x911D
+#endif
+
+#ifndef GL_SYNC_X11_FENCE_EXT
+#define GL_SYNC_X11_FENCE_EXT 0x90E1
+#endif
+
+typedef GLsync (*f_FenceSync) (GLenum condition, GLbitfield flags);
+typedef GLboolean (*f_IsSync) (GLsync sync);
+typedef void (*f_DeleteSync) (GLsync sync);
+typedef GLenum (*f_ClientWaitSync) (GLsync sync, GLbitfield flags,
+    GLuint64 timeout);
+typedef void (*f_WaitSync) (GLsync sync, GLbitfield flags,
+    GLuint64 timeout);
+typedef GLsync (*f_ImportSyncEXT) (GLenum external_sync_type,
+    GLintptr external_sync, GLbitfield flags);
+#endif
+
 
 #define CGLX_SESSION_INIT { .context = NULL }
 
@@ -66,14 +116,6 @@ typedef enum {
   NUM_VSYNC,
 } vsync_t;
 
-/// @brief Wrapper of a GLX FBConfig.
-typedef struct {
-  GLXFBConfig cfg;
-  GLint texture_fmt;
-  GLint texture_tgts;
-  bool y_inverted;
-} glx_fbconfig_t;
-
 /// Structure representing all options.
 typedef struct _options_t {
   // === General ===
@@ -88,10 +130,14 @@ typedef struct _options_t {
   char *display_repr;
   /// GLX swap method we assume OpenGL uses.
   int glx_swap_method;
+  /// Whether to present with glXCopySubBufferMESA instead of swapping.
+  bool glx_use_copysubbuffermesa;
   /// Whether to fork to background.
   bool fork_after_register;
   /// Blur Level
   int blur_level;
+  /// Video memory budget for window textures in MiB, 0 for none.
+  int gpu_memory_budget;
   /// Whether to stop painting. Controlled through D-Bus.
   switch_t stoppaint_force;
   /// Whether to re-redirect screen on root size change.
@@ -221,6 +267,8 @@ typedef struct {
   f_ReleaseTexImageEXT glXReleaseTexImageProc;
   /// Pointer to glXCopySubBufferMESA function.
   f_CopySubBuffer glXCopySubBufferProc;
+  /// Whether we have GLX_EXT_buffer_age.
+  bool has_buffer_age;
 #ifdef CONFIG_GLX_SYNC
   /// Pointer to the glFenceSync() function.
   f_FenceSync glFenceSyncProc;
@@ -234,6 +282,9 @@ typedef struct {
   f_WaitSync glWaitSyncProc;
   /// Pointer to the glImportSyncEXT() function.
   f_ImportSyncEXT glImportSyncEXT;
+  /// Whether we have GL_EXT_x11_sync_object, and can have the GPU wait for
+  /// X fences.
+  bool has_x11_sync;
 #endif
 #ifdef DEBUG_GLX_MARK
   /// Pointer to StringMarkerGREMEDY function.
@@ -242,13 +293,16 @@ typedef struct {
   f_FrameTerminatorGREMEDY glFrameTerminatorGREMEDY;
 #endif
   struct blur blur;
+  // Draws the opaque windows, only initialized with instanced arrays
+  struct WindowBatch window_batch;
+  // The uniform blocks shared between programs
+  struct UniformBuffer uniforms;
+  // Scratch targets for the shadow and blur passes
+  struct RenderTargetPool targets;
   /// Current GLX Z value.
   int z;
   // Standard view matrix
   Matrix view;
-  /// FBConfig-s for GLX pixmap of different depths.
-  glx_fbconfig_t *fbconfigs[OPENGL_MAX_DEPTH + 1];
-
   // @MEMORY @PERFORMANCE: We don't need a dedicated FBO for just stencil, but
   // for right now I don't want to bother with that
   struct Framebuffer stencil_fbo;
@@ -269,6 +323,15 @@ typedef struct _session_t {
     /// Root window.
     Window root;
     Vector2 root_size;
+    /// Whether the input cutout of the overlay has to be rebuilt even if no
+    /// unredirected window changed, like when the root is resized.
+    bool cutout_dirty;
+    /// Part of the screen that has to be repainted.
+    struct ScreenDamage screen_damage;
+    /// Bounding box of the part of the root not covered by opaque windows.
+    /// The size is zero if all of it is covered.
+    Vector2 root_visible_pos;
+    Vector2 root_visible_size;
     // Damage of root window.
     // Damage root_damage;
     /// X Composite overlay window. Used if <code>--paint-on-overlay</code>.
@@ -300,8 +363,7 @@ typedef struct _session_t {
     struct _timeout_t *tmout_lst;
     /// Whether we have received an event in this cycle.
     bool skip_poll;
-    /// Whether the program is idling. I.e. no fading, no potential window
-    /// changes.
+    /// Whether the program is idling. I.e. no screen damage this frame.
     bool idling;
     /// Program start time.
     struct timeval time_start;
@@ -312,6 +374,10 @@ typedef struct _session_t {
     ignore_t **ignore_tail;
     /// Reset program after next paint.
     bool reset;
+    /// Events drained from the X queue in the current cycle.
+    Vector event_batch;
+    /// Scratch space for coalescing the event batch, one entry per entity.
+    Vector event_coalesce;
 
     // === Window related ===
     // Swiss of windows
@@ -349,6 +415,8 @@ typedef struct _session_t {
 #endif
 
   struct X11Context xcontext;
+  // Requests issued this frame, which are collected by the systems
+  struct XBatch xbatch;
 } session_t;
 
 winprop_t
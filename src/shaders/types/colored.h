@@ -4,7 +4,6 @@
 
 #define UNIFORMS_FOREACH(M) \
     M(mvp)                  \
-    M(viewport)             \
     M(opacity)              \
     M(color)
-#define UNIFORMS_COUNT 4
+#define UNIFORMS_COUNT 3
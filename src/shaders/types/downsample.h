@@ -5,6 +5,7 @@
 #define UNIFORMS_FOREACH(M) \
     M(mvp)                  \
     M(flip)                 \
+    M(uvscale)              \
     M(opacity)              \
     M(tex_scr)
-#define UNIFORMS_COUNT 4
+#define UNIFORMS_COUNT 5
@@ -3,11 +3,5 @@
 #define SHADER_STRUCT_NAME Global
 
 #define UNIFORMS_FOREACH(M) \
-    M(mvp)                  \
-    M(tex_scr)              \
-    M(flip)                 \
-    M(invert)               \
-    M(dim)                  \
-    M(uvscale)              \
-    M(opacity)
-#define UNIFORMS_COUNT 7
+    M(tex_scr)
+#define UNIFORMS_COUNT 1
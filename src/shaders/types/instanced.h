@@ -0,0 +1,7 @@
+#define SHADER_NAME instanced
+#define SHADER_INFO_NAME instanced_info
+#define SHADER_STRUCT_NAME Instanced
+
+#define UNIFORMS_FOREACH(M) \
+    M(tex_scr)
+#define UNIFORMS_COUNT 1
@@ -5,5 +5,6 @@
 #define UNIFORMS_FOREACH(M) \
     M(mvp)                  \
     M(tex_scr)              \
-    M(flip)
-#define UNIFORMS_COUNT 3
+    M(flip)                 \
+    M(uvscale)
+#define UNIFORMS_COUNT 4
@@ -2,10 +2,13 @@
 
 #include "assets/assets.h"
 #include "assets/shader.h"
+#include "assets/handles.h"
 #include "shaders/shaderinfo.h"
 #include "textureeffects.h"
+#include "rendertarget.h"
 
 #include "renderutil.h"
+#include "glstate.h"
 
 #include <assert.h>
 
@@ -15,21 +18,9 @@ int shadow_cache_init(struct glx_shadow_cache* cache) {
     Vector2 border = {{SHADOW_RADIUS, SHADOW_RADIUS}};
     cache->border = border;
 
-    if(texture_init(&cache->texture, GL_TEXTURE_2D, NULL) != 0) {
-        printf("Couldn't create texture for shadow\n");
-        return 1;
-    }
-
-    if(texture_init(&cache->effect, GL_TEXTURE_2D, NULL) != 0) {
+    // The shadow takes the color of the window, so it isn't just a mask
+    if(texture_init(&cache->effect, GL_TEXTURE_2D, NULL, TEXTUREFORMAT_RGBA8) != 0) {
         printf("Couldn't create effect texture for shadow\n");
-        texture_delete(&cache->texture);
-        return 1;
-    }
-
-    if(renderbuffer_stencil_init(&cache->stencil, NULL) != 0) {
-        printf("Couldn't create renderbuffer stencil for shadow\n");
-        texture_delete(&cache->texture);
-        texture_delete(&cache->effect);
         return 1;
     }
     cache->initialized = true;
@@ -45,10 +36,7 @@ int shadow_cache_resize(struct glx_shadow_cache* cache, const Vector2* size) {
     vec2_imul(&overflowSize, 2);
     vec2_add(&overflowSize, size);
 
-    texture_resize(&cache->texture, &overflowSize);
-    texture_resize(&cache->effect, &overflowSize);
-
-    renderbuffer_resize(&cache->stencil, &overflowSize);
+    texture_resize(&cache->effect, &overflowSize, cache->effect.format);
 
     return 0;
 }
@@ -57,30 +45,28 @@ void shadow_cache_delete(struct glx_shadow_cache* cache) {
     if(!cache->initialized)
         return;
 
-    texture_delete(&cache->texture);
     texture_delete(&cache->effect);
-    renderbuffer_delete(&cache->stencil);
     cache->initialized = false;
     return;
 }
 
+// A shadow being rendered into a borrowed target
+struct ShadowPass {
+    win_id id;
+    struct RenderTarget* target;
+};
+
 void windowlist_updateShadow(session_t* ps, Vector* paints) {
-    Vector shadow_updates;
-    vector_init(&shadow_updates, sizeof(win_id), paints->size);
+    struct RenderTargetPool* pool = &ps->psglx->targets;
 
-    struct Framebuffer framebuffer;
-    if(!framebuffer_init(&framebuffer)) {
-        printf("Couldn't create framebuffer for shadow\n");
-        return;
-    }
-    framebuffer_resetTarget(&framebuffer);
-    framebuffer_bind(&framebuffer);
+    Vector passes;
+    vector_init(&passes, sizeof(struct ShadowPass), paints->size);
 
     Vector blurDatas;
     vector_init(&blurDatas, sizeof(struct TextureBlurData), ps->win_list.size);
 
-    glDisable(GL_BLEND);
-    glEnable(GL_STENCIL_TEST);
+    glstate_disable(GL_BLEND);
+    glstate_enable(GL_STENCIL_TEST);
 
     glClearColor(0.0, 0.0, 0.0, 0.0);
 
@@ -91,36 +77,43 @@ void windowlist_updateShadow(session_t* ps, Vector* paints) {
 
     for_components(it, &ps->win_list,
         COMPONENT_MUD, COMPONENT_TEXTURED, COMPONENT_PHYSICAL, COMPONENT_SHADOW_DAMAGED, COMPONENT_SHADOW,
-        COMPONENT_SHAPED, CQ_END) {
-        struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, it.id);
+        COMPONENT_SHAPED, CQ_NOT, COMPONENT_OCCLUDED, CQ_END) {
+        const struct Texture* texture = win_contentsTexture(&ps->win_list, it.id);
         struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, it.id);
         struct glx_shadow_cache* shadow = swiss_getComponent(&ps->win_list, COMPONENT_SHADOW, it.id);
         struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, it.id);
 
-        framebuffer_resetTarget(&framebuffer);
-        framebuffer_targetTexture(&framebuffer, &shadow->texture);
-        framebuffer_targetRenderBuffer_stencil(&framebuffer, &shadow->stencil);
-        framebuffer_rebind(&framebuffer);
+        // The target is held until the shadow has been clipped into the
+        // cache, which happens after all the shadows have been blurred
+        struct RenderTarget* target = rendertargetpool_acquire(pool, &shadow->effect.size,
+                shadow->effect.format);
+        if(target == NULL) {
+            printf("Couldn't get a render target for shadow\n");
+            continue;
+        }
+        struct ShadowPass pass = {
+            .id = it.id,
+            .target = target,
+        };
+        vector_putBack(&passes, &pass);
+
+        rendertarget_bind(target);
 
         Matrix old_view = view;
-        view = mat4_orthogonal(0, shadow->texture.size.x, 0, shadow->texture.size.y, -1, 1);
+        view = mat4_orthogonal(0, target->texture.size.x, 0, target->texture.size.y, -1, 1);
 
-        glViewport(0, 0, shadow->texture.size.x, shadow->texture.size.y);
+        glViewport(0, 0, target->texture.size.x, target->texture.size.y);
 
         glClear(GL_STENCIL_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
-        texture_bind(&textured->texture, GL_TEXTURE0);
+        texture_bind(texture, GL_TEXTURE0);
 
-        struct shader_program* shadow_program = assets_load("shadow.shader");
-        if(shadow_program->shader_type_info != &shadow_info) {
-            printf_errf("Shader was not a shadow shader\n");
-            framebuffer_delete(&framebuffer);
-            view = old_view;
-            return;
-        }
-        struct Shadow* shadow_type = shadow_program->shader_type;
+        struct shader_program* shadow_program = asset_handles.shadow.program;
+        struct Shadow* shadow_type = asset_handles.shadow.type;
 
-        shader_set_future_uniform_bool(shadow_type->flip, textured->texture.flipped);
+        Vector2 uvscale = texture_uvscale(texture);
+        shader_set_future_uniform_bool(shadow_type->flip, texture->flipped);
+        shader_set_future_uniform_vec2(shadow_type->uvscale, &uvscale);
         shader_set_future_uniform_sampler(shadow_type->tex_scr, 0);
 
         shader_use(shadow_program);
@@ -132,61 +125,60 @@ void windowlist_updateShadow(session_t* ps, Vector* paints) {
 
         // Do the blur
         struct TextureBlurData blurData = {
-            .depth = &shadow->stencil,
-            .tex = &shadow->texture,
+            .fbo = &target->fbo,
+            .depth = &target->stencil,
+            .tex = &target->texture,
             .swap = &shadow->effect,
         };
         vector_putBack(&blurDatas, &blurData);
     }
 
-    glDisable(GL_STENCIL_TEST);
+    glstate_disable(GL_STENCIL_TEST);
 
-    textures_blur(&blurDatas, &framebuffer, 4, false);
+    textures_blur(&blurDatas, 4, false);
 
     vector_kill(&blurDatas);
 
-    framebuffer_resetTarget(&framebuffer);
-    if(framebuffer_bind(&framebuffer) != 0) {
-        printf("Failed binding framebuffer to clip shadow\n");
-    }
-
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glStencilMask(0xFF);
     glStencilFunc(GL_EQUAL, 0, 0xFF);
     glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 
-    glEnable(GL_STENCIL_TEST);
-
-    for_components(it, &ps->win_list,
-        COMPONENT_MUD, COMPONENT_TEXTURED, COMPONENT_PHYSICAL, COMPONENT_SHADOW_DAMAGED, COMPONENT_SHADOW,
-        COMPONENT_SHAPED, CQ_END) {
-        struct glx_shadow_cache* shadow = swiss_getComponent(&ps->win_list, COMPONENT_SHADOW, it.id);
-        struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, it.id);
-
-        framebuffer_resetTarget(&framebuffer);
-        framebuffer_targetTexture(&framebuffer, &shadow->effect);
-        framebuffer_targetRenderBuffer_stencil(&framebuffer, &shadow->stencil);
-        if(framebuffer_rebind(&framebuffer) != 0) {
+    glstate_enable(GL_STENCIL_TEST);
+
+    size_t index;
+    struct ShadowPass* pass = vector_getFirst(&passes, &index);
+    while(pass != NULL) {
+        struct glx_shadow_cache* shadow = swiss_getComponent(&ps->win_list, COMPONENT_SHADOW, pass->id);
+        struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, pass->id);
+        struct RenderTarget* target = pass->target;
+
+        // The stencil still holds the window, so the shadow is only kept
+        // outside of it
+        framebuffer_resetTarget(&target->fbo);
+        framebuffer_targetTexture(&target->fbo, &shadow->effect);
+        framebuffer_targetRenderBuffer_stencil(&target->fbo, &target->stencil);
+        if(framebuffer_bind(&target->fbo) != 0) {
             printf("Failed binding framebuffer to clip shadow\n");
-            return;
-        }
+        } else {
+            Matrix old_view = view;
+            view = mat4_orthogonal(0, shadow->effect.size.x, 0, shadow->effect.size.y, -1, 1);
+            glViewport(0, 0, shadow->effect.size.x, shadow->effect.size.y);
 
-        Matrix old_view = view;
-        view = mat4_orthogonal(0, shadow->effect.size.x, 0, shadow->effect.size.y, -1, 1);
-        glViewport(0, 0, shadow->effect.size.x, shadow->effect.size.y);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-        glClear(GL_COLOR_BUFFER_BIT);
+            draw_tex(shaped->face, &target->texture, &VEC3_ZERO, &shadow->effect.size);
 
-        draw_tex(shaped->face, &shadow->texture, &VEC3_ZERO, &shadow->effect.size);
+            view = old_view;
+        }
 
-        view = old_view;
+        rendertargetpool_release(pool, target);
+        pass = vector_getNext(&passes, &index);
     }
 
     swiss_resetComponent(&ps->win_list, COMPONENT_SHADOW_DAMAGED);
 
-    glDisable(GL_STENCIL_TEST);
+    glstate_disable(GL_STENCIL_TEST);
 
-    vector_kill(&shadow_updates);
-    framebuffer_delete(&framebuffer);
+    vector_kill(&passes);
 }
-
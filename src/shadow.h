@@ -10,9 +10,9 @@ struct _win;
 
 struct glx_shadow_cache {
     bool initialized;
-    struct Texture texture;
+    // The blurred shadow, clipped to outside the window. Drawing and
+    // blurring happens in a borrowed render target.
     struct Texture effect;
-    struct RenderBuffer stencil;
     Vector2 wSize;
     Vector2 border;
 };
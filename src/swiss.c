@@ -34,6 +34,14 @@ static void resize_real(Swiss* vector, size_t newSize) {
 
         // Set all the newly allocated words to the right value
         memset(&vector->freelist[i][oldBucketCount], 0x00, newBuckets * SWISS_FREELIST_BUCKET_SIZE_BYTES);
+
+        struct SwissIndex* swindex = &vector->indices[i];
+        if(swindex->enabled) {
+            newMem = realloc(swindex->pending, newBucketCount * SWISS_FREELIST_BUCKET_SIZE_BYTES);
+            assert(newMem != NULL);
+            swindex->pending = newMem;
+            memset(&swindex->pending[oldBucketCount], 0x00, newBuckets * SWISS_FREELIST_BUCKET_SIZE_BYTES);
+        }
     }
 
     // The end of the freelist might lie within a word, but in that case the
@@ -129,18 +137,179 @@ static size_t findNextUsed(const Swiss* vector, const enum ComponentType* types,
     return -1;
 }
 
-static void setFreeStatus(Swiss* vector, enum ComponentType type, size_t index, bool isFree) {
+static void setBit(uint64_t* bitfield, size_t index, bool value) {
     size_t bucket = index / SWISS_FREELIST_BUCKET_SIZE;
     size_t offset = index % SWISS_FREELIST_BUCKET_SIZE;
-    uint64_t* freelist = vector->freelist[type];
 
-    if(isFree) {
-        freelist[bucket] &= ~(0x1ULL << ((SWISS_FREELIST_BUCKET_SIZE - offset) - 1));
+    if(value) {
+        bitfield[bucket] |= (0x1ULL << ((SWISS_FREELIST_BUCKET_SIZE - offset) - 1));
     } else {
-        freelist[bucket] |= (0x1ULL << ((SWISS_FREELIST_BUCKET_SIZE - offset) - 1));
+        bitfield[bucket] &= ~(0x1ULL << ((SWISS_FREELIST_BUCKET_SIZE - offset) - 1));
+    }
+}
+
+static bool getBit(const uint64_t* bitfield, size_t index) {
+    size_t bucket = index / SWISS_FREELIST_BUCKET_SIZE;
+    size_t offset = index % SWISS_FREELIST_BUCKET_SIZE;
+
+    return (bitfield[bucket] & (0x1ULL << ((SWISS_FREELIST_BUCKET_SIZE - offset) - 1))) != 0;
+}
+
+static void setFreeStatus(Swiss* vector, enum ComponentType type, size_t index, bool isFree) {
+    setBit(vector->freelist[type], index, !isFree);
+}
+
+#define SWISS_INDEX_EMPTY ((win_id)-1)
+#define SWISS_INDEX_INITIAL_SIZE (64)
+
+static size_t index_hash(const struct SwissIndex* swindex, uint64_t key) {
+    // Fibonacci hashing. X window ids are mostly sequential, so we need
+    // something to spread them over the table.
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 32;
+    return hash & (swindex->capacity - 1);
+}
+
+static uint64_t index_keyOf(const Swiss* index, const enum ComponentType type, win_id id) {
+    uint64_t key = 0;
+    memcpy(&key, index->data[type] + index->componentSize[type] * id, index->indices[type].keySize);
+    return key;
+}
+
+static void index_allocate(struct SwissIndex* swindex, size_t capacity) {
+    // The capacity must be a power of two for the hash mask to work
+    assert((capacity & (capacity - 1)) == 0);
+
+    swindex->capacity = capacity;
+    swindex->size = 0;
+    swindex->keys = malloc(capacity * sizeof(uint64_t));
+    swindex->ids = malloc(capacity * sizeof(win_id));
+    assert(swindex->keys != NULL);
+    assert(swindex->ids != NULL);
+
+    for(size_t i = 0; i < capacity; i++) {
+        swindex->ids[i] = SWISS_INDEX_EMPTY;
     }
 }
 
+static void index_insert(struct SwissIndex* swindex, uint64_t key, win_id id);
+
+static void index_grow(struct SwissIndex* swindex) {
+    uint64_t* oldKeys = swindex->keys;
+    win_id* oldIds = swindex->ids;
+    size_t oldCapacity = swindex->capacity;
+
+    index_allocate(swindex, oldCapacity * 2);
+
+    for(size_t i = 0; i < oldCapacity; i++) {
+        if(oldIds[i] != SWISS_INDEX_EMPTY)
+            index_insert(swindex, oldKeys[i], oldIds[i]);
+    }
+
+    free(oldKeys);
+    free(oldIds);
+}
+
+static void index_insert(struct SwissIndex* swindex, uint64_t key, win_id id) {
+    // Keep the load below 50% so the probe chains stay short
+    if((swindex->size + 1) * 2 > swindex->capacity)
+        index_grow(swindex);
+
+    size_t mask = swindex->capacity - 1;
+    size_t slot = index_hash(swindex, key);
+    while(swindex->ids[slot] != SWISS_INDEX_EMPTY) {
+        slot = (slot + 1) & mask;
+    }
+
+    swindex->keys[slot] = key;
+    swindex->ids[slot] = id;
+    swindex->size++;
+}
+
+static void index_erase(struct SwissIndex* swindex, uint64_t key, win_id id) {
+    size_t mask = swindex->capacity - 1;
+    size_t slot = index_hash(swindex, key);
+    while(swindex->ids[slot] != id || swindex->keys[slot] != key) {
+        // The entry has to be in the table
+        assert(swindex->ids[slot] != SWISS_INDEX_EMPTY);
+        slot = (slot + 1) & mask;
+    }
+
+    // Shift the following entries of the probe chain back so we don't need
+    // tombstones
+    size_t hole = slot;
+    size_t next = slot;
+    while(true) {
+        next = (next + 1) & mask;
+        if(swindex->ids[next] == SWISS_INDEX_EMPTY)
+            break;
+
+        size_t home = index_hash(swindex, swindex->keys[next]);
+        // If the home of the entry lies cyclically in (hole, next] it's still
+        // reachable, and has to stay where it is.
+        bool reachable = hole <= next
+            ? hole < home && home <= next
+            : hole < home || home <= next;
+        if(reachable)
+            continue;
+
+        swindex->keys[hole] = swindex->keys[next];
+        swindex->ids[hole] = swindex->ids[next];
+        hole = next;
+    }
+
+    swindex->ids[hole] = SWISS_INDEX_EMPTY;
+    swindex->size--;
+}
+
+static void index_clear(Swiss* index, struct SwissIndex* swindex) {
+    for(size_t i = 0; i < swindex->capacity; i++) {
+        swindex->ids[i] = SWISS_INDEX_EMPTY;
+    }
+    swindex->size = 0;
+
+    size_t freeSize = freelist_numBuckets(index->capacity);
+    memset(swindex->pending, 0x00, freeSize * SWISS_FREELIST_BUCKET_SIZE_BYTES);
+}
+
+// Hash everything that was added since the last lookup
+static void index_flush(Swiss* index, const enum ComponentType type) {
+    struct SwissIndex* swindex = &index->indices[type];
+    size_t numBuckets = freelist_numBuckets(index->capacity);
+    for(size_t i = 0; i < numBuckets; i++) {
+        uint64_t bucket = swindex->pending[i];
+        while(bucket != 0) {
+            int offset = findFirstSet(bucket);
+            bucket &= ~(0x1ULL << ((SWISS_FREELIST_BUCKET_SIZE - offset) - 1));
+
+            win_id id = i * SWISS_FREELIST_BUCKET_SIZE + offset;
+            index_insert(swindex, index_keyOf(index, type, id), id);
+        }
+        swindex->pending[i] = 0;
+    }
+}
+
+static void index_add(Swiss* index, const enum ComponentType type, win_id id) {
+    if(!index->indices[type].enabled)
+        return;
+
+    setBit(index->indices[type].pending, id, true);
+}
+
+static void index_remove(Swiss* index, const enum ComponentType type, win_id id) {
+    struct SwissIndex* swindex = &index->indices[type];
+    if(!swindex->enabled)
+        return;
+
+    // If it's still pending it never made it into the table
+    if(getBit(swindex->pending, id)) {
+        setBit(swindex->pending, id, false);
+        return;
+    }
+
+    index_erase(swindex, index_keyOf(index, type, id), id);
+}
+
 void swiss_clearComponentSizes(Swiss* index) {
     for(int i = 0; i < NUM_COMPONENT_TYPES; i++) {
         index->componentSize[i] = 0;
@@ -168,6 +337,7 @@ void swiss_init(Swiss* index, size_t initialsize) {
 
     memset(index->data, 0x00, sizeof(uint8_t*) * NUM_COMPONENT_TYPES);
     memset(index->freelist, 0x00, sizeof(uint64_t*) * NUM_COMPONENT_TYPES);
+    memset(index->indices, 0x00, sizeof(struct SwissIndex) * NUM_COMPONENT_TYPES);
 
     resize_real(index, initialsize);
 
@@ -176,6 +346,25 @@ void swiss_init(Swiss* index, size_t initialsize) {
     assert(index->capacity != 0);
 }
 
+void swiss_enableIndex(Swiss* index, const enum ComponentType type, size_t keySize) {
+    assert(index->capacity != 0);
+    assert(type != COMPONENT_META);
+    assert(keySize <= sizeof(uint64_t));
+    assert(index->componentSize[type] >= keySize);
+    assert(findNextUsed(index, (enum ComponentType[]){type, CQ_END}, 0) == -1);
+
+    struct SwissIndex* swindex = &index->indices[type];
+    assert(!swindex->enabled);
+
+    swindex->enabled = true;
+    swindex->keySize = keySize;
+    index_allocate(swindex, SWISS_INDEX_INITIAL_SIZE);
+
+    size_t numBuckets = freelist_numBuckets(index->capacity);
+    swindex->pending = calloc(numBuckets, SWISS_FREELIST_BUCKET_SIZE_BYTES);
+    assert(swindex->pending != NULL);
+}
+
 void swiss_kill(Swiss* index) {
     assert(index->capacity != 0);
 
@@ -197,6 +386,14 @@ void swiss_kill(Swiss* index) {
         index->freelist[i] = NULL;
 
         index->componentSize[i] = 0;
+
+        struct SwissIndex* swindex = &index->indices[i];
+        if(swindex->enabled) {
+            free(swindex->keys);
+            free(swindex->ids);
+            free(swindex->pending);
+            memset(swindex, 0x00, sizeof(struct SwissIndex));
+        }
     }
     index->capacity = 0;
 }
@@ -208,10 +405,12 @@ win_id swiss_allocate(Swiss* index) {
         // Allocate space at the end of the array
         assert(index->capacity != 0);
 
+        size_t oldSize = index->capacity;
         size_t newSize = index->capacity * 2;
         resize_real(index, newSize);
 
-        index->firstFree = findNextFree(index, COMPONENT_META, newSize);
+        // The first new slot is free, everything before it was full
+        index->firstFree = findNextFree(index, COMPONENT_META, oldSize);
     }
 
     win_id id = index->firstFree;
@@ -247,6 +446,7 @@ void* swiss_addComponent(Swiss* index, const enum ComponentType type, win_id id)
     assert(swiss_hasComponent(index, type, id) == false);
 
     setFreeStatus(index, type, id, false);
+    index_add(index, type, id);
 
     return index->data[type] + index->componentSize[type] * id;
 }
@@ -255,7 +455,11 @@ void swiss_ensureComponent(Swiss* index, const enum ComponentType type, win_id i
     assert(index->capacity != 0);
     assert(swiss_hasComponent(index, COMPONENT_META, id) == true);
 
+    if(swiss_hasComponent(index, type, id))
+        return;
+
     setFreeStatus(index, type, id, false);
+    index_add(index, type, id);
 }
 
 bool swiss_hasComponent(const Swiss* index, enum ComponentType type, win_id id) {
@@ -273,6 +477,9 @@ bool swiss_hasComponent(const Swiss* index, enum ComponentType type, win_id id)
 void swiss_removeComponent(Swiss* index, const enum ComponentType type, win_id id) {
     assert(index->capacity != 0);
 
+    if(swiss_hasComponent(index, type, id))
+        index_remove(index, type, id);
+
     setFreeStatus(index, type, id, true);
 }
 
@@ -281,6 +488,9 @@ void swiss_resetComponent(Swiss* index, const enum ComponentType type) {
 
     size_t freeSize = freelist_numBuckets(index->capacity);
     memset(index->freelist[type], 0, freeSize * SWISS_FREELIST_BUCKET_SIZE_BYTES);
+
+    if(index->indices[type].enabled)
+        index_clear(index, &index->indices[type]);
 }
 
 void* swiss_getComponent(const Swiss* index, const enum ComponentType type, win_id id) {
@@ -306,6 +516,9 @@ void swiss_clear(Swiss* index) {
     for(int i = 0; i < NUM_COMPONENT_TYPES; i++) {
         size_t freeSize = freelist_numBuckets(index->capacity);
         memset(index->freelist[i], 0x00, freeSize * SWISS_FREELIST_BUCKET_SIZE_BYTES);
+
+        if(index->indices[i].enabled)
+            index_clear(index, &index->indices[i]);
     }
 
     index->size = 0;
@@ -332,10 +545,54 @@ void swiss_removeComponentWhere(Swiss* index, const enum ComponentType type, con
         if(key == 0)
             continue;
 
+        if(index->indices[type].enabled) {
+            uint64_t removed = key & index->freelist[type][i];
+            while(removed != 0) {
+                int offset = findFirstSet(removed);
+                removed &= ~(0x1ULL << ((SWISS_FREELIST_BUCKET_SIZE - offset) - 1));
+                index_remove(index, type, i * SWISS_FREELIST_BUCKET_SIZE + offset);
+            }
+        }
+
         index->freelist[type][i] &= ~key;
     }
 }
 
+static void index_findFrom(const Swiss* index, struct SwissIndexIterator* it, size_t slot) {
+    const struct SwissIndex* swindex = &index->indices[it->type];
+    size_t mask = swindex->capacity - 1;
+
+    while(swindex->ids[slot] != SWISS_INDEX_EMPTY) {
+        if(swindex->keys[slot] == it->key) {
+            it->slot = slot;
+            it->id = swindex->ids[slot];
+            it->done = false;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    it->id = -1;
+    it->done = true;
+}
+
+struct SwissIndexIterator swiss_lookup(Swiss* index, const enum ComponentType type, uint64_t key) {
+    assert(index->indices[type].enabled);
+
+    index_flush(index, type);
+
+    struct SwissIndexIterator it;
+    it.type = type;
+    it.key = key;
+    index_findFrom(index, &it, index_hash(&index->indices[type], key));
+    return it;
+}
+
+void swiss_lookupNext(const Swiss* index, struct SwissIndexIterator* it) {
+    size_t mask = index->indices[it->type].capacity - 1;
+    index_findFrom(index, it, (it->slot + 1) & mask);
+}
+
 struct SwissIterator swiss_getFirstInit(const Swiss* index, const enum ComponentType* types) {
     struct SwissIterator it;
     it.types = types;
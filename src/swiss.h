@@ -48,8 +48,10 @@ enum ComponentType {
     COMPONENT_FADES_DIM,
     COMPONENT_REDIRECTED,
     COMPONENT_SHAPED,
+    COMPONENT_OPAQUE_REGION,
     COMPONENT_STATEFUL,
     COMPONENT_DEBUGGED,
+    COMPONENT_OCCLUDED,
 
     // Messages
     COMPONENT_MAP,
@@ -63,6 +65,8 @@ enum ComponentType {
 	COMPONENT_SHAPE_DAMAGED,
     COMPONENT_FOCUS_CHANGE,
     COMPONENT_WINTYPE_CHANGE,
+    COMPONENT_WDATA_CHANGE,
+    COMPONENT_OPAQUE_REGION_CHANGE,
 
     NUM_COMPONENT_TYPES,
 
@@ -85,6 +89,33 @@ typedef enum ComponentType CType;
         swiss_getNext(EM, &IT)                                                    \
     )
 
+#define for_indexed(IT, EM, TYPE, KEY)                         \
+    for(                                                       \
+        struct SwissIndexIterator IT = swiss_lookup(EM, TYPE, KEY); \
+        !IT.done;                                              \
+        swiss_lookupNext(EM, &IT)                              \
+    )
+
+// A component can be indexed by the key stored at the very start of its data
+// (like the X Window id of TracksWindowComponent). The index is an open
+// addressing hashtable from the key to the entities having that key, so we
+// can avoid scanning all entities when all we have is the key.
+// The key is usually written after swiss_addComponent returns, so new
+// components are only marked as pending, and are hashed on the next lookup.
+// That means the key can't change while the component exists. Remove and
+// re-add the component to change it.
+struct SwissIndex {
+    bool enabled;
+    size_t keySize;
+
+    size_t capacity;
+    size_t size;
+    uint64_t* keys;
+    win_id* ids;
+
+    uint64_t* pending;
+};
+
 typedef struct {
     size_t capacity;
     size_t size;
@@ -95,6 +126,8 @@ typedef struct {
     uint64_t* freelist[NUM_COMPONENT_TYPES];
     uint8_t* data[NUM_COMPONENT_TYPES];
     bool safemode[NUM_COMPONENT_TYPES];
+
+    struct SwissIndex indices[NUM_COMPONENT_TYPES];
 } Swiss;
 
 void swiss_clearComponentSizes(Swiss* index);
@@ -102,6 +135,9 @@ void swiss_setComponentSize(Swiss* index, const enum ComponentType type, size_t
 void swiss_enableAllAutoRemove(Swiss* index);
 void swiss_disableAutoRemove(Swiss* index, const enum ComponentType type);
 void swiss_init(Swiss* index, size_t initialSize);
+// Must be called after swiss_init, but before any component of the type is
+// added.
+void swiss_enableIndex(Swiss* index, const enum ComponentType type, size_t keySize);
 
 void swiss_kill(Swiss* vector);
 
@@ -130,6 +166,18 @@ struct SwissIterator {
     bool done;
     const enum ComponentType* types;
 };
+struct SwissIndexIterator {
+    win_id id;
+    bool done;
+    enum ComponentType type;
+    uint64_t key;
+    size_t slot;
+};
+// The iterator is invalidated by adding or removing components of the indexed
+// type.
+struct SwissIndexIterator swiss_lookup(Swiss* index, const enum ComponentType type, uint64_t key);
+void swiss_lookupNext(const Swiss* index, struct SwissIndexIterator* it);
+
 struct SwissIterator swiss_getFirstInit(const Swiss* index, const enum ComponentType* types);
 void swiss_getFirst(const Swiss* index, const enum ComponentType* types, struct SwissIterator* it);
 void swiss_getNext(const Swiss* index, struct SwissIterator* it);
@@ -2,12 +2,14 @@
 
 #include "assets/assets.h"
 #include "assets/shader.h"
+#include "assets/handles.h"
 
 #include "shaders/shaderinfo.h"
 
 #include "profiler/zone.h"
 
 #include "renderutil.h"
+#include "glstate.h"
 
 DECLARE_ZONE(paint_text);
 
@@ -43,7 +45,7 @@ int font_load(struct Font* font, char* filename) {
 
         // Initialize texture with no storage, and initialize the storage
         // afterwards, since we are GL_RED
-        if(texture_init(&chara->texture, GL_TEXTURE_2D, NULL) != 0) {
+        if(texture_init(&chara->texture, GL_TEXTURE_2D, NULL, TEXTUREFORMAT_R8) != 0) {
             // @LEAK: Lets just leak the whole font here for now. It should
             // never happend right?
             printf("Failed initializing texture for letter %c\n", i);
@@ -51,6 +53,7 @@ int font_load(struct Font* font, char* filename) {
         }
         chara->texture.size.x = face->glyph->bitmap.width;
         chara->texture.size.y = face->glyph->bitmap.rows;
+        chara->texture.storage = chara->texture.size;
         chara->bearing.x = face->glyph->bitmap_left;
         chara->bearing.y = face->glyph->bitmap_top;
         chara->advance = face->glyph->advance.x >> 6;
@@ -102,19 +105,13 @@ void text_draw(const struct Font* font, const char* text, const Vector2* positio
 
 void text_draw_colored(const struct Font* font, const char* text, const Vector2* position, const Vector2* scale, const Vector3* color) {
     zone_enter(&ZONE_paint_text);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
-    struct face* face = assets_load("window.face");
-
-    struct shader_program* text_program = assets_load("text.shader");
-    if(text_program->shader_type_info != &text_info) {
-        printf_errf("Shader was not a text shader\n");
-        zone_leave(&ZONE_paint_text);
-        return;
-    }
+    glstate_enable(GL_BLEND);
+    glstate_blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glstate_blendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+    struct face* face = asset_handles.window_face;
 
-    struct Text* text_type = text_program->shader_type;
+    struct shader_program* text_program = asset_handles.text.program;
+    struct Text* text_type = asset_handles.text.type;
 
     shader_set_future_uniform_bool(text_type->flip, true);
     shader_set_future_uniform_float(text_type->opacity, (float)1.0);
@@ -1,40 +1,115 @@
 #include "texture.h"
 
+#include "glstate.h"
+
 #include <stdio.h>
+#include <math.h>
 #include <assert.h>
 
-static inline GLuint generate_texture(GLenum tex_tgt, const Vector2* size) {
+// All the storage we have allocated for textures
+static size_t allocated_bytes = 0;
+
+static Vector2 size_class(const Vector2* size) {
+    Vector2 storage = {{
+        ceil(size->x / TEXTURE_SIZE_CLASS) * TEXTURE_SIZE_CLASS,
+        ceil(size->y / TEXTURE_SIZE_CLASS) * TEXTURE_SIZE_CLASS,
+    }};
+    return storage;
+}
+
+static void format_gl(enum TextureFormat format, GLint* internal, GLenum* data) {
+    switch(format) {
+        case TEXTUREFORMAT_R8:
+            *internal = GL_R8;
+            *data = GL_RED;
+            return;
+        case TEXTUREFORMAT_RGB8:
+            *internal = GL_RGB8;
+            *data = GL_RGB;
+            return;
+        case TEXTUREFORMAT_RGBA8:
+            *internal = GL_RGBA8;
+            *data = GL_RGBA;
+            return;
+    }
+    assert(false);
+}
+
+static size_t format_bpp(enum TextureFormat format) {
+    switch(format) {
+        case TEXTUREFORMAT_R8:
+            return 1;
+        case TEXTUREFORMAT_RGB8:
+            // Drivers pad these out to 4 bytes a pixel anyway
+            return 4;
+        case TEXTUREFORMAT_RGBA8:
+            return 4;
+    }
+    assert(false);
+    return 4;
+}
+
+static void account(struct Texture* texture, const Vector2* storage, enum TextureFormat format) {
+    size_t bytes = 0;
+    if(storage != NULL)
+        bytes = (size_t)storage->x * (size_t)storage->y * format_bpp(format);
+
+    assert(allocated_bytes >= texture->bytes);
+    allocated_bytes -= texture->bytes;
+    allocated_bytes += bytes;
+    texture->bytes = bytes;
+}
+
+static void allocate_storage(GLenum tex_tgt, const Vector2* size, enum TextureFormat format) {
+    GLint internal;
+    GLenum data;
+    format_gl(format, &internal, &data);
+
+    glTexImage2D(tex_tgt, 0, internal, size->x, size->y, 0, data,
+            GL_UNSIGNED_BYTE, NULL);
+}
+
+static inline GLuint generate_texture(GLenum tex_tgt, const Vector2* size, enum TextureFormat format) {
     GLuint tex = 0;
 
     glGenTextures(1, &tex);
     if (!tex)
         return 0;
 
-    glBindTexture(tex_tgt, tex);
+    glstate_bindTexture(tex_tgt, tex);
     glTexParameteri(tex_tgt, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(tex_tgt, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(tex_tgt, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(tex_tgt, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
     if(size != NULL)
-        glTexImage2D(tex_tgt, 0, GL_RGBA8, size->x, size->y, 0, GL_RGBA,
-                GL_UNSIGNED_BYTE, NULL);
+        allocate_storage(tex_tgt, size, format);
 
     return tex;
 }
 
-int texture_init(struct Texture* texture, GLenum target, const Vector2* size) {
-    texture->gl_texture = generate_texture(target, size);
+int texture_init(struct Texture* texture, GLenum target, const Vector2* size,
+        enum TextureFormat format) {
+    Vector2 storage;
+    if(size != NULL)
+        storage = size_class(size);
+
+    texture->gl_texture = generate_texture(target, size != NULL ? &storage : NULL, format);
     if(texture->gl_texture == 0) {
         return 1;
     }
 
     texture->target = target;
+    texture->format = format;
+    texture->evicted = false;
+    texture->bytes = 0;
+    account(texture, size != NULL ? &storage : NULL, format);
 
     // If the size was NULL, then we didn't allocate any space in the
     // generate_texture call
     if(size != NULL) {
         texture->size = *size;
+        texture->storage = storage;
         texture->hasSpace = true;
     } else {
         texture->hasSpace = false;
@@ -44,35 +119,95 @@ int texture_init(struct Texture* texture, GLenum target, const Vector2* size) {
 }
 
 int texture_init_nospace(struct Texture* texture, GLenum target, const Vector2* size) {
-    texture->gl_texture = generate_texture(target, size);
+    texture->gl_texture = generate_texture(target, size, TEXTUREFORMAT_RGBA8);
     if(texture->gl_texture == 0) {
         return 1;
     }
 
     texture->target = target;
-    if(size != NULL)
+    texture->format = TEXTUREFORMAT_RGBA8;
+    texture->evicted = false;
+    // The storage comes from the pixmap, so it isn't ours to account for
+    texture->bytes = 0;
+    // The storage is given to us from the outside, and is exactly the size
+    if(size != NULL) {
         texture->size = *size;
+        texture->storage = *size;
+    }
 
     return 0;
 }
 
-void texture_resize(struct Texture* texture, const Vector2* size) {
+void texture_resize(struct Texture* texture, const Vector2* size,
+        enum TextureFormat format) {
     assert(texture_initialized(texture));
 
-    glBindTexture(texture->target, texture->gl_texture);
-    glTexImage2D(texture->target, 0, GL_RGBA, size->x, size->y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-    glBindTexture(texture->target, 0);
+    // Only reallocate when we move to another size class, the contents are
+    // redrawn after a resize anyway
+    Vector2 storage = size_class(size);
+    if(!texture->hasSpace || !vec2_eq(&texture->storage, &storage)
+            || texture->format != format) {
+        glstate_bindTexture(texture->target, texture->gl_texture);
+        allocate_storage(texture->target, &storage, format);
+        glstate_bindTexture(texture->target, 0);
+
+        texture->storage = storage;
+        texture->format = format;
+        account(texture, &storage, format);
+    }
 
     texture->hasSpace = true;
+    texture->evicted = false;
     texture->size = *size;
 }
 
+void texture_evict(struct Texture* texture) {
+    assert(texture_initialized(texture));
+    if(!texture->hasSpace)
+        return;
+
+    // Respecifying the texture with no size lets the driver drop the
+    // storage, without throwing away the texture object
+    static const Vector2 empty = {{0, 0}};
+    glstate_bindTexture(texture->target, texture->gl_texture);
+    allocate_storage(texture->target, &empty, texture->format);
+    glstate_bindTexture(texture->target, 0);
+
+    account(texture, NULL, texture->format);
+    texture->storage = empty;
+    texture->hasSpace = false;
+    texture->evicted = true;
+}
+
+void texture_restore(struct Texture* texture) {
+    assert(texture->evicted);
+    Vector2 size = texture->size;
+    texture_resize(texture, &size, texture->format);
+}
+
+size_t texture_allocatedBytes() {
+    return allocated_bytes;
+}
+
+Vector2 texture_uvscale(const struct Texture* texture) {
+    if(texture->storage.x == 0 || texture->storage.y == 0)
+        return (Vector2){{1, 1}};
+
+    Vector2 scale = texture->size;
+    vec2_div(&scale, &texture->storage);
+    return scale;
+}
+
 void texture_delete(struct Texture* texture) {
+    account(texture, NULL, texture->format);
     glDeleteTextures(1, &texture->gl_texture);
+    glstate_deletedTexture(texture->gl_texture);
     texture->gl_texture = 0;
     texture->target = 0;
     texture->size.x = 0;
     texture->size.y = 0;
+    texture->storage.x = 0;
+    texture->storage.y = 0;
 }
 
 bool texture_initialized(const struct Texture* texture) {
@@ -86,11 +221,11 @@ int texture_read_from(struct Texture* texture, GLuint framebuffer,
         return 1;
     }
 
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glstate_bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
     glReadBuffer(buffer);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(texture->target, texture->gl_texture);
+    glstate_activeTexture(GL_TEXTURE0);
+    glstate_bindTexture(texture->target, texture->gl_texture);
 
     if (size->x <= 0 && size->y <= 0) {
         return 1;
@@ -106,7 +241,7 @@ int texture_read_from(struct Texture* texture, GLuint framebuffer,
 int texture_bind_to_framebuffer(struct Texture* texture, GLuint framebuffer,
         GLenum buffer) {
     assert(texture->hasSpace);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glstate_bindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
     glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
             texture->target, texture->gl_texture, 0);
 
@@ -132,6 +267,6 @@ void texture_bind(const struct Texture* texture, GLenum unit) {
     assert(texture != NULL);
     assert(texture_initialized(texture));
 
-    glActiveTexture(unit);
-    glBindTexture(texture->target, texture->gl_texture);
+    glstate_activeTexture(unit);
+    glstate_bindTexture(texture->target, texture->gl_texture);
 }
@@ -5,22 +5,62 @@
 
 #include "vmath.h"
 
+#include <stddef.h>
+
+// Textures we allocate are rounded up to a size class, so resizing a window
+// a few pixels at a time doesn't reallocate the storage on every frame. The
+// contents live in the lower left corner of the storage, and anything
+// sampling the texture has to scale its uvs by texture_uvscale.
+#define TEXTURE_SIZE_CLASS 64
+
+// The storage formats we allocate. Every use asks for the smallest one that
+// holds what it draws.
+enum TextureFormat {
+    // Single channel, like glyphs
+    TEXTUREFORMAT_R8,
+    // Contents without an alpha channel. Sampling gives an alpha of 1.
+    TEXTUREFORMAT_RGB8,
+    TEXTUREFORMAT_RGBA8,
+};
+
 struct Texture {
     GLuint gl_texture;
     GLenum target;
+    enum TextureFormat format;
 
+    // The size in use
     Vector2 size;
+    // The size of the allocated storage
+    Vector2 storage;
     bool hasSpace;
+    // The storage was freed by texture_evict, the size and format are kept
+    // so it can be allocated again
+    bool evicted;
+    // Bytes of storage we allocated for this texture
+    size_t bytes;
 
     bool flipped;
 };
 
-int texture_init(struct Texture* texture, GLenum target, const Vector2* size);
+int texture_init(struct Texture* texture, GLenum target, const Vector2* size,
+        enum TextureFormat format);
 int texture_init_nospace(struct Texture* texture, GLenum target, const Vector2* size);
 void texture_delete(struct Texture* texture);
 bool texture_initialized(const struct Texture* texture);
 
-void texture_resize(struct Texture* texture, const Vector2* size);
+void texture_resize(struct Texture* texture, const Vector2* size,
+        enum TextureFormat format);
+
+// Free the storage of a texture we can redraw later, keeping the size and
+// format. texture_restore, or any resize, allocates it again.
+void texture_evict(struct Texture* texture);
+void texture_restore(struct Texture* texture);
+
+// The storage allocated by all textures together
+size_t texture_allocatedBytes();
+
+// The part of the uv space covered by the size in use
+Vector2 texture_uvscale(const struct Texture* texture);
 
 int texture_read_from(struct Texture* texture, GLuint framebuffer, 
         GLenum buffer, const Vector2* pos, const Vector2* size);
@@ -6,27 +6,25 @@
 #include "framebuffer.h"
 
 #include "renderutil.h"
+#include "glstate.h"
 #include "assets/assets.h"
 #include "assets/shader.h"
+#include "assets/handles.h"
 #include "shaders/shaderinfo.h"
 
 #include <assert.h>
 
 // Blurs a texture into that same texture.
-bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int stength, bool transparent) {
+bool texture_blur(struct TextureBlurData* data, int stength, bool transparent) {
+    struct Framebuffer* buffer = data->fbo;
     assert(texture_initialized(data->tex));
 
     struct Texture* otherPtr = data->swap;
 
     assert(texture_initialized(otherPtr));
 
-    struct shader_program* downscale_program = assets_load("downscale.shader");
-    if(downscale_program->shader_type_info != &downsample_info) {
-        printf("shader was not a downsample shader\n");
-        return false;
-    }
-
-    struct Downsample* downscale_type = downscale_program->shader_type;
+    struct shader_program* downscale_program = asset_handles.downscale.program;
+    struct Downsample* downscale_type = asset_handles.downscale.type;
 
     shader_set_future_uniform_bool(downscale_type->flip, false);
     shader_set_future_uniform_sampler(downscale_type->tex_scr, 0);
@@ -35,9 +33,9 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
     shader_use(downscale_program);
 
     // Disable the options. We will restore later
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
+    glstate_disable(GL_DEPTH_TEST);
 
     Matrix old_view = view;
     view = mat4_orthogonal(0, 1, 0, 1, -1, 1);
@@ -52,14 +50,19 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
     glClearColor(0.0, 0.0, 0.0, 0.0);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    // The passes draw in the size in use, but sample the storage, which
+    // is larger
+    assert(vec2_eq(&data->tex->storage, &otherPtr->storage));
     Vector2 pixeluv = {{1.0f, 1.0f}};
     vec2_div(&pixeluv, &data->tex->size);
+    Vector2 texeluv = {{1.0f, 1.0f}};
+    vec2_div(&texeluv, &data->tex->storage);
     Vector2 halfpixel = {{1.0f, 1.0f}};
-    vec2_div(&halfpixel, &data->tex->size);
+    vec2_div(&halfpixel, &data->tex->storage);
 
     // @HACK: We just assume window is rectangular, which means this will work.
     // In the future we probably shouldn't
-    struct face* face = assets_load("window.face");
+    struct face* face = asset_handles.window_face;
 
     // Downscale
     for (int i = 0; i < stength; i++) {
@@ -81,7 +84,7 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
         texture_bind(data->tex, GL_TEXTURE0);
 
         // Set the shader parameters
-        shader_set_uniform_vec2(downscale_type->pixeluv, &pixeluv);
+        shader_set_uniform_vec2(downscale_type->pixeluv, &texeluv);
         // Set the source texture
         shader_set_uniform_sampler(downscale_type->tex_scr, 0);
 
@@ -90,7 +93,7 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
             const Vector2 roundSource = {{
                 ceil(sourceSize.x), ceil(sourceSize.y),
             }};
-            Vector2 uv_scale = pixeluv;
+            Vector2 uv_scale = texeluv;
             vec2_mul(&uv_scale, &roundSource);
 
             const Vector2 roundTarget = {{
@@ -99,7 +102,7 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
             Vector2 scale = pixeluv;
             vec2_mul(&scale, &roundTarget);
 
-            Vector2 uv_max = pixeluv;
+            Vector2 uv_max = texeluv;
             vec2_mul(&uv_max, &sourceSize);
             vec2_sub(&uv_max, &halfpixel);
 
@@ -124,16 +127,8 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
 
     // Switch to the upsample shader
 
-    struct shader_program* upsample_program = assets_load("upsample.shader");
-    if(upsample_program->shader_type_info != &upsample_info) {
-        printf("Shader was not a upsample shader");
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        view = old_view;
-        return false;
-    }
-
-    struct Upsample* upsample_type = upsample_program->shader_type;
+    struct shader_program* upsample_program = asset_handles.upsample.program;
+    struct Upsample* upsample_type = asset_handles.upsample.type;
 
 
     // Use the shader
@@ -153,6 +148,7 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
         // Set up to draw to the secondary texture
         framebuffer_resetTarget(buffer);
         framebuffer_targetTexture(buffer, otherPtr);
+        framebuffer_targetRenderBuffer_stencil(buffer, data->depth);
         framebuffer_bind(buffer);
 
         glViewport(0, 0, data->tex->size.x, data->tex->size.y);
@@ -161,7 +157,7 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
         texture_bind(data->tex, GL_TEXTURE0);
 
         // Set the shader parameters
-        shader_set_uniform_vec2(upsample_type->pixeluv, &pixeluv);
+        shader_set_uniform_vec2(upsample_type->pixeluv, &texeluv);
         // Set the source texture
         shader_set_uniform_sampler(upsample_type->tex_scr, 0);
 
@@ -170,7 +166,7 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
             const Vector2 roundSource = {{
                 ceil(sourceSize.x), ceil(sourceSize.y),
             }};
-            Vector2 uv_scale = pixeluv;
+            Vector2 uv_scale = texeluv;
             vec2_mul(&uv_scale, &roundSource);
 
             const Vector2 roundTarget = {{
@@ -179,7 +175,7 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
             Vector2 scale = pixeluv;
             vec2_mul(&scale, &roundTarget);
 
-            Vector2 uv_max = pixeluv;
+            Vector2 uv_max = texeluv;
             vec2_mul(&uv_max, &sourceSize);
             vec2_sub(&uv_max, &halfpixel);
 
@@ -200,7 +196,7 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
         }
     }
 
-    glDepthMask(GL_TRUE);
+    glstate_depthMask(GL_TRUE);
     glStencilMask(255);
 
     view = old_view;
@@ -209,19 +205,20 @@ bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int
 
 struct OtherBlurData {
     Vector2 pixeluv;
+    Vector2 texeluv;
     Vector2 halfpixel;
     struct Texture* ptr;
     struct Texture* other;
 };
 
 // Blurs a texture into that same texture.
-bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool transparent) {
+bool textures_blur(Vector* datas, int stength, bool transparent) {
     Matrix old_view = view;
     view = mat4_orthogonal(0, 1, 0, 1, -1, 1);
 
     // @HACK: We just assume window is rectangular, which means this will work.
     // In the future we probably shouldn't
-    struct face* face = assets_load("window.face");
+    struct face* face = asset_handles.window_face;
 
     Vector otherBlurVec;
     vector_init(&otherBlurVec, sizeof(struct OtherBlurData), datas->size);
@@ -238,32 +235,30 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
 
         assert(texture_initialized(otherData->other));
 
+        assert(vec2_eq(&data->tex->storage, &otherData->other->storage));
+
         otherData->pixeluv.x = 1.0f;
         otherData->pixeluv.y = 1.0f;
         vec2_div(&otherData->pixeluv, &data->tex->size);
 
+        otherData->texeluv.x = 1.0f;
+        otherData->texeluv.y = 1.0f;
+        vec2_div(&otherData->texeluv, &data->tex->storage);
+
         otherData->halfpixel.x = 1.0f;
         otherData->halfpixel.y = 1.0f;
-        vec2_div(&otherData->halfpixel, &data->tex->size);
+        vec2_div(&otherData->halfpixel, &data->tex->storage);
 
         data = vector_getNext(datas, &index);
     }
 
-    framebuffer_resetTarget(buffer);
-    framebuffer_bind(buffer);
-
     // Disable the options. We will restore later
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
-    glDisable(GL_DEPTH_TEST);
-
-    struct shader_program* downscale_program = assets_load("downscale.shader");
-    if(downscale_program->shader_type_info != &downsample_info) {
-        printf("shader was not a downsample shader\n");
-        return false;
-    }
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
+    glstate_disable(GL_DEPTH_TEST);
 
-    struct Downsample* downscale_type = downscale_program->shader_type;
+    struct shader_program* downscale_program = asset_handles.downscale.program;
+    struct Downsample* downscale_type = asset_handles.downscale.type;
 
     shader_set_future_uniform_bool(downscale_type->flip, false);
     shader_set_future_uniform_sampler(downscale_type->tex_scr, 0);
@@ -284,10 +279,10 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
             vec2_idiv(&targetSize, 2);
 
             // Set up to draw to the secondary texture
-            framebuffer_resetTarget(buffer);
-            framebuffer_targetTexture(buffer, otherData->other);
-            framebuffer_targetRenderBuffer_stencil(buffer, data->depth);
-            framebuffer_rebind(buffer);
+            framebuffer_resetTarget(data->fbo);
+            framebuffer_targetTexture(data->fbo, otherData->other);
+            framebuffer_targetRenderBuffer_stencil(data->fbo, data->depth);
+            framebuffer_bind(data->fbo);
 
             glViewport(0, 0, data->tex->size.x, data->tex->size.y);
 
@@ -295,14 +290,14 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
             texture_bind(data->tex, GL_TEXTURE0);
 
             // Set the shader parameters
-            shader_set_uniform_vec2(downscale_type->pixeluv, &otherData->pixeluv);
+            shader_set_uniform_vec2(downscale_type->pixeluv, &otherData->texeluv);
 
             // Do the render
             {
                 const Vector2 roundSource = {{
                     ceil(sourceSize.x), ceil(sourceSize.y),
                 }};
-                Vector2 uv_scale = otherData->pixeluv;
+                Vector2 uv_scale = otherData->texeluv;
                 vec2_mul(&uv_scale, &roundSource);
 
                 const Vector2 roundTarget = {{
@@ -311,7 +306,7 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
                 Vector2 scale = otherData->pixeluv;
                 vec2_mul(&scale, &roundTarget);
 
-                Vector2 uv_max = otherData->pixeluv;
+                Vector2 uv_max = otherData->texeluv;
                 vec2_mul(&uv_max, &sourceSize);
                 vec2_sub(&uv_max, &otherData->halfpixel);
 
@@ -333,15 +328,8 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
     }
 
     // Switch to the upsample shader
-    struct shader_program* upsample_program = assets_load("upsample.shader");
-    if(upsample_program->shader_type_info != &upsample_info) {
-        printf("Shader was not a upsample shader");
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        return false;
-    }
-
-    struct Upsample* upsample_type = upsample_program->shader_type;
+    struct shader_program* upsample_program = asset_handles.upsample.program;
+    struct Upsample* upsample_type = asset_handles.upsample.type;
 
     // Use the shader
     shader_set_future_uniform_bool(upsample_type->flip, false);
@@ -362,10 +350,10 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
             vec2_imul(&targetSize, 2);
 
             // Set up to draw to the secondary texture
-            framebuffer_resetTarget(buffer);
-            framebuffer_targetTexture(buffer, otherData->other);
-            framebuffer_targetRenderBuffer_stencil(buffer, data->depth);
-            framebuffer_rebind(buffer);
+            framebuffer_resetTarget(data->fbo);
+            framebuffer_targetTexture(data->fbo, otherData->other);
+            framebuffer_targetRenderBuffer_stencil(data->fbo, data->depth);
+            framebuffer_bind(data->fbo);
 
             glViewport(0, 0, data->tex->size.x, data->tex->size.y);
 
@@ -373,7 +361,7 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
             texture_bind(data->tex, GL_TEXTURE0);
 
             // Set the shader parameters
-            shader_set_uniform_vec2(upsample_type->pixeluv, &otherData->pixeluv);
+            shader_set_uniform_vec2(upsample_type->pixeluv, &otherData->texeluv);
             // Set the source texture
             shader_set_uniform_sampler(upsample_type->tex_scr, 0);
 
@@ -382,7 +370,7 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
                 const Vector2 roundSource = {{
                     ceil(sourceSize.x), ceil(sourceSize.y),
                 }};
-                Vector2 uv_scale = otherData->pixeluv;
+                Vector2 uv_scale = otherData->texeluv;
                 vec2_mul(&uv_scale, &roundSource);
 
                 const Vector2 roundTarget = {{
@@ -391,7 +379,7 @@ bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool
                 Vector2 scale = otherData->pixeluv;
                 vec2_mul(&scale, &roundTarget);
 
-                Vector2 uv_max = otherData->pixeluv;
+                Vector2 uv_max = otherData->texeluv;
                 vec2_mul(&uv_max, &sourceSize);
                 vec2_sub(&uv_max, &otherData->halfpixel);
 
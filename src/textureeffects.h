@@ -5,11 +5,14 @@
 #include "texture.h"
 #include "framebuffer.h"
 
+// The blur ping-pongs between tex and swap in the framebuffer, with depth
+// attached
 struct TextureBlurData {
+    struct Framebuffer* fbo;
     struct RenderBuffer* depth;
     struct Texture* tex;
     struct Texture* swap;
 };
 
-bool texture_blur(struct TextureBlurData* data, struct Framebuffer* buffer, int stength, bool transparent);
-bool textures_blur(Vector* datas, struct Framebuffer* buffer, int stength, bool transparent);
+bool texture_blur(struct TextureBlurData* data, int stength, bool transparent);
+bool textures_blur(Vector* datas, int stength, bool transparent);
@@ -0,0 +1,94 @@
+#include "uniformbuffer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "logging.h"
+
+bool uniformbuffer_init(struct UniformBuffer* buffer) {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if(alignment <= 0) {
+        printf_errf("Invalid uniform buffer offset alignment %d", alignment);
+        return false;
+    }
+
+    size_t size = sizeof(struct WindowUniforms);
+    buffer->window_stride = (size + alignment - 1) / alignment * alignment;
+    buffer->window_cursor = 0;
+
+    glGenBuffers(1, &buffer->frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->frame);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(struct FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+    buffer->frame_valid = false;
+
+    glGenBuffers(1, &buffer->windows);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->windows);
+    glBufferData(GL_UNIFORM_BUFFER, buffer->window_stride * UNIFORMBUFFER_WINDOW_SLOTS,
+            NULL, GL_STREAM_DRAW);
+
+    // Nothing else binds uniform buffers, so the frame stays bound
+    glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORMBUFFER_FRAME, buffer->frame);
+
+    buffer->initialized = true;
+    return true;
+}
+
+void uniformbuffer_delete(struct UniformBuffer* buffer) {
+    if(!buffer->initialized)
+        return;
+
+    glDeleteBuffers(1, &buffer->frame);
+    glDeleteBuffers(1, &buffer->windows);
+    buffer->initialized = false;
+}
+
+void uniformbuffer_setFrame(struct UniformBuffer* buffer, const Matrix* view, const Vector2* viewport) {
+    assert(buffer->initialized);
+
+    struct FrameUniforms frame = {
+        .viewport = {viewport->x, viewport->y},
+    };
+    memcpy(frame.view, view->m, sizeof(frame.view));
+
+    if(buffer->frame_valid && memcmp(&frame, &buffer->frame_data, sizeof(frame)) == 0)
+        return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->frame);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+
+    buffer->frame_data = frame;
+    buffer->frame_valid = true;
+}
+
+void uniformbuffer_pushWindow(struct UniformBuffer* buffer, const struct WindowUniforms* window) {
+    assert(buffer->initialized);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer->windows);
+
+    // When we wrap around the old storage is orphaned, the draws still
+    // reading it keep it alive until they are done
+    if(buffer->window_cursor == UNIFORMBUFFER_WINDOW_SLOTS) {
+        glBufferData(GL_UNIFORM_BUFFER, buffer->window_stride * UNIFORMBUFFER_WINDOW_SLOTS,
+                NULL, GL_STREAM_DRAW);
+        buffer->window_cursor = 0;
+    }
+
+    GLintptr offset = buffer->window_cursor * buffer->window_stride;
+    buffer->window_cursor++;
+
+    // No draw has used this slot since the last orphan, so there's nothing
+    // to synchronize with
+    void* slot = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(struct WindowUniforms),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(slot == NULL) {
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(struct WindowUniforms), window);
+    } else {
+        memcpy(slot, window, sizeof(struct WindowUniforms));
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORMBUFFER_WINDOW, buffer->windows,
+            offset, sizeof(struct WindowUniforms));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glx.h>
+
+#include "vmath.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Uniforms shared between programs live in uniform buffers instead of being
+// sent to each program on its own.
+//
+// The frame block holds what's constant for a pass, the view and viewport.
+// It's only uploaded when it changes, which is once a frame unless a pass
+// renders into a texture with a view of its own.
+//
+// The window block holds the parameters of a single window draw. Those are
+// written into a ring of slots, and each draw binds its own slot, so we never
+// write into a slot a previous draw might still be reading.
+
+// Binding points, as given by the "block" lines of the shader files
+#define UNIFORMBUFFER_FRAME  0
+#define UNIFORMBUFFER_WINDOW 1
+
+// Must match the flag bits in window.vs
+#define WINDOWUNIFORMS_FLIP (1 << 0)
+
+#define UNIFORMBUFFER_WINDOW_SLOTS 512
+
+// Must match the std140 layout of the Frame block
+struct FrameUniforms {
+    float view[16];
+    float viewport[2];
+    float pad[2];
+};
+
+// Must match the std140 layout of the Window block
+struct WindowUniforms {
+    // Position and size in GL coordinates
+    float rect[4];
+    // z, opacity, dim and flags
+    float params[4];
+    // Premultiplied, only read by the tinted variant
+    float tint[4];
+    // The uv scale of the texture in xy, the rest is padding
+    float uvscale[4];
+};
+
+struct UniformBuffer {
+    bool initialized;
+
+    GLuint frame;
+    // What the frame buffer holds right now
+    bool frame_valid;
+    struct FrameUniforms frame_data;
+
+    GLuint windows;
+    // The slots have to start at a multiple of the uniform buffer offset
+    // alignment
+    size_t window_stride;
+    size_t window_cursor;
+};
+
+bool uniformbuffer_init(struct UniformBuffer* buffer);
+void uniformbuffer_delete(struct UniformBuffer* buffer);
+
+void uniformbuffer_setFrame(struct UniformBuffer* buffer, const Matrix* view, const Vector2* viewport);
+
+// Write the parameters for the next window draw and bind them
+void uniformbuffer_pushWindow(struct UniformBuffer* buffer, const struct WindowUniforms* window);
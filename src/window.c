@@ -9,10 +9,12 @@
 #include "assets/assets.h"
 #include "profiler/zone.h"
 #include "assets/shader.h"
+#include "assets/handles.h"
 #include "shaders/shaderinfo.h"
 #include "xtexture.h"
 #include "textureeffects.h"
 #include "renderutil.h"
+#include "glstate.h"
 #include "shadow.h"
 
 int window_zcmp(const void* a, const void* b, void* userdata) {
@@ -55,6 +57,139 @@ bool win_overlap(Swiss* em, win_id w1, win_id w2) {
     return true;
 }
 
+bool win_opaqueContents(Swiss* em, win_id wid) {
+    if(!swiss_hasComponent(em, COMPONENT_BINDS_TEXTURE, wid))
+        return false;
+
+    struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, wid);
+    return bindsTexture->drawable.fbconfig != NULL
+        && bindsTexture->drawable.fbconfig->texture_fmt == GLX_TEXTURE_FORMAT_RGB_EXT;
+}
+
+enum TextureFormat win_contentsFormat(Swiss* em, win_id wid) {
+    if(win_opaqueContents(em, wid))
+        return TEXTUREFORMAT_RGB8;
+    return TEXTUREFORMAT_RGBA8;
+}
+
+bool win_opaqueRect(Swiss* em, win_id wid, struct Rect* rect) {
+    struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, wid);
+
+    if(win_opaqueContents(em, wid)) {
+        rect->pos = (Vector2){{0, 0}};
+        rect->size = physical->size;
+        return true;
+    }
+
+    if(!swiss_hasComponent(em, COMPONENT_OPAQUE_REGION, wid)
+            || !swiss_hasComponent(em, COMPONENT_BINDS_TEXTURE, wid))
+        return false;
+
+    struct OpaqueRegionComponent* opaqueRegion = swiss_getComponent(em, COMPONENT_OPAQUE_REGION, wid);
+
+    // The window might have been resized since the client set the region
+    Vector2 min = opaqueRegion->rect.pos;
+    vec2_max(&min, &(Vector2){{0, 0}});
+    Vector2 max = opaqueRegion->rect.pos;
+    vec2_add(&max, &opaqueRegion->rect.size);
+    vec2_min(&max, &physical->size);
+    if(max.x <= min.x || max.y <= min.y)
+        return false;
+
+    rect->pos = min;
+    rect->size = max;
+    vec2_sub(&rect->size, &min);
+    return true;
+}
+
+const struct Texture* win_contentsTexture(Swiss* em, win_id wid) {
+    struct TexturedComponent* textured = swiss_getComponent(em, COMPONENT_TEXTURED, wid);
+    if(textured->direct) {
+        struct BindsTextureComponent* bindsTexture = swiss_getComponent(em, COMPONENT_BINDS_TEXTURE, wid);
+        return &bindsTexture->drawable.texture;
+    }
+    return &textured->texture;
+}
+
+static struct ContentsDamagedComponent* ensure_contents_damaged(Swiss* em, win_id wid) {
+    if(swiss_hasComponent(em, COMPONENT_CONTENTS_DAMAGED, wid))
+        return swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, wid);
+
+    struct ContentsDamagedComponent* damaged = swiss_addComponent(em, COMPONENT_CONTENTS_DAMAGED, wid);
+    damaged->full = false;
+    vector_init(&damaged->rects, sizeof(struct Rect), 4);
+    damaged->fetch = false;
+    damaged->request = XBATCH_NONE;
+    return damaged;
+}
+
+void win_damageContents(Swiss* em, win_id wid) {
+    struct ContentsDamagedComponent* damaged = ensure_contents_damaged(em, wid);
+    damaged->full = true;
+}
+
+void win_damageContentsRect(Swiss* em, win_id wid, const Vector2* pos, const Vector2* size) {
+    struct ContentsDamagedComponent* damaged = ensure_contents_damaged(em, wid);
+    if(damaged->full)
+        return;
+
+    struct Rect rect = {
+        .pos = *pos,
+        .size = *size,
+    };
+    vector_putBack(&damaged->rects, &rect);
+}
+
+void win_damageContentsPending(Swiss* em, win_id wid) {
+    struct ContentsDamagedComponent* damaged = ensure_contents_damaged(em, wid);
+    damaged->fetch = true;
+}
+
+static bool rect_overlap(const Vector2* lpos1, const Vector2* rpos1, const Vector2* lpos2, const Vector2* rpos2) {
+    if (lpos1->x > rpos2->x || lpos2->x > rpos1->x)
+        return false;
+
+    if (lpos1->y > rpos2->y || lpos2->y > rpos1->y)
+        return false;
+
+    return true;
+}
+
+bool win_damageOverlap(Swiss* em, win_id damaged, win_id other) {
+    struct ContentsDamagedComponent* contentsDamaged = swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, damaged);
+    if(contentsDamaged->full)
+        return win_overlap(em, damaged, other);
+
+    struct PhysicalComponent* damagedPhysical = swiss_getComponent(em, COMPONENT_PHYSICAL, damaged);
+    struct PhysicalComponent* otherPhysical = swiss_getComponent(em, COMPONENT_PHYSICAL, other);
+
+    Vector2 otherRpos = otherPhysical->position;
+    vec2_add(&otherRpos, &otherPhysical->size);
+
+    size_t index;
+    struct Rect* rect = vector_getFirst(&contentsDamaged->rects, &index);
+    while(rect != NULL) {
+        Vector2 lpos = damagedPhysical->position;
+        vec2_add(&lpos, &rect->pos);
+        Vector2 rpos = lpos;
+        vec2_add(&rpos, &rect->size);
+
+        if(rect_overlap(&lpos, &rpos, &otherPhysical->position, &otherRpos))
+            return true;
+
+        rect = vector_getNext(&contentsDamaged->rects, &index);
+    }
+    return false;
+}
+
+void win_clearContentsDamage(Swiss* em) {
+    for_components(it, em, COMPONENT_CONTENTS_DAMAGED, CQ_END) {
+        struct ContentsDamagedComponent* damaged = swiss_getComponent(em, COMPONENT_CONTENTS_DAMAGED, it.id);
+        vector_kill(&damaged->rects);
+    }
+    swiss_resetComponent(em, COMPONENT_CONTENTS_DAMAGED);
+}
+
 bool win_mapped(Swiss* em, win_id wid) {
     struct StatefulComponent* stateful = swiss_getComponent(em, COMPONENT_STATEFUL, wid);
     return stateful->state == STATE_ACTIVATING || stateful->state == STATE_ACTIVE
@@ -108,10 +243,10 @@ bool fade_done(struct Fading* fade) {
 static void win_draw_debug(session_t* ps, win* w) {
     win_id wid = swiss_indexOfPointer(&ps->win_list, COMPONENT_MUD, w);
     struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, wid);
-    struct face* face = assets_load("window.face");
+    struct face* face = asset_handles.window_face;
     Vector2 scale = {{1, 1}};
 
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_DEPTH_TEST);
     Vector2 winPos;
     Vector2 pen;
     {
@@ -293,18 +428,17 @@ static void win_draw_debug(session_t* ps, win* w) {
         free(text);
     }
 
-    glEnable(GL_DEPTH_TEST);
+    glstate_enable(GL_DEPTH_TEST);
 }
 #endif
 
-bool wd_init(struct WindowDrawable* drawable, struct X11Context* context, Window wid) {
+bool wd_init(struct WindowDrawable* drawable, struct X11Context* context, Window wid, VisualID visual) {
     assert(drawable != NULL);
 
-    XWindowAttributes attribs;
-    XGetWindowAttributes(context->display, wid, &attribs);
-
     drawable->wid = wid;
-    drawable->fbconfig = xorgContext_selectConfig(context, XVisualIDFromVisual(attribs.visual));
+    drawable->fbconfig = xorgContext_selectConfig(context, visual);
+    drawable->fence.id = None;
+    drawable->fence.triggered = false;
 
     return xtexture_init(&drawable->xtexture, context);
 }
@@ -312,6 +446,12 @@ bool wd_init(struct WindowDrawable* drawable, struct X11Context* context, Window
 bool wd_bind(struct WindowDrawable* drawable) {
     assert(drawable != NULL);
 
+    // The named pixmap stays valid until the window is resized or unmapped,
+    // so we only have to pick up the new contents.
+    if(drawable->bound) {
+        return xtexture_refresh(&drawable->xtexture);
+    }
+
     Pixmap pixmap = XCompositeNameWindowPixmap(drawable->context->display, drawable->wid);
     if(pixmap == 0) {
         printf_errf("Failed getting window pixmap");
@@ -329,10 +469,9 @@ bool wd_unbind(struct WindowDrawable* drawable) {
 
 void wd_delete(struct WindowDrawable* drawable) {
     assert(drawable != NULL);
-    // In debug mode we want to crash if we do this.
-    assert(!drawable->bound);
     if(drawable->bound) {
         wd_unbind(drawable);
     }
+    xorgContext_releaseFence(drawable->context, &drawable->fence);
     texture_delete(&drawable->texture);
 }
@@ -21,7 +21,9 @@ struct _session_t;
 
 struct WindowDrawable {
     Window wid;
-    GLXFBConfig* fbconfig;
+    const glx_fbconfig_t* fbconfig;
+    // Triggered by the server when it's done drawing the window contents
+    struct XFence fence;
 
     // This is a bit of magic. In C11 we can have anonymous struct members, but
     // they have to be untagged. We'd prefer to be able to use a tagged one,
@@ -41,6 +43,31 @@ struct FocusChangedComponent {
 
 struct WintypeChangedComponent {
     wintype_t newType;
+
+    // Pending fetch of _NET_WM_WINDOW_TYPE
+    size_t request;
+};
+
+struct OpaqueRegionChangedComponent {
+    // Pending fetch of _NET_WM_OPAQUE_REGION
+    size_t request;
+    // Pending lookup of where the client is inside the frame, XBATCH_NONE if
+    // the client is the frame
+    size_t translateRequest;
+};
+
+struct WdataChangedComponent {
+    // Which of the strings need to be refetched
+    bool name;
+    bool class;
+    bool role;
+
+    // Pending fetches of the strings. The legacy name is only used if the
+    // EWMH one is missing.
+    size_t nameRequest;
+    size_t legacyNameRequest;
+    size_t classRequest;
+    size_t roleRequest;
 };
 
 struct TracksWindowComponent {
@@ -66,11 +93,17 @@ struct ResizeComponent {
 struct MapComponent {
     Vector2 position;
     Vector2 size;
+    VisualID visual;
+
+    // Pending fetch of _NET_WM_BYPASS_COMPOSITOR
+    size_t bypassRequest;
 };
 
 struct TexturedComponent {
     struct Texture texture;
-    struct RenderBuffer stencil;
+    // The texture isn't kept up to date, and the bound pixmap is sampled
+    // directly instead. Only valid while the window binds a texture.
+    bool direct;
 };
 
 struct BindsTextureComponent {
@@ -138,10 +171,32 @@ struct DimComponent {
 
 struct ShapedComponent {
     struct face* face;
+    // The shape is just the window rectangle
+    bool rectangular;
+};
+
+struct OpaqueRegionComponent {
+    // The largest rect of the opaque region the client reported, in window
+    // coordinates including the border
+    struct Rect rect;
+};
+
+struct ContentsDamagedComponent {
+    // The entire window has to be redrawn, and rects should be ignored
+    bool full;
+    // The damaged parts as struct Rect, in window coordinates including the
+    // border
+    Vector rects;
+
+    // The server has damage we haven't fetched yet
+    bool fetch;
+    size_t request;
 };
 
 struct ShapeDamagedEvent {
     Vector rects;
+    size_t geometryRequest;
+    size_t shapeRequest;
 };
 
 extern const char* const StateNames[];
@@ -215,6 +270,30 @@ bool win_overlap(Swiss* em, win_id w1, win_id w2);
 bool win_mapped(Swiss* em, win_id wid);
 bool win_is_solid(win* w);
 
+// Whether the contents of the window have no alpha channel
+bool win_opaqueContents(Swiss* em, win_id wid);
+// The part of the window that's known to be opaque, in window coordinates
+// including the border. False if we don't know of any.
+bool win_opaqueRect(Swiss* em, win_id wid, struct Rect* rect);
+
+// The smallest format that holds the contents of the window
+enum TextureFormat win_contentsFormat(Swiss* em, win_id wid);
+
+// The texture to sample for the contents of the window
+const struct Texture* win_contentsTexture(Swiss* em, win_id wid);
+
+// Damage all of the window contents
+void win_damageContents(Swiss* em, win_id wid);
+// Damage a part of the window contents, in window coordinates
+void win_damageContentsRect(Swiss* em, win_id wid, const Vector2* pos, const Vector2* size);
+// Damage the window contents, with the damaged part to be fetched from the
+// server along with the rest of the requests for the frame
+void win_damageContentsPending(Swiss* em, win_id wid);
+// Whether the damaged contents of one window overlap with another window
+bool win_damageOverlap(Swiss* em, win_id damaged, win_id other);
+// Remove the contents damage of all windows
+void win_clearContentsDamage(Swiss* em);
+
 void fade_keyframe(struct Fading* fade, double opacity, double duration);
 
 void fade_init(struct Fading* fade, double value);
@@ -225,8 +304,10 @@ void win_draw(struct _session_t* ps, win* w, float z);
 void win_postdraw(struct _session_t* ps, win* w);
 void win_update(struct _session_t* ps, win* w, double dt);
 
-bool wd_init(struct WindowDrawable* drawable, struct X11Context* context, Window wid);
+bool wd_init(struct WindowDrawable* drawable, struct X11Context* context, Window wid, VisualID visual);
 void wd_delete(struct WindowDrawable* drawable);
 
+// Bind the current contents of the window. The pixmap is kept bound between
+// calls, and only named again after the drawable has been unbound.
 bool wd_bind(struct WindowDrawable* drawable);
 bool wd_unbind(struct WindowDrawable* drawable);
@@ -0,0 +1,145 @@
+#include "windowbatch.h"
+
+#include "assets/assets.h"
+#include "assets/shader.h"
+#include "assets/handles.h"
+#include "shaders/shaderinfo.h"
+#include "renderutil.h"
+#include "glstate.h"
+#include "logging.h"
+
+#include <stddef.h>
+#include <assert.h>
+
+// Must match the flag bits in instanced.vs
+#define INSTANCE_FLIP   (1 << 0)
+#define INSTANCE_INVERT (1 << 1)
+
+bool windowbatch_init(struct WindowBatch* batch) {
+    glGenVertexArrays(1, &batch->vao);
+    glGenBuffers(1, &batch->instances);
+    batch->face = NULL;
+    batch->features = 0;
+
+    vector_init(&batch->pending, sizeof(struct WindowInstance), WINDOWBATCH_TEXTURES);
+
+    batch->initialized = true;
+    return true;
+}
+
+void windowbatch_delete(struct WindowBatch* batch) {
+    if(!batch->initialized)
+        return;
+
+    glDeleteBuffers(1, &batch->instances);
+    glDeleteVertexArrays(1, &batch->vao);
+    glstate_deletedVertexArray(batch->vao);
+    vector_kill(&batch->pending);
+    batch->initialized = false;
+}
+
+bool windowbatch_accepts(const struct Texture* texture) {
+    return texture->target == GL_TEXTURE_2D;
+}
+
+// The per vertex data comes from the face, the per instance data from our
+// own buffer
+static void setup_vao(struct WindowBatch* batch, struct face* face) {
+    glstate_bindVertexArray(batch->vao);
+
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, face->vertex);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, face->uv);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch->instances);
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(struct WindowInstance),
+            (void*)offsetof(struct WindowInstance, rect));
+    glVertexAttribDivisor(2, 1);
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(struct WindowInstance),
+            (void*)offsetof(struct WindowInstance, params));
+    glVertexAttribDivisor(3, 1);
+
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(struct WindowInstance),
+            (void*)offsetof(struct WindowInstance, uvscale));
+    glVertexAttribDivisor(4, 1);
+
+    batch->face = face;
+}
+
+void windowbatch_add(struct WindowBatch* batch, const struct Texture* texture,
+        const Vector3* pos, const Vector2* size, float dim, bool invert) {
+    assert(batch->initialized);
+    assert(windowbatch_accepts(texture));
+
+    if(vector_size(&batch->pending) == WINDOWBATCH_TEXTURES)
+        windowbatch_flush(batch);
+
+    size_t unit = vector_size(&batch->pending);
+    batch->textures[unit] = texture;
+
+    int flags = 0;
+    if(texture->flipped)
+        flags |= INSTANCE_FLIP;
+    if(invert)
+        flags |= INSTANCE_INVERT;
+
+    if(dim < 1.0)
+        batch->features |= asset_handles.instanced_features.dim;
+    if(invert)
+        batch->features |= asset_handles.instanced_features.invert;
+
+    Vector2 uvscale = texture_uvscale(texture);
+    struct WindowInstance instance = {
+        .rect = {pos->x, pos->y, size->x, size->y},
+        .params = {pos->z, dim, flags, unit},
+        .uvscale = {uvscale.x, uvscale.y},
+    };
+    vector_putBack(&batch->pending, &instance);
+}
+
+void windowbatch_flush(struct WindowBatch* batch) {
+    size_t count = vector_size(&batch->pending);
+    if(count == 0)
+        return;
+
+    struct face* face = asset_handles.window_face;
+    struct shader_program* program = shader_program_variant(asset_handles.instanced.program,
+            batch->features);
+    struct Instanced* instanced_type = program->shader_type;
+
+    // The view comes from the frame block
+    shader_use(program);
+
+    static const GLint units[WINDOWBATCH_TEXTURES] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    };
+    glUniform1iv(instanced_type->tex_scr->gl_uniform, WINDOWBATCH_TEXTURES, units);
+
+    for(size_t i = 0; i < count; i++) {
+        texture_bind(batch->textures[i], GL_TEXTURE0 + i);
+    }
+
+    // Orphan the old contents, the previous draw might still be reading them
+    glBindBuffer(GL_ARRAY_BUFFER, batch->instances);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(struct WindowInstance) * count,
+            batch->pending.data, GL_STREAM_DRAW);
+
+    if(batch->face != face)
+        setup_vao(batch, face);
+
+    glstate_bindVertexArray(batch->vao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, face->vertex_buffer.size / 3, count);
+
+    glstate_activeTexture(GL_TEXTURE0);
+    vector_clear(&batch->pending);
+    batch->features = 0;
+}
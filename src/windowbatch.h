@@ -0,0 +1,54 @@
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glx.h>
+
+#include "vmath.h"
+#include "vector.h"
+#include "texture.h"
+#include "assets/face.h"
+
+// Draws many rectangular windows with a single instanced draw call. Each
+// window gets an instance with its rect and parameters, and its texture is
+// bound to a unit of its own, which the fragment shader picks by index.
+//
+// The windows don't share a texture, and we don't have bindless textures
+// in a 3.2 context, so a draw holds at most as many windows as we have
+// units. When they run out the batch is flushed and started over.
+
+#define WINDOWBATCH_TEXTURES 16
+
+struct WindowInstance {
+    // Position and size in GL coordinates
+    float rect[4];
+    // z, dim, flags and texture unit
+    float params[4];
+    // Scale of the texture uvs
+    float uvscale[2];
+};
+
+struct WindowBatch {
+    bool initialized;
+
+    GLuint vao;
+    GLuint instances;
+    // The face the vao was set up with
+    struct face* face;
+
+    Vector pending;
+    const struct Texture* textures[WINDOWBATCH_TEXTURES];
+    // The variant of the instanced shader covering every pending window.
+    // Windows that don't need a feature are neutral under it.
+    unsigned int features;
+};
+
+bool windowbatch_init(struct WindowBatch* batch);
+void windowbatch_delete(struct WindowBatch* batch);
+
+// Whether the texture can be drawn by the batch
+bool windowbatch_accepts(const struct Texture* texture);
+
+void windowbatch_add(struct WindowBatch* batch, const struct Texture* texture,
+        const Vector3* pos, const Vector2* size, float dim, bool invert);
+// Draw everything added so far
+void windowbatch_flush(struct WindowBatch* batch);
@@ -4,6 +4,7 @@
 
 #include "assets/shader.h"
 #include "assets/assets.h"
+#include "assets/handles.h"
 
 #include "shaders/shaderinfo.h"
 
@@ -12,12 +13,16 @@
 #include "window.h"
 #include "blur.h"
 #include "renderutil.h"
+#include "glstate.h"
+#include "uniformbuffer.h"
+#include "rendertarget.h"
+#include "gpumem.h"
 
 DECLARE_ZONE(update_blur);
+DECLARE_ZONE(update_occlusion);
 DECLARE_ZONE(fetch_candidates);
 
 DECLARE_ZONE(paint_backgrounds);
-DECLARE_ZONE(paint_tints);
 DECLARE_ZONE(paint_windows);
 DECLARE_ZONE(paint_transparents);
 
@@ -34,10 +39,45 @@ Vector2 X11_rectpos_to_gl(session_t *ps, const Vector2* xpos, const Vector2* siz
     return glpos;
 }
 
+// Draw a window with the variant of the global shader that does just what
+// the window needs. The tint is premultiplied, and NULL for no tint.
+static void draw_window(session_t* ps, struct face* face, const Vector3* pos,
+        const Vector2* size, float opacity, float dim, bool invert,
+        const struct Texture* texture, const Vector4* tint) {
+    unsigned int features = 0;
+    if(dim < 1.0)
+        features |= asset_handles.global_features.dim;
+    if(invert)
+        features |= asset_handles.global_features.invert;
+    if(tint != NULL)
+        features |= asset_handles.global_features.tint;
+
+    struct shader_program* program = shader_program_variant(asset_handles.global.program, features);
+    struct Global* global_type = program->shader_type;
+    shader_set_future_uniform_sampler(global_type->tex_scr, 0);
+    shader_use(program);
+
+    int flags = 0;
+    if(texture->flipped)
+        flags |= WINDOWUNIFORMS_FLIP;
+
+    Vector2 uvscale = texture_uvscale(texture);
+    struct WindowUniforms window = {
+        .rect = {pos->x, pos->y, size->x, size->y},
+        .params = {pos->z, opacity, dim, flags},
+        .uvscale = {uvscale.x, uvscale.y},
+    };
+    if(tint != NULL)
+        memcpy(window.tint, tint->m, sizeof(window.tint));
+    uniformbuffer_pushWindow(&ps->psglx->uniforms, &window);
+
+    face_draw(face);
+}
+
 void windowlist_drawBackground(session_t* ps, Vector* opaque) {
     zone_enter(&ZONE_paint_backgrounds);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
+    glstate_enable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_TRUE);
 
     {
         size_t index;
@@ -53,26 +93,26 @@ void windowlist_drawBackground(session_t* ps, Vector* opaque) {
                 struct glx_blur_cache* blur = swiss_getComponent(&ps->win_list, COMPONENT_BLUR, *w_id);
                 Vector3 dglPos = vec3_from_vec2(&glPos, z->z + 0.000001);
 
-                draw_tex(shaped->face, &blur->texture[0], &dglPos, &physical->size);
+                draw_tex(shaped->face, &blur->texture, &dglPos, &physical->size);
             }
 
             w_id = vector_getNext(opaque, &index);
         }
     }
 
-    glDepthMask(GL_FALSE);
-    glDisable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_FALSE);
+    glstate_disable(GL_DEPTH_TEST);
     zone_leave(&ZONE_paint_backgrounds);
 }
 
 void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
     zone_enter(&ZONE_paint_transparents);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_FALSE);
-    glEnable(GL_BLEND);
+    glstate_enable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_FALSE);
+    glstate_enable(GL_BLEND);
 
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+    glstate_blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glstate_blendEquationSeparate(GL_FUNC_ADD, GL_MAX);
 
     size_t index;
     win_id* w_id = vector_getLast(transparent, &index);
@@ -90,66 +130,33 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
             struct glx_blur_cache* blur = swiss_getComponent(&ps->win_list, COMPONENT_BLUR, *w_id);
             Vector3 dglPos = vec3_from_vec2(&glPos, z->z + 0.00001);
 
-            struct shader_program* passthough_program = assets_load("passthough.shader");
-            if(passthough_program->shader_type_info != &passthough_info) {
-                printf_errf("Shader was not a passthough shader\n");
-                return;
-            }
-            struct Passthough* passthough_type = passthough_program->shader_type;
-            shader_set_future_uniform_bool(passthough_type->flip, blur->texture[0].flipped);
+            struct shader_program* passthough_program = asset_handles.passthough.program;
+            struct Passthough* passthough_type = asset_handles.passthough.type;
+            Vector2 uvscale = texture_uvscale(&blur->texture);
+            shader_set_future_uniform_bool(passthough_type->flip, blur->texture.flipped);
+            shader_set_future_uniform_vec2(passthough_type->uvscale, &uvscale);
             shader_set_future_uniform_float(passthough_type->opacity, opacity->opacity/100.0);
             shader_set_future_uniform_sampler(passthough_type->tex_scr, 0);
 
             shader_use(passthough_program);
 
-            texture_bind(&blur->texture[0], GL_TEXTURE0);
+            texture_bind(&blur->texture, GL_TEXTURE0);
 
             /* Vector4 color = {{opacity->opacity/100, opacity->opacity/100, opacity->opacity/100, opacity->opacity/100}}; */
             /* draw_colored_rect(w->face, &dglPos, &physical->size, &color); */
             draw_rect(shaped->face, passthough_type->mvp, dglPos, physical->size);
         }
 
-        // Tint
-        if(opacity != NULL && swiss_hasComponent(&ps->win_list, COMPONENT_TINT, *w_id)) {
-            struct TintComponent* tint = swiss_getComponent(&ps->win_list, COMPONENT_TINT, *w_id);
-            struct shader_program* program = assets_load("tint.shader");
-            if(program->shader_type_info != &colored_info) {
-                printf_errf("Shader was not a colored shader");
-                return;
-            }
-            struct Colored* shader_type = program->shader_type;
-
-            shader_set_future_uniform_vec2(shader_type->viewport, &ps->root_size);
-            shader_use(program);
-
-            {
-                double opac = opacity->opacity / 100.0;
-                shader_set_uniform_float(shader_type->opacity, tint->color.w * opac);
-                Vector3 color = tint->color.rgb;
-                vec3_imul(&color, opac);
-                shader_set_uniform_vec3(shader_type->color, &color);
-            }
-
-            {
-                Vector2 glRectPos = X11_rectpos_to_gl(ps, &physical->position, &physical->size);
-                Vector3 winpos = vec3_from_vec2(&glRectPos, z->z);
-
-                draw_rect(shaped->face, shader_type->mvp, winpos, physical->size);
-            }
-        }
-
         // Shadow
         // This renders shadows for all windows, transparent or no.
         if(swiss_hasComponent(&ps->win_list, COMPONENT_SHADOW, *w_id)) {
             struct glx_shadow_cache* shadow = swiss_getComponent(&ps->win_list, COMPONENT_SHADOW, *w_id);
-            struct shader_program* program = assets_load("passthough.shader");
-            if(program->shader_type_info != &passthough_info) {
-                printf_errf("Shader was not a passthrough shader");
-                return;
-            }
-            struct Passthough* shader_type = program->shader_type;
+            struct shader_program* program = asset_handles.passthough.program;
+            struct Passthough* shader_type = asset_handles.passthough.type;
 
+            Vector2 uvscale = texture_uvscale(&shadow->effect);
             shader_set_future_uniform_bool(shader_type->flip, shadow->effect.flipped);
+            shader_set_future_uniform_vec2(shader_type->uvscale, &uvscale);
             shader_set_future_uniform_sampler(shader_type->tex_scr, 0);
             if(opacity != NULL) {
                 shader_set_future_uniform_float(shader_type->opacity, opacity->opacity / 100.0);
@@ -164,7 +171,7 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
                 Vector2 rpos = glPos;
                 vec2_sub(&rpos, &shadow->border);
                 Vector3 tdrpos = vec3_from_vec2(&rpos, z->z);
-                Vector2 rsize = shadow->texture.size;
+                Vector2 rsize = shadow->effect.size;
 
                 draw_rect(shaped->face, shader_type->mvp, tdrpos, rsize);
             }
@@ -172,38 +179,39 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
 
 
         // Content
-        if(opacity != NULL && swiss_hasComponent(&ps->win_list, COMPONENT_TEXTURED, *w_id)) {
-            struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, *w_id);
+        // Windows with an alpha channel are blended here, except for the
+        // opaque part drawn in the opaque pass, which the depth test rejects.
+        bool blended = opacity != NULL || !win_opaqueContents(&ps->win_list, *w_id);
+        if(blended && swiss_hasComponent(&ps->win_list, COMPONENT_TEXTURED, *w_id)) {
+            const struct Texture* texture = win_contentsTexture(&ps->win_list, *w_id);
             struct DimComponent* dim = swiss_getComponent(&ps->win_list, COMPONENT_DIM, *w_id);
-            struct shader_program* global_program = assets_load("global.shader");
-            if(global_program->shader_type_info != &global_info) {
-                printf_errf("Shader was not a global shader");
-                // @INCOMPLETE: Make sure the config is correct
-                return;
-            }
-
-            struct Global* global_type = global_program->shader_type;
-
-            shader_set_future_uniform_sampler(global_type->tex_scr, 0);
-
-            shader_set_future_uniform_bool(global_type->invert, w->invert_color);
-            shader_set_future_uniform_bool(global_type->flip, textured->texture.flipped);
-            shader_set_future_uniform_float(global_type->opacity, (float)(opacity->opacity / 100.0));
-            shader_set_future_uniform_float(global_type->dim, dim->dim/100.0);
-
-            shader_use(global_program);
             zone_enter_extra(&ZONE_paint_window, "%s", w->name);
 
+            // The tint is drawn behind the contents of windows with an
+            // opacity
+            Vector4 tintColor;
+            bool tinted = opacity != NULL && swiss_hasComponent(&ps->win_list, COMPONENT_TINT, *w_id);
+            if(tinted) {
+                struct TintComponent* tint = swiss_getComponent(&ps->win_list, COMPONENT_TINT, *w_id);
+                double opac = opacity->opacity / 100.0;
+                tintColor.rgb = tint->color.rgb;
+                vec3_imul(&tintColor.rgb, tint->color.w * opac * opac);
+                tintColor.w = tint->color.w * opac;
+            }
+
             // Bind texture
-            texture_bind(&textured->texture, GL_TEXTURE0);
+            texture_bind(texture, GL_TEXTURE0);
 
             {
-                Vector2 glRectPos = X11_rectpos_to_gl(ps, &physical->position, &textured->texture.size);
+                Vector2 glRectPos = X11_rectpos_to_gl(ps, &physical->position, &texture->size);
                 Vector3 winpos = vec3_from_vec2(&glRectPos, z->z);
 
                 /* Vector4 color = {{0.0, 1.0, 0.4, opacity->opacity/100}}; */
-                /* draw_colored_rect(w->face, &winpos, &textured->texture.size, &color); */
-                draw_rect(shaped->face, global_type->mvp, winpos, textured->texture.size);
+                /* draw_colored_rect(w->face, &winpos, &texture->size, &color); */
+                draw_window(ps, shaped->face, &winpos, &texture->size,
+                        opacity != NULL ? (float)(opacity->opacity / 100.0) : 1.0,
+                        dim->dim/100.0, w->invert_color, texture,
+                        tinted ? &tintColor : NULL);
             }
 
             zone_leave(&ZONE_paint_window);
@@ -212,89 +220,56 @@ void windowlist_drawTransparent(session_t* ps, Vector* transparent) {
         w_id = vector_getPrev(transparent, &index);
     }
 
-    glDisable(GL_BLEND);
-    glDepthMask(GL_TRUE);
-    glDisable(GL_DEPTH_TEST);
+    glstate_disable(GL_BLEND);
+    glstate_depthMask(GL_TRUE);
+    glstate_disable(GL_DEPTH_TEST);
     zone_leave(&ZONE_paint_transparents);
 }
 
-void windowlist_drawTint(session_t* ps) {
-    zone_enter(&ZONE_paint_tints);
-    glEnable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_FALSE);
-
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
-
-    struct shader_program* program = assets_load("tint.shader");
-    if(program->shader_type_info != &colored_info) {
-        printf_errf("Shader was not a colored shader");
-        glDepthMask(GL_TRUE);
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
-        return;
-    }
-    struct Colored* shader_type = program->shader_type;
-
-    shader_set_future_uniform_vec2(shader_type->viewport, &ps->root_size);
-    shader_use(program);
-
-    for_components(it, &ps->win_list,
-            COMPONENT_MUD, COMPONENT_TINT, COMPONENT_PHYSICAL, COMPONENT_Z, CQ_END) {
-        struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, it.id);
-        struct TintComponent* tint = swiss_getComponent(&ps->win_list, COMPONENT_TINT, it.id);
-        struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, it.id);
-        struct ZComponent* z = swiss_getComponent(&ps->win_list, COMPONENT_Z, it.id);
-
-        shader_set_uniform_float(shader_type->opacity, tint->color.w);
-        shader_set_uniform_vec3(shader_type->color, &tint->color.rgb);
-
-        {
-            Vector2 glRectPos = X11_rectpos_to_gl(ps, &physical->position, &physical->size);
-            Vector3 winpos = vec3_from_vec2(&glRectPos, z->z);
-
-            /* Vector4 color = {{0.0, 1.0, 0.4, 1.0}}; */
-            /* draw_colored_rect(w->face, &winpos, &textured->texture.size, &color); */
-            draw_rect(shaped->face, shader_type->mvp, winpos, physical->size);
-        }
-    }
-
-    glDepthMask(GL_TRUE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
-    zone_leave(&ZONE_paint_tints);
-}
-
 void windowlist_draw(session_t* ps, Vector* order) {
     zone_enter(&ZONE_paint_windows);
-    glEnable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
-
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquationSeparate(GL_FUNC_ADD, GL_MAX);
-
-    struct shader_program* global_program = assets_load("global.shader");
-    if(global_program->shader_type_info != &global_info) {
-        printf_errf("Shader was not a global shader");
-        glDepthMask(GL_TRUE);
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
-        return;
-    }
-
-    struct Global* global_type = global_program->shader_type;
-
-    shader_set_future_uniform_sampler(global_type->tex_scr, 0);
-
-    shader_use(global_program);
+    glstate_enable(GL_BLEND);
+    glstate_enable(GL_DEPTH_TEST);
+    glstate_depthMask(GL_TRUE);
+
+    glstate_blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glstate_blendEquationSeparate(GL_FUNC_ADD, GL_MAX);
+
+    // Windows with an alpha channel only draw their opaque part here, which
+    // is done by narrowing the scissor. Without a scissor in screen
+    // coordinates they are left for the transparent pass entirely.
+    bool scissored = glstate_isEnabled(GL_SCISSOR_TEST);
+    GLint scissor[4];
+    glstate_getScissor(scissor);
+
+    // Plain rectangles are left for the batch, which draws them all at the end
+    struct WindowBatch* batch = &ps->psglx->window_batch;
+    bool batching = batch->initialized && asset_handles.instanced.program != NULL;
+    Vector batched;
+    vector_init(&batched, sizeof(win_id), vector_size(order));
 
     size_t index;
     win_id* w_id = vector_getFirst(order, &index);
     while(w_id != NULL) {
+        struct Rect opaque;
+        bool partial = !win_opaqueContents(&ps->win_list, *w_id);
+        if(!win_opaqueRect(&ps->win_list, *w_id, &opaque) || (partial && !scissored)) {
+            w_id = vector_getNext(order, &index);
+            continue;
+        }
+
+        if(batching && !partial) {
+            struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, *w_id);
+            const struct Texture* texture = win_contentsTexture(&ps->win_list, *w_id);
+            if(shaped->rectangular && windowbatch_accepts(texture)) {
+                vector_putBack(&batched, w_id);
+                w_id = vector_getNext(order, &index);
+                continue;
+            }
+        }
+
         struct _win* w = swiss_getComponent(&ps->win_list, COMPONENT_MUD, *w_id);
-        struct TexturedComponent* textured = swiss_getComponent(&ps->win_list, COMPONENT_TEXTURED, *w_id);
+        const struct Texture* texture = win_contentsTexture(&ps->win_list, *w_id);
         struct ShapedComponent* shaped = swiss_getComponent(&ps->win_list, COMPONENT_SHAPED, *w_id);
         struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, *w_id);
         struct DimComponent* dim = swiss_getComponent(&ps->win_list, COMPONENT_DIM, *w_id);
@@ -302,30 +277,59 @@ void windowlist_draw(session_t* ps, Vector* order) {
 
         zone_enter_extra(&ZONE_paint_window, "%s", w->name);
 
-        shader_set_uniform_bool(global_type->invert, w->invert_color);
-        shader_set_uniform_bool(global_type->flip, textured->texture.flipped);
-        shader_set_uniform_float(global_type->dim, dim->dim/100.0);
-
         // Bind texture
-        texture_bind(&textured->texture, GL_TEXTURE0);
+        texture_bind(texture, GL_TEXTURE0);
+
+        if(partial) {
+            Vector2 pos = physical->position;
+            vec2_add(&pos, &opaque.pos);
+            Vector2 glPos = X11_rectpos_to_gl(ps, &pos, &opaque.size);
+
+            GLint x1 = max_i(glPos.x, scissor[0]);
+            GLint y1 = max_i(glPos.y, scissor[1]);
+            GLint x2 = min_i(glPos.x + opaque.size.x, scissor[0] + scissor[2]);
+            GLint y2 = min_i(glPos.y + opaque.size.y, scissor[1] + scissor[3]);
+            glstate_scissor(x1, y1, max_i(x2 - x1, 0), max_i(y2 - y1, 0));
+        }
 
         {
-            Vector2 glRectPos = X11_rectpos_to_gl(ps, &physical->position, &textured->texture.size);
+            Vector2 glRectPos = X11_rectpos_to_gl(ps, &physical->position, &texture->size);
             Vector3 winpos = vec3_from_vec2(&glRectPos, z->z);
 
             /* Vector4 color = {{0.0, 1.0, 0.4, 1.0}}; */
-            /* draw_colored_rect(w->face, &winpos, &textured->texture.size, &color); */
-            draw_rect(shaped->face, global_type->mvp, winpos, textured->texture.size);
+            /* draw_colored_rect(w->face, &winpos, &texture->size, &color); */
+            draw_window(ps, shaped->face, &winpos, &texture->size,
+                    1.0, dim->dim/100.0, w->invert_color, texture, NULL);
         }
 
+        if(partial)
+            glstate_scissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+
         zone_leave(&ZONE_paint_window);
 
         w_id = vector_getNext(order, &index);
     }
 
-    glDepthMask(GL_TRUE);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    w_id = vector_getFirst(&batched, &index);
+    while(w_id != NULL) {
+        struct _win* w = swiss_getComponent(&ps->win_list, COMPONENT_MUD, *w_id);
+        const struct Texture* texture = win_contentsTexture(&ps->win_list, *w_id);
+        struct PhysicalComponent* physical = swiss_getComponent(&ps->win_list, COMPONENT_PHYSICAL, *w_id);
+        struct DimComponent* dim = swiss_getComponent(&ps->win_list, COMPONENT_DIM, *w_id);
+        struct ZComponent* z = swiss_getComponent(&ps->win_list, COMPONENT_Z, *w_id);
+
+        Vector2 glRectPos = X11_rectpos_to_gl(ps, &physical->position, &texture->size);
+        Vector3 winpos = vec3_from_vec2(&glRectPos, z->z);
+        windowbatch_add(batch, texture, &winpos, &texture->size, dim->dim/100.0, w->invert_color);
+
+        w_id = vector_getNext(&batched, &index);
+    }
+    windowbatch_flush(batch);
+    vector_kill(&batched);
+
+    glstate_depthMask(GL_TRUE);
+    glstate_disable(GL_DEPTH_TEST);
+    glstate_disable(GL_BLEND);
     zone_leave(&ZONE_paint_windows);
 }
 
@@ -397,6 +401,179 @@ void fetchSortedWindowsWithArr(Swiss* em, Vector* result, CType* query) {
 #define fetchSortedWindowsWith(em, result, ...) \
     fetchSortedWindowsWithArr(em, result, (CType[]){ __VA_ARGS__ })
 
+// If a rect is cut into more pieces than this by the occluders we stop
+// tracking it and just consider all of it visible
+#define OCCLUSION_MAX_PIECES 64
+
+// Split the pieces around the occluder, keeping the parts that aren't covered
+static void subtract_rect(Vector* pieces, const struct Rect* occluder) {
+    Vector2 omin = occluder->pos;
+    Vector2 omax = occluder->pos;
+    vec2_add(&omax, &occluder->size);
+
+    // Walk backwards, so the pieces we add aren't visited
+    for(size_t i = vector_size(pieces); i-- > 0;) {
+        struct Rect piece = *(struct Rect*)vector_get(pieces, i);
+        Vector2 pmin = piece.pos;
+        Vector2 pmax = piece.pos;
+        vec2_add(&pmax, &piece.size);
+
+        Vector2 imin = pmin;
+        vec2_max(&imin, &omin);
+        Vector2 imax = pmax;
+        vec2_min(&imax, &omax);
+        if(imax.x <= imin.x || imax.y <= imin.y)
+            continue;
+
+        vector_remove(pieces, i);
+
+        // Above and below the intersection span the whole piece, left and
+        // right only the height of the intersection
+        const struct Rect parts[] = {
+            {.pos = {{pmin.x, pmin.y}}, .size = {{pmax.x - pmin.x, imin.y - pmin.y}}},
+            {.pos = {{pmin.x, imax.y}}, .size = {{pmax.x - pmin.x, pmax.y - imax.y}}},
+            {.pos = {{pmin.x, imin.y}}, .size = {{imin.x - pmin.x, imax.y - imin.y}}},
+            {.pos = {{imax.x, imin.y}}, .size = {{pmax.x - imax.x, imax.y - imin.y}}},
+        };
+        for(size_t j = 0; j < sizeof(parts) / sizeof(parts[0]); j++) {
+            if(parts[j].size.x > 0 && parts[j].size.y > 0)
+                vector_putBack(pieces, &parts[j]);
+        }
+    }
+}
+
+void visible_pieces(Vector* pieces, const struct Rect* rect, const Vector* occluders) {
+    vector_clear(pieces);
+    vector_putBack(pieces, rect);
+
+    size_t index;
+    const struct Rect* occluder = vector_getFirst(occluders, &index);
+    while(occluder != NULL && vector_size(pieces) > 0) {
+        subtract_rect(pieces, occluder);
+
+        if(vector_size(pieces) > OCCLUSION_MAX_PIECES) {
+            vector_clear(pieces);
+            vector_putBack(pieces, rect);
+            return;
+        }
+
+        occluder = vector_getNext(occluders, &index);
+    }
+}
+
+// Windows we know cover everything below them, at least in the rect
+static bool is_occluder(Swiss* em, win_id wid, struct Rect* rect) {
+    if(!swiss_hasComponent(em, COMPONENT_TEXTURED, wid)
+            || swiss_hasComponent(em, COMPONENT_OPACITY, wid))
+        return false;
+
+    // Windows that are fading can turn translucent before we paint
+    if(swiss_hasComponent(em, COMPONENT_FADES_OPACITY, wid)) {
+        struct FadesOpacityComponent* fo = swiss_getComponent(em, COMPONENT_FADES_OPACITY, wid);
+        if(!fade_done(&fo->fade))
+            return false;
+    }
+
+    // We don't bother cutting shaped windows out of the occluded area
+    struct ShapedComponent* shaped = swiss_getComponent(em, COMPONENT_SHAPED, wid);
+    if(!shaped->rectangular)
+        return false;
+
+    if(!win_opaqueRect(em, wid, rect))
+        return false;
+
+    struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, wid);
+    vec2_add(&rect->pos, &physical->position);
+    return true;
+}
+
+void windowlist_updateOcclusion(session_t* ps) {
+    zone_enter(&ZONE_update_occlusion);
+    Swiss* em = &ps->win_list;
+
+    Vector occluders;
+    vector_init(&occluders, sizeof(struct Rect), 16);
+    Vector pieces;
+    vector_init(&pieces, sizeof(struct Rect), 16);
+
+    // Walk down from the top, so every window is tested against the opaque
+    // windows above it
+    size_t index;
+    win_id* w_id = vector_getLast(&ps->order, &index);
+    while(w_id != NULL) {
+        if(!swiss_hasComponent(em, COMPONENT_PHYSICAL, *w_id)) {
+            w_id = vector_getPrev(&ps->order, &index);
+            continue;
+        }
+        struct PhysicalComponent* physical = swiss_getComponent(em, COMPONENT_PHYSICAL, *w_id);
+
+        struct Rect window = {
+            .pos = physical->position,
+            .size = physical->size,
+        };
+
+        // The shadow sticks out from under the window
+        struct Rect extents = window;
+        if(swiss_hasComponent(em, COMPONENT_SHADOW, *w_id)) {
+            struct glx_shadow_cache* shadow = swiss_getComponent(em, COMPONENT_SHADOW, *w_id);
+            vec2_sub(&extents.pos, &shadow->border);
+            vec2_max(&extents.size, &shadow->effect.size);
+        }
+
+        visible_pieces(&pieces, &extents, &occluders);
+        bool occluded = vector_size(&pieces) == 0;
+
+        if(occluded) {
+            swiss_ensureComponent(em, COMPONENT_OCCLUDED, *w_id);
+        } else if(swiss_hasComponent(em, COMPONENT_OCCLUDED, *w_id)) {
+            // Updates were skipped while the window was hidden, so
+            // everything we have for it is stale
+            swiss_removeComponent(em, COMPONENT_OCCLUDED, *w_id);
+            if(swiss_hasComponent(em, COMPONENT_BINDS_TEXTURE, *w_id))
+                win_damageContents(em, *w_id);
+            swiss_ensureComponent(em, COMPONENT_SHADOW_DAMAGED, *w_id);
+            swiss_ensureComponent(em, COMPONENT_BLUR_DAMAGED, *w_id);
+        }
+
+        struct Rect opaque;
+        if(!occluded && is_occluder(em, *w_id, &opaque))
+            vector_putBack(&occluders, &opaque);
+
+        w_id = vector_getPrev(&ps->order, &index);
+    }
+
+    // The root is only painted where no window covers it
+    struct Rect root = {
+        .pos = {{0, 0}},
+        .size = ps->root_size,
+    };
+    visible_pieces(&pieces, &root, &occluders);
+
+    Vector2 visibleMin = ps->root_size;
+    Vector2 visibleMax = {{0, 0}};
+    struct Rect* piece = vector_getFirst(&pieces, &index);
+    while(piece != NULL) {
+        Vector2 pieceMax = piece->pos;
+        vec2_add(&pieceMax, &piece->size);
+
+        vec2_min(&visibleMin, &piece->pos);
+        vec2_max(&visibleMax, &pieceMax);
+        piece = vector_getNext(&pieces, &index);
+    }
+    if(vector_size(&pieces) == 0) {
+        ps->root_visible_pos = (Vector2){{0, 0}};
+        ps->root_visible_size = (Vector2){{0, 0}};
+    } else {
+        ps->root_visible_pos = visibleMin;
+        ps->root_visible_size = visibleMax;
+        vec2_sub(&ps->root_visible_size, &visibleMin);
+    }
+
+    vector_kill(&pieces);
+    vector_kill(&occluders);
+    zone_leave(&ZONE_update_occlusion);
+}
+
 void windowlist_updateBlur(session_t* ps) {
     zone_enter(&ZONE_update_blur);
     zone_enter(&ZONE_fetch_candidates);
@@ -404,19 +581,21 @@ void windowlist_updateBlur(session_t* ps) {
     vector_init(&to_blur, sizeof(win_id), ps->win_list.size);
     fetchSortedWindowsWith(&ps->win_list, &to_blur, 
             COMPONENT_MUD, COMPONENT_BLUR, COMPONENT_BLUR_DAMAGED, COMPONENT_Z,
-            COMPONENT_PHYSICAL, CQ_END);
+            COMPONENT_PHYSICAL, CQ_NOT, COMPONENT_OCCLUDED, CQ_END);
 
+    // Occluded windows aren't kept up to date, and their textures might
+    // have been evicted, so they can't be drawn into the blur either
     Vector opaque_renderable;
     vector_init(&opaque_renderable, sizeof(win_id), ps->win_list.size);
     fetchSortedWindowsWith(&ps->win_list, &opaque_renderable, 
             COMPONENT_MUD, COMPONENT_TEXTURED, COMPONENT_Z, COMPONENT_PHYSICAL,
-            CQ_NOT, COMPONENT_OPACITY, CQ_END);
+            CQ_NOT, COMPONENT_OPACITY, CQ_NOT, COMPONENT_OCCLUDED, CQ_END);
 
     Vector shadow_renderable;
     vector_init(&shadow_renderable, sizeof(win_id), ps->win_list.size);
     fetchSortedWindowsWith(&ps->win_list, &shadow_renderable, 
             COMPONENT_MUD, COMPONENT_SHADOW, COMPONENT_Z, COMPONENT_PHYSICAL,
-            CQ_NOT, COMPONENT_OPACITY, CQ_END);
+            CQ_NOT, COMPONENT_OPACITY, CQ_NOT, COMPONENT_OCCLUDED, CQ_END);
 
     Vector transparent_renderable;
     vector_init(&transparent_renderable, sizeof(win_id), ps->win_list.size);
@@ -425,18 +604,15 @@ void windowlist_updateBlur(session_t* ps) {
     // some way to merge vectors.
     fetchSortedWindowsWith(&ps->win_list, &transparent_renderable, 
             COMPONENT_MUD, COMPONENT_Z, COMPONENT_PHYSICAL,
-            /* COMPONENT_OPACITY, */ CQ_END);
+            /* COMPONENT_OPACITY, */ CQ_NOT, COMPONENT_OCCLUDED, CQ_END);
     zone_leave(&ZONE_fetch_candidates);
 
-    struct blur* cache = &ps->psglx->blur;
+    struct RenderTargetPool* pool = &ps->psglx->targets;
 
-    framebuffer_resetTarget(&cache->fbo);
-    framebuffer_bind(&cache->fbo);
+    struct face* face = asset_handles.window_face;
 
-    struct face* face = assets_load("window.face");
-
-    glDisable(GL_STENCIL_TEST);
-    glDisable(GL_SCISSOR_TEST);
+    glstate_disable(GL_STENCIL_TEST);
+    glstate_disable(GL_SCISSOR_TEST);
 
     // Blurring is a strange process, because every window depends on the blurs
     // behind it. Therefore we render them individually, starting from the
@@ -449,23 +625,27 @@ void windowlist_updateBlur(session_t* ps) {
 
         Vector2 glpos = X11_rectpos_to_gl(ps, &physical->position, &physical->size);
 
-        struct Texture* tex = &blur->texture[1];
-
-        framebuffer_resetTarget(&cache->fbo);
-        framebuffer_targetRenderBuffer_stencil(&cache->fbo, &blur->stencil);
-        framebuffer_targetTexture(&cache->fbo, tex);
-        framebuffer_rebind(&cache->fbo);
+        struct RenderTarget* target = rendertargetpool_acquire(pool, &blur->texture.size,
+                blur->texture.format);
+        if(target == NULL) {
+            printf_errf("Failed getting a render target for the blur");
+            w_id = vector_getPrev(&to_blur, &index);
+            continue;
+        }
+        rendertarget_bind(target);
 
         Matrix old_view = view;
         view = mat4_orthogonal(glpos.x, glpos.x + physical->size.x, glpos.y, glpos.y + physical->size.y, -1, 1);
         glViewport(0, 0, physical->size.x, physical->size.y);
+        // The frame block is set back to the root when the frame is painted
+        uniformbuffer_setFrame(&ps->psglx->uniforms, &view, &physical->size);
 
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
+        glstate_enable(GL_DEPTH_TEST);
+        glstate_enable(GL_BLEND);
 
         glClearColor(1.0, 0.0, 1.0, 0.0);
         glClearDepth(1.0);
-        glDepthMask(GL_TRUE);
+        glstate_depthMask(GL_TRUE);
         glDepthFunc(GL_LESS);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -481,9 +661,9 @@ void windowlist_updateBlur(session_t* ps) {
         windowlist_draw(ps, &opaque_behind);
 
         // Draw root
-        glEnable(GL_DEPTH_TEST);
+        glstate_enable(GL_DEPTH_TEST);
         draw_tex(face, &ps->root_texture.texture, &(Vector3){{0, 0, 0.99999}}, &ps->root_size);
-        glDisable(GL_DEPTH_TEST);
+        glstate_disable(GL_DEPTH_TEST);
 
         windowlist_drawTransparent(ps, &transparent_behind);
 
@@ -492,46 +672,52 @@ void windowlist_updateBlur(session_t* ps) {
 
         view = old_view;
 
-        glDisable(GL_BLEND);
+        glstate_disable(GL_BLEND);
 
         int level = ps->o.blur_level;
 
         struct TextureBlurData blurData = {
-            .depth = &blur->stencil,
-            .tex = tex,
-            .swap = &blur->texture[0],
+            .fbo = &target->fbo,
+            .depth = &target->stencil,
+            .tex = &target->texture,
+            .swap = &blur->texture,
         };
         // Do the blur
-        if(!texture_blur(&blurData, &cache->fbo, level, false)) {
+        if(!texture_blur(&blurData, level, false)) {
             printf_errf("Failed blurring the background texture\n");
+            rendertargetpool_release(pool, target);
             return;
         }
 
-        // Flip the blur back into texture[0] to clip to the stencil
-        framebuffer_resetTarget(&cache->fbo);
-        framebuffer_targetTexture(&cache->fbo, &blur->texture[0]);
-        if(framebuffer_rebind(&cache->fbo) != 0) {
+        // Flip the blur back into the cache to clip to the stencil
+        framebuffer_resetTarget(&target->fbo);
+        framebuffer_targetTexture(&target->fbo, &blur->texture);
+        framebuffer_targetRenderBuffer_stencil(&target->fbo, &target->stencil);
+        if(framebuffer_rebind(&target->fbo) != 0) {
             printf("Failed binding framebuffer to clip blur\n");
+            rendertargetpool_release(pool, target);
             return;
         }
 
         old_view = view;
-        view = mat4_orthogonal(0, blur->texture[0].size.x, 0, blur->texture[0].size.y, -1, 1);
-        glViewport(0, 0, blur->texture[0].size.x, blur->texture[0].size.y);
+        view = mat4_orthogonal(0, blur->texture.size.x, 0, blur->texture.size.y, -1, 1);
+        glViewport(0, 0, blur->texture.size.x, blur->texture.size.y);
 
         glClearColor(0.0, 0.0, 0.0, 0.0);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        /* glEnable(GL_STENCIL_TEST); */
+        /* glstate_enable(GL_STENCIL_TEST); */
 
         glStencilMask(0);
         glStencilFunc(GL_EQUAL, 1, 0xFF);
 
-        draw_tex(face, &blur->texture[1], &VEC3_ZERO, &blur->texture[0].size);
+        draw_tex(face, &target->texture, &VEC3_ZERO, &blur->texture.size);
 
-        /* glDisable(GL_STENCIL_TEST); */
+        /* glstate_disable(GL_STENCIL_TEST); */
         view = old_view;
 
+        rendertargetpool_release(pool, target);
+
         w_id = vector_getPrev(&to_blur, &index);
     }
 
@@ -560,7 +746,7 @@ void windowlist_drawDebug(Swiss* em, session_t* ps) {
 
     zone_enter(&ZONE_paint_debugFaders);
     {
-        struct face* face = assets_load("window.face");
+        struct face* face = asset_handles.window_face;
         for_components(it, em,
                 COMPONENT_DEBUGGED, COMPONENT_FADES_OPACITY, COMPONENT_OPACITY, CQ_END) {
             struct DebuggedComponent* debug = swiss_getComponent(em, COMPONENT_DEBUGGED, it.id);
@@ -620,7 +806,7 @@ void windowlist_drawDebug(Swiss* em, session_t* ps) {
 
     // Dim {{{
     {
-        struct face* face = assets_load("window.face");
+        struct face* face = asset_handles.window_face;
         for_components(it, em,
                 COMPONENT_DEBUGGED, COMPONENT_FADES_DIM, COMPONENT_DIM, CQ_END) {
             struct DebuggedComponent* debug = swiss_getComponent(em, COMPONENT_DEBUGGED, it.id);
@@ -743,7 +929,20 @@ void windowlist_drawDebug(Swiss* em, session_t* ps) {
         struct DebuggedComponent* debug = swiss_getComponent(em, COMPONENT_DEBUGGED, it.id);
         struct glx_blur_cache* blur = swiss_getComponent(em, COMPONENT_BLUR, it.id);
 
-        snprintf(buffer, 128, "Blur Size : %fx%f", blur->texture[0].size.x, blur->texture[0].size.y);
+        snprintf(buffer, 128, "Blur Size : %fx%f", blur->texture.size.x, blur->texture.size.y);
+
+        Vector2 size = {{0}};
+        text_size(&debug_font, buffer, &scale, &size);
+        debug->pen.y -= size.y;
+
+        text_draw(&debug_font, buffer, &debug->pen, &scale);
+    }
+
+    for_components(it, em,
+            COMPONENT_DEBUGGED, CQ_END) {
+        struct DebuggedComponent* debug = swiss_getComponent(em, COMPONENT_DEBUGGED, it.id);
+
+        snprintf(buffer, 128, "GPU Memory : %zu KiB", gpumem_windowBytes(em, it.id) / 1024);
 
         Vector2 size = {{0}};
         text_size(&debug_font, buffer, &scale, &size);
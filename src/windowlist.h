@@ -7,9 +7,11 @@ Vector2 X11_rectpos_to_gl(session_t *ps, const Vector2* xpos, const Vector2* siz
 
 void windowlist_drawBackground(session_t* ps, Vector* opaque);
 void windowlist_drawTransparent(session_t* ps, Vector* transparent);
-void windowlist_drawTint(session_t* ps);
 void windowlist_draw(session_t* ps, Vector* order);
 void windowlist_updateStencil(session_t* ps, Vector* paints);
 void windowlist_updateBlur(session_t* ps);
+void windowlist_updateOcclusion(session_t* ps);
+// Fill pieces with the parts of the rect not covered by any of the occluders
+void visible_pieces(Vector* pieces, const struct Rect* rect, const Vector* occluders);
 
 void windowlist_drawDebug(Swiss* em, session_t* ps);
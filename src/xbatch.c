@@ -0,0 +1,405 @@
+#include "xbatch.h"
+
+#include <X11/Xutil.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logging.h"
+
+#define XBATCH_PROP_SLOTS_INITIAL (128)
+
+static size_t prop_hash(const struct XBatch* batch, Window wid, Atom atom, long offset, long length) {
+    // Fibonacci hashing, like the swiss index. Window ids are mostly
+    // sequential, and a window is usually asked for many atoms.
+    uint64_t hash = (uint64_t)wid * 0x9E3779B97F4A7C15ULL;
+    hash ^= (uint64_t)atom + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    hash ^= (uint64_t)offset + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    hash ^= (uint64_t)length + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    hash *= 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 32;
+    return hash & (batch->propCapacity - 1);
+}
+
+static void prop_allocateSlots(struct XBatch* batch, size_t capacity) {
+    // The capacity must be a power of two for the hash mask to work
+    assert((capacity & (capacity - 1)) == 0);
+
+    free(batch->propSlots);
+    batch->propSlots = malloc(capacity * sizeof(size_t));
+    assert(batch->propSlots != NULL);
+    batch->propCapacity = capacity;
+
+    for(size_t i = 0; i < capacity; i++) {
+        batch->propSlots[i] = XBATCH_NONE;
+    }
+}
+
+static void prop_insertSlot(struct XBatch* batch, size_t request) {
+    const struct XBatchProp* req = vector_get(&batch->props, request);
+
+    size_t mask = batch->propCapacity - 1;
+    size_t slot = prop_hash(batch, req->wid, req->atom, req->offset, req->length);
+    while(batch->propSlots[slot] != XBATCH_NONE) {
+        slot = (slot + 1) & mask;
+    }
+    batch->propSlots[slot] = request;
+}
+
+// Keep the load below 50% so the probe chains stay short
+static void prop_reserveSlot(struct XBatch* batch) {
+    if((vector_size(&batch->props) + 1) * 2 <= batch->propCapacity)
+        return;
+
+    prop_allocateSlots(batch, batch->propCapacity * 2);
+    for(size_t i = 0; i < vector_size(&batch->props); i++) {
+        prop_insertSlot(batch, i);
+    }
+}
+
+void xbatch_init(struct XBatch* batch, struct X11Context* context) {
+    assert(batch != NULL);
+    assert(context != NULL);
+
+    batch->context = context;
+    vector_init(&batch->props, sizeof(struct XBatchProp), 64);
+    batch->propSlots = NULL;
+    batch->propCapacity = 0;
+    prop_allocateSlots(batch, XBATCH_PROP_SLOTS_INITIAL);
+    vector_init(&batch->geometries, sizeof(struct XBatchGeometry), 16);
+    vector_init(&batch->shapes, sizeof(struct XBatchShape), 16);
+    vector_init(&batch->damages, sizeof(struct XBatchDamage), 16);
+    vector_init(&batch->translations, sizeof(struct XBatchTranslate), 16);
+}
+
+void xbatch_delete(struct XBatch* batch) {
+    xbatch_clear(batch);
+    vector_kill(&batch->props);
+    vector_kill(&batch->geometries);
+    vector_kill(&batch->shapes);
+    vector_kill(&batch->damages);
+    vector_kill(&batch->translations);
+    free(batch->propSlots);
+    batch->propSlots = NULL;
+    batch->propCapacity = 0;
+}
+
+size_t xbatch_findProp(const struct XBatch* batch, Window wid, Atom atom, long offset, long length, Atom rtype, int rformat) {
+    size_t mask = batch->propCapacity - 1;
+    size_t slot = prop_hash(batch, wid, atom, offset, length);
+    while(batch->propSlots[slot] != XBATCH_NONE) {
+        const struct XBatchProp* req = vector_get(&batch->props, batch->propSlots[slot]);
+        if(req->wid == wid && req->atom == atom && req->offset == offset
+                && req->length == length && req->rtype == rtype
+                && req->rformat == rformat) {
+            return batch->propSlots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return XBATCH_NONE;
+}
+
+size_t xbatch_prop(struct XBatch* batch, Window wid, Atom atom, long offset, long length, Atom rtype, int rformat) {
+    size_t existing = xbatch_findProp(batch, wid, atom, offset, length, rtype, rformat);
+    if(existing != XBATCH_NONE)
+        return existing;
+
+    prop_reserveSlot(batch);
+
+    struct XBatchProp* req = vector_reserve(&batch->props, 1);
+    req->wid = wid;
+    req->atom = atom;
+    req->offset = offset;
+    req->length = length;
+    req->rtype = rtype;
+    req->rformat = rformat;
+    req->collected = false;
+    req->prop = (winprop_t) {
+        .data.p8 = NULL,
+        .nitems = 0,
+        .type = AnyPropertyType,
+        .format = 0,
+    };
+
+    req->cookie = xcb_get_property(batch->context->connection, false, wid, atom,
+            rtype, offset, length);
+
+    size_t request = vector_size(&batch->props) - 1;
+    prop_insertSlot(batch, request);
+    return request;
+}
+
+size_t xbatch_geometry(struct XBatch* batch, Window wid) {
+    struct XBatchGeometry* req = vector_reserve(&batch->geometries, 1);
+    req->wid = wid;
+    req->collected = false;
+    req->reply = NULL;
+    req->cookie = xcb_get_geometry(batch->context->connection, wid);
+
+    return vector_size(&batch->geometries) - 1;
+}
+
+size_t xbatch_shapeRects(struct XBatch* batch, Window wid, xcb_shape_kind_t kind) {
+    struct XBatchShape* req = vector_reserve(&batch->shapes, 1);
+    req->wid = wid;
+    req->kind = kind;
+    req->collected = false;
+    req->reply = NULL;
+    req->cookie = xcb_shape_get_rectangles(batch->context->connection, wid, kind);
+
+    return vector_size(&batch->shapes) - 1;
+}
+
+size_t xbatch_damageRects(struct XBatch* batch, xcb_damage_damage_t damage) {
+    xcb_connection_t* connection = batch->context->connection;
+
+    struct XBatchDamage* req = vector_reserve(&batch->damages, 1);
+    req->damage = damage;
+    req->collected = false;
+    req->reply = NULL;
+
+    // The server handles the requests in order, so the region can be
+    // destroyed right after asking for its contents
+    xcb_xfixes_region_t region = xcb_generate_id(connection);
+    xcb_xfixes_create_region(connection, region, 0, NULL);
+    xcb_damage_subtract(connection, damage, XCB_NONE, region);
+    req->cookie = xcb_xfixes_fetch_region(connection, region);
+    xcb_xfixes_destroy_region(connection, region);
+
+    return vector_size(&batch->damages) - 1;
+}
+
+size_t xbatch_translate(struct XBatch* batch, Window src, Window dst) {
+    struct XBatchTranslate* req = vector_reserve(&batch->translations, 1);
+    req->src = src;
+    req->dst = dst;
+    req->collected = false;
+    req->reply = NULL;
+    req->cookie = xcb_translate_coordinates(batch->context->connection, src, dst, 0, 0);
+
+    return vector_size(&batch->translations) - 1;
+}
+
+void xbatch_flush(struct XBatch* batch) {
+    xcb_flush(batch->context->connection);
+}
+
+// Convert the reply to the layout Xlib would have given us, which is what
+// the rest of the code expects. Notably format 32 data is an array of longs.
+static void convert_reply(struct XBatchProp* req, xcb_get_property_reply_t* reply) {
+    if(reply->value_len == 0)
+        return;
+
+    if(req->rtype != AnyPropertyType && reply->type != req->rtype)
+        return;
+
+    if(req->rformat != 0 && reply->format != req->rformat)
+        return;
+
+    size_t nitems = reply->value_len;
+    void* value = xcb_get_property_value(reply);
+    switch(reply->format) {
+        case 8:
+            // Xlib always null terminates the data
+            req->prop.data.p8 = malloc(nitems + 1);
+            memcpy(req->prop.data.p8, value, nitems);
+            req->prop.data.p8[nitems] = '\0';
+            break;
+        case 16:
+            req->prop.data.p16 = malloc(nitems * sizeof(short));
+            memcpy(req->prop.data.p16, value, nitems * sizeof(short));
+            break;
+        case 32:
+            req->prop.data.p32 = malloc(nitems * sizeof(long));
+            for(size_t i = 0; i < nitems; i++) {
+                req->prop.data.p32[i] = ((uint32_t*)value)[i];
+            }
+            break;
+        default:
+            return;
+    }
+
+    req->prop.nitems = nitems;
+    req->prop.type = reply->type;
+    req->prop.format = reply->format;
+}
+
+const winprop_t* xbatch_propReply(struct XBatch* batch, size_t request) {
+    struct XBatchProp* req = vector_get(&batch->props, request);
+    assert(req != NULL);
+
+    if(req->collected)
+        return &req->prop;
+
+    xcb_generic_error_t* error = NULL;
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(batch->context->connection,
+            req->cookie, &error);
+    req->collected = true;
+
+    // Windows can disappear before we get to them, that's not an error worth
+    // reporting
+    free(error);
+
+    if(reply == NULL)
+        return &req->prop;
+
+    convert_reply(req, reply);
+    free(reply);
+
+    return &req->prop;
+}
+
+const xcb_get_geometry_reply_t* xbatch_geometryReply(struct XBatch* batch, size_t request) {
+    struct XBatchGeometry* req = vector_get(&batch->geometries, request);
+    assert(req != NULL);
+
+    if(req->collected)
+        return req->reply;
+
+    xcb_generic_error_t* error = NULL;
+    req->reply = xcb_get_geometry_reply(batch->context->connection, req->cookie, &error);
+    req->collected = true;
+    free(error);
+
+    return req->reply;
+}
+
+const xcb_rectangle_t* xbatch_shapeRectsReply(struct XBatch* batch, size_t request, size_t* count) {
+    struct XBatchShape* req = vector_get(&batch->shapes, request);
+    assert(req != NULL);
+
+    if(!req->collected) {
+        xcb_generic_error_t* error = NULL;
+        req->reply = xcb_shape_get_rectangles_reply(batch->context->connection, req->cookie, &error);
+        req->collected = true;
+        free(error);
+    }
+
+    if(req->reply == NULL) {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = xcb_shape_get_rectangles_rectangles_length(req->reply);
+    return xcb_shape_get_rectangles_rectangles(req->reply);
+}
+
+const xcb_rectangle_t* xbatch_damageRectsReply(struct XBatch* batch, size_t request, size_t* count) {
+    struct XBatchDamage* req = vector_get(&batch->damages, request);
+    assert(req != NULL);
+
+    if(!req->collected) {
+        xcb_generic_error_t* error = NULL;
+        req->reply = xcb_xfixes_fetch_region_reply(batch->context->connection, req->cookie, &error);
+        req->collected = true;
+        free(error);
+    }
+
+    if(req->reply == NULL) {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = xcb_xfixes_fetch_region_rectangles_length(req->reply);
+    return xcb_xfixes_fetch_region_rectangles(req->reply);
+}
+
+bool xbatch_translateReply(struct XBatch* batch, size_t request, int* x, int* y) {
+    struct XBatchTranslate* req = vector_get(&batch->translations, request);
+    assert(req != NULL);
+
+    if(!req->collected) {
+        xcb_generic_error_t* error = NULL;
+        req->reply = xcb_translate_coordinates_reply(batch->context->connection, req->cookie, &error);
+        req->collected = true;
+        free(error);
+    }
+
+    if(req->reply == NULL || !req->reply->same_screen)
+        return false;
+
+    *x = req->reply->dst_x;
+    *y = req->reply->dst_y;
+    return true;
+}
+
+bool xbatch_textReply(struct XBatch* batch, size_t request, char*** pstrlst, int* pnstr) {
+    const winprop_t* prop = xbatch_propReply(batch, request);
+    if(prop->nitems == 0)
+        return false;
+
+    XTextProperty text_prop = {
+        .value = prop->data.p8,
+        .encoding = prop->type,
+        .format = prop->format,
+        .nitems = prop->nitems,
+    };
+
+    if(Success != XmbTextPropertyToTextList(batch->context->display, &text_prop, pstrlst, pnstr)
+            || !*pnstr) {
+        *pnstr = 0;
+        if(*pstrlst)
+            XFreeStringList(*pstrlst);
+        *pstrlst = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void xbatch_clear(struct XBatch* batch) {
+    size_t index;
+    struct XBatchProp* req = vector_getFirst(&batch->props, &index);
+    while(req != NULL) {
+        if(!req->collected) {
+            xcb_discard_reply(batch->context->connection, req->cookie.sequence);
+        }
+        free(req->prop.data.p8);
+        req = vector_getNext(&batch->props, &index);
+    }
+    vector_clear(&batch->props);
+    for(size_t i = 0; i < batch->propCapacity; i++) {
+        batch->propSlots[i] = XBATCH_NONE;
+    }
+
+    struct XBatchGeometry* geometry = vector_getFirst(&batch->geometries, &index);
+    while(geometry != NULL) {
+        if(!geometry->collected) {
+            xcb_discard_reply(batch->context->connection, geometry->cookie.sequence);
+        }
+        free(geometry->reply);
+        geometry = vector_getNext(&batch->geometries, &index);
+    }
+    vector_clear(&batch->geometries);
+
+    struct XBatchShape* shape = vector_getFirst(&batch->shapes, &index);
+    while(shape != NULL) {
+        if(!shape->collected) {
+            xcb_discard_reply(batch->context->connection, shape->cookie.sequence);
+        }
+        free(shape->reply);
+        shape = vector_getNext(&batch->shapes, &index);
+    }
+    vector_clear(&batch->shapes);
+
+    struct XBatchDamage* damage = vector_getFirst(&batch->damages, &index);
+    while(damage != NULL) {
+        if(!damage->collected) {
+            xcb_discard_reply(batch->context->connection, damage->cookie.sequence);
+        }
+        free(damage->reply);
+        damage = vector_getNext(&batch->damages, &index);
+    }
+    vector_clear(&batch->damages);
+
+    struct XBatchTranslate* translation = vector_getFirst(&batch->translations, &index);
+    while(translation != NULL) {
+        if(!translation->collected) {
+            xcb_discard_reply(batch->context->connection, translation->cookie.sequence);
+        }
+        free(translation->reply);
+        translation = vector_getNext(&batch->translations, &index);
+    }
+    vector_clear(&batch->translations);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "xorg.h"
+#include "winprop.h"
+#include "vector.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/shape.h>
+#include <xcb/xfixes.h>
+#include <xcb/damage.h>
+
+// Xlib blocks on the reply of every request, so fetching a property for N
+// windows costs N round trips to the server. The batch issues the requests
+// through XCB instead, and only collects the replies once a system actually
+// needs them. If everything is issued before the first reply is read, we
+// only pay for a single round trip.
+//
+// Requests are referred to by the handle returned when issuing them, which
+// can be stored in a component until the consuming system runs. The replies
+// are owned by the batch, and freed when it's cleared.
+
+#define XBATCH_NONE ((size_t)-1)
+
+// Length to pass when the whole property should be fetched
+#define XBATCH_PROP_ALL (0x1fffffffL)
+
+struct XBatchProp {
+    Window wid;
+    Atom atom;
+    long offset;
+    long length;
+    Atom rtype;
+    int rformat;
+
+    xcb_get_property_cookie_t cookie;
+    bool collected;
+    winprop_t prop;
+};
+
+struct XBatchGeometry {
+    Window wid;
+
+    xcb_get_geometry_cookie_t cookie;
+    bool collected;
+    xcb_get_geometry_reply_t* reply;
+};
+
+struct XBatchShape {
+    Window wid;
+    xcb_shape_kind_t kind;
+
+    xcb_shape_get_rectangles_cookie_t cookie;
+    bool collected;
+    xcb_shape_get_rectangles_reply_t* reply;
+};
+
+struct XBatchDamage {
+    xcb_damage_damage_t damage;
+
+    xcb_xfixes_fetch_region_cookie_t cookie;
+    bool collected;
+    xcb_xfixes_fetch_region_reply_t* reply;
+};
+
+struct XBatchTranslate {
+    Window src;
+    Window dst;
+
+    xcb_translate_coordinates_cookie_t cookie;
+    bool collected;
+    xcb_translate_coordinates_reply_t* reply;
+};
+
+struct XBatch {
+    struct X11Context* context;
+    Vector props;
+    // Open addressing table from a property request to its index in props,
+    // so identical requests can be found without scanning them all. Empty
+    // slots are XBATCH_NONE.
+    size_t* propSlots;
+    size_t propCapacity;
+    Vector geometries;
+    Vector shapes;
+    Vector damages;
+    Vector translations;
+};
+
+void xbatch_init(struct XBatch* batch, struct X11Context* context);
+void xbatch_delete(struct XBatch* batch);
+
+// Identical requests issued in the same batch share the reply
+size_t xbatch_prop(struct XBatch* batch, Window wid, Atom atom, long offset, long length, Atom rtype, int rformat);
+size_t xbatch_findProp(const struct XBatch* batch, Window wid, Atom atom, long offset, long length, Atom rtype, int rformat);
+
+size_t xbatch_geometry(struct XBatch* batch, Window wid);
+// Fetch the rectangles making up a shape of the window. Unshaped windows
+// report their default shape.
+size_t xbatch_shapeRects(struct XBatch* batch, Window wid, xcb_shape_kind_t kind);
+// Take the damage accumulated in a damage object. This empties it, so the
+// server will report new damage again.
+size_t xbatch_damageRects(struct XBatch* batch, xcb_damage_damage_t damage);
+// Find where the origin of src is inside dst
+size_t xbatch_translate(struct XBatch* batch, Window src, Window dst);
+
+// Make sure everything issued has been sent to the server
+void xbatch_flush(struct XBatch* batch);
+
+// Blocks until the reply is available. The property is blank if the
+// request failed or the returned type and format don't match.
+const winprop_t* xbatch_propReply(struct XBatch* batch, size_t request);
+// Same as above, but converted to a string list like XGetTextProperty. The
+// list must be freed with XFreeStringList.
+bool xbatch_textReply(struct XBatch* batch, size_t request, char*** pstrlst, int* pnstr);
+
+// Blocks until the reply is available. NULL if the request failed.
+const xcb_get_geometry_reply_t* xbatch_geometryReply(struct XBatch* batch, size_t request);
+// Blocks until the reply is available. Returns NULL and a count of 0 if the
+// request failed. The rectangles are relative to the window origin,
+// excluding the border.
+const xcb_rectangle_t* xbatch_shapeRectsReply(struct XBatch* batch, size_t request, size_t* count);
+// Blocks until the reply is available. Returns NULL and a count of 0 if the
+// request failed. The rectangles are relative to the drawable origin.
+const xcb_rectangle_t* xbatch_damageRectsReply(struct XBatch* batch, size_t request, size_t* count);
+// Blocks until the reply is available. Returns false if the request failed
+// or the windows are on different screens.
+bool xbatch_translateReply(struct XBatch* batch, size_t request, int* x, int* y);
+
+// Drop all requests, discarding any replies that haven't been read
+void xbatch_clear(struct XBatch* batch);
@@ -3,11 +3,126 @@
 #include "assert.h"
 #include "logging.h"
 
+#include <stdlib.h>
+
+static bool find_texture_format(struct X11Context* context, GLXFBConfig fbconfig,
+        int depth, glx_fbconfig_t* config) {
+    int value;
+
+    // We don't want to use anything multisampled
+    glXGetFBConfigAttrib(context->display, fbconfig, GLX_SAMPLES, &value);
+    if (value >= 2) {
+        return false;
+    }
+
+    // We need to support pixmaps
+    glXGetFBConfigAttrib(context->display, fbconfig, GLX_DRAWABLE_TYPE, &value);
+    if (!(value & GLX_PIXMAP_BIT)) {
+        return false;
+    }
+
+    // We need to be able to bind pixmaps to textures
+    glXGetFBConfigAttrib(context->display, fbconfig,
+            GLX_BIND_TO_TEXTURE_TARGETS_EXT,
+            &value);
+    if (!(value & GLX_TEXTURE_2D_BIT_EXT)) {
+        return false;
+    }
+    config->texture_tgts = value;
+
+    // We want RGBA textures
+    glXGetFBConfigAttrib(context->display, fbconfig,
+            GLX_BIND_TO_TEXTURE_RGBA_EXT, &value);
+    if (value == false) {
+        return false;
+    }
+    config->texture_fmt = GLX_TEXTURE_FORMAT_RGBA_EXT;
+
+    int configDepth;
+    int configAlpha;
+    if (Success != glXGetFBConfigAttrib(context->display, fbconfig, GLX_BUFFER_SIZE, &configDepth)
+            || Success != glXGetFBConfigAttrib(context->display, fbconfig, GLX_ALPHA_SIZE, &configAlpha)) {
+        printf_errf("Failed getting depth and alpha depth for fbconfig");
+        configDepth = depth;
+        configAlpha = 0;
+    }
+
+    if (Success == glXGetFBConfigAttrib(context->display, fbconfig, GLX_BIND_TO_TEXTURE_RGB_EXT, &value)
+            && value == true) {
+        // If theres no alpha data, we might as well bind to RGB only
+        if(configAlpha == 0) {
+            config->texture_fmt = GLX_TEXTURE_FORMAT_RGB_EXT;
+        }
+        // @QUESTIONABLE: This is what compton does, and it fixes some
+        // strange transparency jankyness with MPV, but I don't really
+        // understand why it's required - Delusional 02/04-2018
+
+        // If the depth requested matches the depth we get without
+        // alpha data, then we just use RGB
+        if(depth == configDepth - configAlpha) {
+            config->texture_fmt = GLX_TEXTURE_FORMAT_RGB_EXT;
+        }
+    }
+
+    //If the context says textures pixmaps are inverted, then we need to tell
+    //the texture
+    glXGetFBConfigAttrib(context->display, fbconfig, GLX_Y_INVERTED_EXT, &value);
+    config->y_inverted = value;
+
+    config->cfg = fbconfig;
+    return true;
+}
+
+static int visual_cmp(const void* a, const void* b);
+
+// Pick a config for every visual up front, so we don't have to walk all the
+// configs whenever we bind a window.
+static bool build_visual_configs(struct X11Context* context) {
+    context->visualConfigs = malloc(sizeof(glx_fbconfig_t) * context->numConfigs);
+    if(context->visualConfigs == NULL && context->numConfigs != 0)
+        return false;
+    context->numVisualConfigs = 0;
+
+    for(int i = 0; i < context->numConfigs; i++) {
+        GLXFBConfig fbconfig = context->configs[i];
+        XVisualInfo* visinfo = glXGetVisualFromFBConfig(context->display, fbconfig);
+        if (!visinfo) {
+            continue;
+        }
+
+        VisualID visual = visinfo->visualid;
+        int depth = visinfo->depth;
+        XFree(visinfo);
+
+        // The first config we like for a visual wins
+        bool taken = false;
+        for(size_t j = 0; j < context->numVisualConfigs; j++) {
+            if(context->visualConfigs[j].visual == visual) {
+                taken = true;
+                break;
+            }
+        }
+        if(taken)
+            continue;
+
+        glx_fbconfig_t* config = &context->visualConfigs[context->numVisualConfigs];
+        if(!find_texture_format(context, fbconfig, depth, config))
+            continue;
+        config->visual = visual;
+        context->numVisualConfigs++;
+    }
+
+    qsort(context->visualConfigs, context->numVisualConfigs,
+            sizeof(glx_fbconfig_t), visual_cmp);
+    return true;
+}
+
 bool xorgContext_init(struct X11Context* context, Display* display, int screen) {
     assert(context != NULL);
     assert(display != NULL);
 
     context->display = display;
+    context->connection = XGetXCBConnection(display);
     context->screen = screen;
 
     context->configs = glXGetFBConfigs(display, screen, &context->numConfigs);
@@ -16,6 +131,13 @@ bool xorgContext_init(struct X11Context* context, Display* display, int screen)
         return false;
     }
 
+    if(!build_visual_configs(context)) {
+        printf_errf("Failed building the visual to fbconfig table");
+        return false;
+    }
+
+    vector_init(&context->fencePool, sizeof(struct XFence), 16);
+
     return true;
 }
 
@@ -145,56 +267,83 @@ enum X11Protocol xorgContext_convertOpcode(const struct X11Capabilities* caps, i
     return PROTO_COUNT;
 }
 
-GLXFBConfig* xorgContext_selectConfig(struct X11Context* context, VisualID visualid) {
+static int visual_cmp(const void* a, const void* b) {
+    const glx_fbconfig_t* ca = a;
+    const glx_fbconfig_t* cb = b;
+    if(ca->visual < cb->visual)
+        return -1;
+    if(ca->visual > cb->visual)
+        return 1;
+    return 0;
+}
+
+const glx_fbconfig_t* xorgContext_selectConfig(struct X11Context* context, VisualID visualid) {
     assert(visualid != 0);
 
-	GLXFBConfig* selected = NULL;
+    glx_fbconfig_t key = {.visual = visualid};
+    return bsearch(&key, context->visualConfigs, context->numVisualConfigs,
+            sizeof(glx_fbconfig_t), visual_cmp);
+}
 
-    int value;
-    for(int i = 0; i < context->numConfigs; i++) {
-        GLXFBConfig fbconfig = context->configs[i];
-        XVisualInfo* visinfo = glXGetVisualFromFBConfig(context->display, fbconfig);
-        if (!visinfo || visinfo->visualid != visualid) {
-            continue;
-        }
+bool xorgContext_acquireFence(struct X11Context* context, struct XFence* fence) {
+    assert(fence != NULL);
 
-        // We don't want to use anything multisampled
-        glXGetFBConfigAttrib(context->display, fbconfig, GLX_SAMPLES, &value);
-        if (value >= 2) {
-            continue;
-        }
+    size_t last;
+    struct XFence* pooled = vector_getLast(&context->fencePool, &last);
+    if(pooled != NULL) {
+        *fence = *pooled;
+        vector_remove(&context->fencePool, last);
+        return true;
+    }
 
-        // We need to support pixmaps
-        glXGetFBConfigAttrib(context->display, fbconfig, GLX_DRAWABLE_TYPE, &value);
-        if (!(value & GLX_PIXMAP_BIT)) {
-            continue;
-        }
+    fence->id = XSyncCreateFence(context->display,
+            RootWindow(context->display, context->screen), false);
+    fence->triggered = false;
+    if(fence->id == None) {
+        printf_errf("Failed creating fence");
+        return false;
+    }
+    return true;
+}
 
-        // We need to be able to bind pixmaps to textures
-        glXGetFBConfigAttrib(context->display, fbconfig,
-                GLX_BIND_TO_TEXTURE_TARGETS_EXT,
-                &value);
-        if (!(value & GLX_TEXTURE_2D_BIT_EXT)) {
-            continue;
-        }
+void xorgContext_releaseFence(struct X11Context* context, struct XFence* fence) {
+    assert(fence != NULL);
+    if(fence->id == None)
+        return;
 
-        // We want RGBA textures
-        glXGetFBConfigAttrib(context->display, fbconfig,
-                GLX_BIND_TO_TEXTURE_RGBA_EXT, &value);
-        if (value == false) {
-            continue;
-        }
+    vector_putBack(&context->fencePool, fence);
+    fence->id = None;
+    fence->triggered = false;
+}
 
-        selected = &context->configs[i];
-        break;
-    }
-    // If we ran out of fbconfigs before we found something we like.
-    if(selected == NULL)
-        return NULL;
+void xorgContext_triggerFence(struct X11Context* context, struct XFence* fence) {
+    assert(fence != NULL);
+    assert(fence->id != None);
 
-    return selected;
+    if(fence->triggered)
+        XSyncResetFence(context->display, fence->id);
+    XSyncTriggerFence(context->display, fence->id);
+    fence->triggered = true;
 }
 
 void xorgContext_delete(struct X11Context* context) {
     assert(context->display != NULL);
+    free(context->visualConfigs);
+    context->visualConfigs = NULL;
+    context->numVisualConfigs = 0;
+    XFree(context->configs);
+    context->configs = NULL;
+    context->numConfigs = 0;
+
+    // A killed pool has no element size, there's nothing left to destroy
+    if(context->fencePool.elementSize != 0) {
+        size_t index;
+        struct XFence* fence = vector_getFirst(&context->fencePool, &index);
+        while(fence != NULL) {
+            XSyncDestroyFence(context->display, fence->id);
+            fence = vector_getNext(&context->fencePool, &index);
+        }
+        vector_kill(&context->fencePool);
+    }
+    context->fencePool = (Vector){0};
 }
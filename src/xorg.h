@@ -15,6 +15,9 @@
 #include <X11/extensions/Xdbe.h>
 #include <X11/extensions/Xinerama.h>
 #include <X11/extensions/sync.h>
+#include <X11/Xlib-xcb.h>
+
+#include "vector.h"
 
 enum X11Protocol {
     PROTO_COMPOSITE,
@@ -45,12 +48,36 @@ struct X11Capabilities {
     enum XExtensionVersion version[PROTO_COUNT];
 };
 
+/// @brief Wrapper of a GLX FBConfig.
+typedef struct {
+  VisualID visual;
+  GLXFBConfig cfg;
+  GLint texture_fmt;
+  GLint texture_tgts;
+  bool y_inverted;
+} glx_fbconfig_t;
+
+// A fence the server triggers once it has finished all prior rendering.
+struct XFence {
+    XSyncFence id;
+    bool triggered;
+};
+
 struct X11Context {
     Display* display;
+    // The XCB connection underlying the display, for asynchronous requests
+    xcb_connection_t* connection;
     int screen;
 
     GLXFBConfig* configs;
     int numConfigs;
+
+    // The config to use for each visual, sorted by visual
+    glx_fbconfig_t* visualConfigs;
+    size_t numVisualConfigs;
+
+    // Fences that have been released, ready to be handed out again
+    Vector fencePool;
 };
 
 bool xorgContext_init(struct X11Context* context, Display* display, int screen);
@@ -62,6 +89,14 @@ int xorgContext_convertError(const struct X11Capabilities* caps, enum X11Protoco
 enum XExtensionVersion xorgContext_version(const struct X11Capabilities* caps, enum X11Protocol proto);
 enum X11Protocol xorgContext_convertOpcode(const struct X11Capabilities* caps, int opcode);
 
-GLXFBConfig* xorgContext_selectConfig(struct X11Context* context, VisualID visualid);
+const glx_fbconfig_t* xorgContext_selectConfig(struct X11Context* context, VisualID visualid);
+
+// Fences are recycled through a pool, so we don't have to create and
+// destroy one every time we need to synchronize with the server.
+bool xorgContext_acquireFence(struct X11Context* context, struct XFence* fence);
+void xorgContext_releaseFence(struct X11Context* context, struct XFence* fence);
+// Ask the server to trigger the fence once it's done with everything
+// requested so far. Resets the fence first if it has been triggered before.
+void xorgContext_triggerFence(struct X11Context* context, struct XFence* fence);
 
 void xorgContext_delete(struct X11Context* context);
@@ -9,6 +9,7 @@ bool xtexture_init(struct XTexture* tex, struct X11Context* context) {
     assert(context != NULL);
 
     tex->context = context;
+    tex->bound = false;
     tex->pixmap = 0;
     texture_init_nospace(&tex->texture, GL_TEXTURE_2D, NULL);
     return true;
@@ -22,16 +23,12 @@ void xtexture_delete(struct XTexture* tex) {
     texture_delete(&tex->texture);
 }
 
-bool xtexture_bind(struct XTexture* tex, GLXFBConfig* fbconfig, Pixmap pixmap) {
+bool xtexture_bind(struct XTexture* tex, const glx_fbconfig_t* fbconfig, Pixmap pixmap) {
     assert(tex != NULL);
     assert(!tex->bound);
     assert(fbconfig != NULL);
 
-    //If the context says textures pixmaps are inverted, then we need to tell
-    //the texture
-    int value;
-    glXGetFBConfigAttrib(tex->context->display, *fbconfig, GLX_Y_INVERTED_EXT, &value);
-    tex->texture.flipped = value;
+    tex->texture.flipped = fbconfig->y_inverted;
 
     tex->pixmap = pixmap;
 
@@ -50,59 +47,21 @@ bool xtexture_bind(struct XTexture* tex, GLXFBConfig* fbconfig, Pixmap pixmap) {
 
     Vector2 size = {{width, height}};
 
-    int configDepth;
-    int configAlpha;
-    if (Success != glXGetFBConfigAttrib(tex->context->display, *fbconfig, GLX_BUFFER_SIZE, &configDepth)
-            || Success != glXGetFBConfigAttrib(tex->context->display, *fbconfig, GLX_ALPHA_SIZE, &configAlpha)) {
-        printf_errf("Failed getting depth and alpha depth for %#010lx", tex->pixmap);
-        configDepth = depth;
-        configAlpha = 0;
-    }
-
-    int texFmt;
-    if (Success == glXGetFBConfigAttrib(tex->context->display, *fbconfig, GLX_BIND_TO_TEXTURE_RGBA_EXT, &value)) {
-        if(value == true) { // We can bind to RGBA
-            texFmt = GLX_TEXTURE_FORMAT_RGBA_EXT;
-        }
-    }
-
-    // @CLEANUP: This should probably be extracted out of here
-    if (Success == glXGetFBConfigAttrib(tex->context->display, *fbconfig, GLX_BIND_TO_TEXTURE_RGB_EXT, &value)) {
-        if(value == true) { // We can bind to RGB
-            // If we can only bind to RGB, then just do that
-            if(texFmt == 0) {
-                texFmt = GLX_TEXTURE_FORMAT_RGB_EXT;
-            } else {
-                // If theres no alpha data, we might as well bind to RGB only
-                if(configAlpha == 0) {
-                    texFmt = GLX_TEXTURE_FORMAT_RGB_EXT;
-                }
-                // @QUESTIONABLE: This is what compton does, and it fixes some
-                // strange transparency jankyness with MPV, but I don't really
-                // understand why it's required - Delusional 02/04-2018
-
-                // If the depth requested matches the depth we get without
-                // alpha data, then we just use RGB
-                if(depth == configDepth - configAlpha) {
-                    texFmt = GLX_TEXTURE_FORMAT_RGB_EXT;
-                }
-            }
-        }
-    }
-
     const int attrib[] = {
         GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
-        GLX_TEXTURE_FORMAT_EXT, texFmt,
+        GLX_TEXTURE_FORMAT_EXT, fbconfig->texture_fmt,
         None,
     };
     tex->glxPixmap = glXCreatePixmap(
             tex->context->display,
-            *fbconfig,
+            fbconfig->cfg,
             tex->pixmap,
             attrib
             );
 
+    // The pixmap is the storage, so it's always the exact size
     tex->texture.size = size;
+    tex->texture.storage = size;
 
     texture_bind(&tex->texture, GL_TEXTURE0);
     glXBindTexImageEXT(tex->context->display, tex->glxPixmap,
@@ -117,7 +76,7 @@ bool xtexture_unbind(struct XTexture* tex) {
     assert(tex->bound);
 
     texture_bind(&tex->texture, GL_TEXTURE0);
-    glXReleaseTexImageEXT(tex->context->display, tex->pixmap,
+    glXReleaseTexImageEXT(tex->context->display, tex->glxPixmap,
             GLX_FRONT_LEFT_EXT);
 
     glXDestroyPixmap(tex->context->display, tex->glxPixmap);
@@ -127,3 +86,16 @@ bool xtexture_unbind(struct XTexture* tex) {
     tex->bound = false;
     return true;
 }
+
+bool xtexture_refresh(struct XTexture* tex) {
+    assert(tex != NULL);
+    assert(tex->bound);
+
+    texture_bind(&tex->texture, GL_TEXTURE0);
+    glXReleaseTexImageEXT(tex->context->display, tex->glxPixmap,
+            GLX_FRONT_LEFT_EXT);
+    glXBindTexImageEXT(tex->context->display, tex->glxPixmap,
+            GLX_FRONT_LEFT_EXT, NULL);
+
+    return true;
+}
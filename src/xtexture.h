@@ -19,5 +19,9 @@ struct XTexture {
 bool xtexture_init(struct XTexture* tex, struct X11Context* context);
 void xtexture_delete(struct XTexture* tex);
 
-bool xtexture_bind(struct XTexture* tex, GLXFBConfig* fbconfig, Pixmap pixmap);
+// Takes ownership of the pixmap, and keeps it bound until unbound.
+bool xtexture_bind(struct XTexture* tex, const glx_fbconfig_t* fbconfig, Pixmap pixmap);
 bool xtexture_unbind(struct XTexture* tex);
+// Release and rebind the texture image of an already bound pixmap, picking up
+// whatever has been drawn to the pixmap since it was last bound.
+bool xtexture_refresh(struct XTexture* tex);
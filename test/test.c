@@ -3,6 +3,8 @@
 #include "vector.h"
 #include "compton.h"
 #include "assets/face.h"
+#include "screendamage.h"
+#include "windowlist.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -469,6 +471,47 @@ static struct TestResult swiss__say_there_isnt_a_component__checking_a_removed_c
     assertEq(has, false);
 }
 
+static struct TestResult swiss__find_the_entity__looking_up_an_indexed_key() {
+    Swiss swiss;
+    swiss_clearComponentSizes(&swiss);
+    swiss_setComponentSize(&swiss, COMPONENT_TRACKS_WINDOW, sizeof(uint64_t));
+    swiss_init(&swiss, 1);
+    swiss_enableIndex(&swiss, COMPONENT_TRACKS_WINDOW, sizeof(uint64_t));
+    for(uint64_t i = 0; i < 100; i++) {
+        win_id id = swiss_allocate(&swiss);
+        uint64_t* key = swiss_addComponent(&swiss, COMPONENT_TRACKS_WINDOW, id);
+        *key = 0x400000 + i;
+    }
+
+    struct SwissIndexIterator it = swiss_lookup(&swiss, COMPONENT_TRACKS_WINDOW, 0x400000 + 42);
+
+    assertEq(it.id, 42);
+}
+
+static struct TestResult swiss__not_find_the_entity__looking_up_a_removed_key() {
+    Swiss swiss;
+    swiss_clearComponentSizes(&swiss);
+    swiss_setComponentSize(&swiss, COMPONENT_TRACKS_WINDOW, sizeof(uint64_t));
+    swiss_init(&swiss, 1);
+    swiss_enableIndex(&swiss, COMPONENT_TRACKS_WINDOW, sizeof(uint64_t));
+    for(uint64_t i = 0; i < 100; i++) {
+        win_id id = swiss_allocate(&swiss);
+        uint64_t* key = swiss_addComponent(&swiss, COMPONENT_TRACKS_WINDOW, id);
+        *key = 0x400000 + i;
+    }
+    // Make sure the keys are hashed before we start removing
+    swiss_lookup(&swiss, COMPONENT_TRACKS_WINDOW, 0);
+    for(win_id id = 0; id < 100; id += 2) {
+        swiss_removeComponent(&swiss, COMPONENT_TRACKS_WINDOW, id);
+    }
+
+    struct SwissIndexIterator it = swiss_lookup(&swiss, COMPONENT_TRACKS_WINDOW, 0x400000 + 42);
+
+    // @CLEANUP: We can't assert on bools right now
+    uint64_t done = it.done;
+    assertEq(done, true);
+}
+
 static struct TestResult swiss__double_capacity__allocating_past_end() {
     Swiss swiss;
     swiss_clearComponentSizes(&swiss);
@@ -1014,6 +1057,405 @@ struct TestResult commit_unmap__not_crash__window_with_destroy_event_has_no_stat
     assertYes();
 }
 
+// Start with no damage in any of the history
+static void screendamage_clean(struct ScreenDamage* damage) {
+    screendamage_init(damage, &(Vector2){{100, 100}});
+    for(size_t i = 0; i < SCREENDAMAGE_HISTORY; i++) {
+        screendamage_next(damage);
+    }
+}
+
+static struct TestResult screendamage__damage_the_whole_screen__age_is_0() {
+    struct ScreenDamage damage;
+    screendamage_clean(&damage);
+    screendamage_add(&damage, &(Vector2){{10, 10}}, &(Vector2){{5, 5}});
+
+    Vector2 pos;
+    Vector2 size;
+    screendamage_region(&damage, 0, &pos, &size);
+
+    bool full = pos.x == 0 && pos.y == 0 && size.x == 100 && size.y == 100;
+    assertEq(full, true);
+}
+
+static struct TestResult screendamage__damage_the_whole_screen__age_is_older_than_history() {
+    struct ScreenDamage damage;
+    screendamage_clean(&damage);
+    screendamage_add(&damage, &(Vector2){{10, 10}}, &(Vector2){{5, 5}});
+
+    Vector2 pos;
+    Vector2 size;
+    screendamage_region(&damage, SCREENDAMAGE_HISTORY + 1, &pos, &size);
+
+    bool full = pos.x == 0 && pos.y == 0 && size.x == 100 && size.y == 100;
+    assertEq(full, true);
+}
+
+static struct TestResult screendamage__cover_both_boxes__adding_disjoint_boxes() {
+    struct ScreenDamage damage;
+    screendamage_clean(&damage);
+    screendamage_add(&damage, &(Vector2){{10, 10}}, &(Vector2){{5, 5}});
+    screendamage_add(&damage, &(Vector2){{50, 60}}, &(Vector2){{10, 10}});
+
+    Vector2 pos;
+    Vector2 size;
+    screendamage_region(&damage, 1, &pos, &size);
+
+    bool covered = pos.x == 10 && pos.y == 10 && size.x == 50 && size.y == 60;
+    assertEq(covered, true);
+}
+
+static struct TestResult screendamage__include_older_frames__age_is_2() {
+    struct ScreenDamage damage;
+    screendamage_clean(&damage);
+    screendamage_add(&damage, &(Vector2){{10, 10}}, &(Vector2){{5, 5}});
+    screendamage_next(&damage);
+    screendamage_add(&damage, &(Vector2){{50, 60}}, &(Vector2){{10, 10}});
+
+    Vector2 pos;
+    Vector2 size;
+    screendamage_region(&damage, 2, &pos, &size);
+
+    bool covered = pos.x == 10 && pos.y == 10 && size.x == 50 && size.y == 60;
+    assertEq(covered, true);
+}
+
+static struct TestResult screendamage__be_empty__presented() {
+    struct ScreenDamage damage;
+    screendamage_clean(&damage);
+    screendamage_add(&damage, &(Vector2){{10, 10}}, &(Vector2){{5, 5}});
+
+    screendamage_next(&damage);
+
+    assertEq(screendamage_empty(&damage), true);
+}
+
+static struct TestResult screendamage__not_be_empty__damaged() {
+    struct ScreenDamage damage;
+    screendamage_clean(&damage);
+
+    screendamage_add(&damage, &(Vector2){{10, 10}}, &(Vector2){{5, 5}});
+
+    assertEq(screendamage_empty(&damage), false);
+}
+
+static void make_rects(Vector* rects, const struct Rect* list, size_t count) {
+    vector_init(rects, sizeof(struct Rect), count + 1);
+    for(size_t i = 0; i < count; i++) {
+        vector_putBack(rects, &list[i]);
+    }
+}
+
+// Whether every rect lies inside one of the boxes
+static bool boxes_cover(const Vector* rects, const struct Rect* boxes, size_t count) {
+    size_t index;
+    const struct Rect* rect = vector_getFirst(rects, &index);
+    while(rect != NULL) {
+        bool inside = false;
+        for(size_t i = 0; i < count; i++) {
+            if(rect->pos.x >= boxes[i].pos.x && rect->pos.y >= boxes[i].pos.y
+                    && rect->pos.x + rect->size.x <= boxes[i].pos.x + boxes[i].size.x
+                    && rect->pos.y + rect->size.y <= boxes[i].pos.y + boxes[i].size.y) {
+                inside = true;
+                break;
+            }
+        }
+        if(!inside)
+            return false;
+        rect = vector_getNext(rects, &index);
+    }
+    return true;
+}
+
+static struct TestResult merge_damage_boxes__return_no_boxes__no_rects() {
+    Vector rects;
+    make_rects(&rects, NULL, 0);
+    struct Rect boxes[TEXTURE_DAMAGE_BOXES];
+
+    size_t count = merge_damage_boxes(&rects, boxes);
+
+    assertEq(count, 0);
+}
+
+static struct TestResult merge_damage_boxes__keep_every_rect__rects_overlap() {
+    const struct Rect list[] = {
+        {.pos = {{0, 0}}, .size = {{20, 20}}},
+        {.pos = {{10, 10}}, .size = {{20, 20}}},
+    };
+    Vector rects;
+    make_rects(&rects, list, 2);
+    struct Rect boxes[TEXTURE_DAMAGE_BOXES];
+
+    size_t count = merge_damage_boxes(&rects, boxes);
+
+    assertEq(boxes_cover(&rects, boxes, count), true);
+}
+
+static struct TestResult merge_damage_boxes__use_at_most_the_box_limit__more_rects_than_boxes() {
+    const struct Rect list[] = {
+        {.pos = {{0, 0}}, .size = {{10, 10}}},
+        {.pos = {{100, 0}}, .size = {{10, 10}}},
+        {.pos = {{0, 100}}, .size = {{10, 10}}},
+        {.pos = {{100, 100}}, .size = {{10, 10}}},
+        {.pos = {{50, 50}}, .size = {{10, 10}}},
+        {.pos = {{12, 0}}, .size = {{10, 10}}},
+    };
+    Vector rects;
+    make_rects(&rects, list, 6);
+    struct Rect boxes[TEXTURE_DAMAGE_BOXES];
+
+    size_t count = merge_damage_boxes(&rects, boxes);
+
+    assertEq(count, TEXTURE_DAMAGE_BOXES);
+}
+
+static struct TestResult merge_damage_boxes__cover_every_rect__more_rects_than_boxes() {
+    const struct Rect list[] = {
+        {.pos = {{0, 0}}, .size = {{10, 10}}},
+        {.pos = {{100, 0}}, .size = {{10, 10}}},
+        {.pos = {{0, 100}}, .size = {{10, 10}}},
+        {.pos = {{100, 100}}, .size = {{10, 10}}},
+        {.pos = {{50, 50}}, .size = {{10, 10}}},
+        {.pos = {{12, 0}}, .size = {{10, 10}}},
+    };
+    Vector rects;
+    make_rects(&rects, list, 6);
+    struct Rect boxes[TEXTURE_DAMAGE_BOXES];
+
+    size_t count = merge_damage_boxes(&rects, boxes);
+
+    assertEq(boxes_cover(&rects, boxes, count), true);
+}
+
+static struct TestResult merge_damage_boxes__grow_the_closest_box__more_rects_than_boxes() {
+    const struct Rect list[] = {
+        {.pos = {{0, 0}}, .size = {{10, 10}}},
+        {.pos = {{100, 0}}, .size = {{10, 10}}},
+        {.pos = {{0, 100}}, .size = {{10, 10}}},
+        {.pos = {{100, 100}}, .size = {{10, 10}}},
+        {.pos = {{12, 0}}, .size = {{10, 10}}},
+    };
+    Vector rects;
+    make_rects(&rects, list, 5);
+    struct Rect boxes[TEXTURE_DAMAGE_BOXES];
+
+    merge_damage_boxes(&rects, boxes);
+
+    assertEq(boxes[0].size.x, 22);
+}
+
+// The pieces left of a 100x100 rect at 100,100 with a single occluder
+static void pieces_around(Vector* pieces, const struct Rect* occluder) {
+    const struct Rect rect = {.pos = {{100, 100}}, .size = {{100, 100}}};
+    Vector occluders;
+    vector_init(&occluders, sizeof(struct Rect), 1);
+    vector_putBack(&occluders, occluder);
+
+    vector_init(pieces, sizeof(struct Rect), 4);
+    visible_pieces(pieces, &rect, &occluders);
+    vector_kill(&occluders);
+}
+
+static bool piece_is(const Vector* pieces, float x, float y, float width, float height) {
+    if(vector_size(pieces) != 1)
+        return false;
+    const struct Rect* piece = vector_get(pieces, 0);
+    return piece->pos.x == x && piece->pos.y == y
+        && piece->size.x == width && piece->size.y == height;
+}
+
+static struct TestResult visible_pieces__return_nothing__rect_is_fully_covered() {
+    Vector pieces;
+    pieces_around(&pieces, &(struct Rect){.pos = {{50, 50}}, .size = {{200, 200}}});
+
+    assertEq(pieces.size, 0);
+}
+
+static struct TestResult visible_pieces__keep_the_whole_rect__occluder_doesnt_overlap() {
+    Vector pieces;
+    pieces_around(&pieces, &(struct Rect){.pos = {{300, 100}}, .size = {{50, 50}}});
+
+    assertEq(piece_is(&pieces, 100, 100, 100, 100), true);
+}
+
+static struct TestResult visible_pieces__keep_the_right_part__left_edge_is_covered() {
+    Vector pieces;
+    pieces_around(&pieces, &(struct Rect){.pos = {{50, 50}}, .size = {{80, 200}}});
+
+    assertEq(piece_is(&pieces, 130, 100, 70, 100), true);
+}
+
+static struct TestResult visible_pieces__keep_the_left_part__right_edge_is_covered() {
+    Vector pieces;
+    pieces_around(&pieces, &(struct Rect){.pos = {{170, 50}}, .size = {{80, 200}}});
+
+    assertEq(piece_is(&pieces, 100, 100, 70, 100), true);
+}
+
+static struct TestResult visible_pieces__keep_the_bottom_part__top_edge_is_covered() {
+    Vector pieces;
+    pieces_around(&pieces, &(struct Rect){.pos = {{50, 50}}, .size = {{200, 80}}});
+
+    assertEq(piece_is(&pieces, 100, 130, 100, 70), true);
+}
+
+static struct TestResult visible_pieces__keep_the_top_part__bottom_edge_is_covered() {
+    Vector pieces;
+    pieces_around(&pieces, &(struct Rect){.pos = {{50, 170}}, .size = {{200, 80}}});
+
+    assertEq(piece_is(&pieces, 100, 100, 100, 70), true);
+}
+
+static struct TestResult visible_pieces__return_4_pieces__middle_is_covered() {
+    Vector pieces;
+    pieces_around(&pieces, &(struct Rect){.pos = {{120, 120}}, .size = {{60, 60}}});
+
+    assertEq(pieces.size, 4);
+}
+
+static struct TestResult visible_pieces__keep_the_uncovered_area__middle_is_covered() {
+    Vector pieces;
+    pieces_around(&pieces, &(struct Rect){.pos = {{120, 120}}, .size = {{60, 60}}});
+
+    float area = 0;
+    size_t index;
+    const struct Rect* piece = vector_getFirst(&pieces, &index);
+    while(piece != NULL) {
+        area += piece->size.x * piece->size.y;
+        piece = vector_getNext(&pieces, &index);
+    }
+
+    assertEq(area, 100 * 100 - 60 * 60);
+}
+
+static void ranges_of(Vector* ranges, size_t capacity) {
+    vector_init(ranges, sizeof(struct face_range), 8);
+    face_ranges_add(ranges, 0, capacity);
+}
+
+static bool range_is(const Vector* ranges, size_t index, size_t first, size_t count) {
+    if(index >= vector_size(ranges))
+        return false;
+    const struct face_range* range = vector_get(ranges, index);
+    return range->first == first && range->count == count;
+}
+
+static struct TestResult face_ranges__reuse_the_range__taking_after_freeing() {
+    Vector ranges;
+    ranges_of(&ranges, 100);
+
+    size_t first;
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_add(&ranges, 10, 10);
+    face_ranges_take(&ranges, 10, &first);
+
+    assertEq(first, 10);
+}
+
+static struct TestResult face_ranges__merge_with_both_neighbours__freeing_between_free_ranges() {
+    Vector ranges;
+    ranges_of(&ranges, 100);
+
+    size_t first;
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_add(&ranges, 0, 10);
+    face_ranges_add(&ranges, 20, 10);
+    face_ranges_add(&ranges, 10, 10);
+
+    bool merged = ranges.size == 1 && range_is(&ranges, 0, 0, 100);
+    assertEq(merged, true);
+}
+
+static struct TestResult face_ranges__merge_with_the_previous__freeing_after_a_free_range() {
+    Vector ranges;
+    ranges_of(&ranges, 100);
+
+    size_t first;
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_add(&ranges, 0, 10);
+    face_ranges_add(&ranges, 10, 10);
+
+    bool merged = ranges.size == 2 && range_is(&ranges, 0, 0, 20);
+    assertEq(merged, true);
+}
+
+static struct TestResult face_ranges__merge_with_the_next__freeing_before_a_free_range() {
+    Vector ranges;
+    ranges_of(&ranges, 100);
+
+    size_t first;
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_take(&ranges, 10, &first);
+    face_ranges_add(&ranges, 10, 10);
+    face_ranges_add(&ranges, 0, 10);
+
+    bool merged = ranges.size == 2 && range_is(&ranges, 0, 0, 20);
+    assertEq(merged, true);
+}
+
+static struct TestResult face_ranges__stay_sorted__freeing_out_of_order() {
+    Vector ranges;
+    ranges_of(&ranges, 100);
+
+    size_t first;
+    for(size_t i = 0; i < 4; i++)
+        face_ranges_take(&ranges, 10, &first);
+    face_ranges_add(&ranges, 20, 10);
+    face_ranges_add(&ranges, 0, 10);
+
+    bool sorted = range_is(&ranges, 0, 0, 10)
+        && range_is(&ranges, 1, 20, 10)
+        && range_is(&ranges, 2, 40, 60);
+    assertEq(sorted, true);
+}
+
+static struct TestResult face_ranges__fail__no_range_is_large_enough() {
+    Vector ranges;
+    ranges_of(&ranges, 16);
+
+    size_t first;
+    face_ranges_take(&ranges, 12, &first);
+
+    assertEq(face_ranges_take(&ranges, 8, &first), false);
+}
+
+static struct TestResult face_ranges__double_until_the_count_fits__growing() {
+    assertEq(face_ranges_grownCapacity(16, 40), 64);
+}
+
+static struct TestResult face_ranges__allocate_past_the_old_capacity__growing_a_full_arena() {
+    Vector ranges;
+    ranges_of(&ranges, 16);
+
+    size_t first;
+    face_ranges_take(&ranges, 16, &first);
+    size_t capacity = face_ranges_grownCapacity(16, 4);
+    face_ranges_add(&ranges, 16, capacity - 16);
+    face_ranges_take(&ranges, 4, &first);
+
+    assertEq(first, 16);
+}
+
+static struct TestResult face_ranges__merge_the_free_tail__growing() {
+    Vector ranges;
+    ranges_of(&ranges, 16);
+
+    size_t first;
+    face_ranges_take(&ranges, 12, &first);
+    size_t capacity = face_ranges_grownCapacity(16, 8);
+    face_ranges_add(&ranges, 16, capacity - 16);
+    face_ranges_take(&ranges, 8, &first);
+
+    assertEq(first, 12);
+}
+
 int main(int argc, char** argv) {
     vector_init(&results, sizeof(struct Test), 128);
 
@@ -1068,6 +1510,8 @@ int main(int argc, char** argv) {
     TEST(swiss__say_there_is_a_component__checking_an_entity_with_component);
     TEST(swiss__say_there_isnt_a_component__checking_a_removed_component);
 
+    TEST(swiss__find_the_entity__looking_up_an_indexed_key);
+    TEST(swiss__not_find_the_entity__looking_up_a_removed_key);
     TEST(swiss__double_capacity__allocating_past_end);
 
     TEST(swiss__iterate_components_in_order_abcdef__iterating_forward_over_abcdef);
@@ -1109,5 +1553,37 @@ int main(int argc, char** argv) {
     TEST(commit_unmap__transision_last_window__has_multiple_windows_and_last_has_destroy_event);
     TEST(commit_unmap__not_crash__window_with_destroy_event_has_no_state);
 
+    TEST(screendamage__damage_the_whole_screen__age_is_0);
+    TEST(screendamage__damage_the_whole_screen__age_is_older_than_history);
+    TEST(screendamage__cover_both_boxes__adding_disjoint_boxes);
+    TEST(screendamage__include_older_frames__age_is_2);
+    TEST(screendamage__be_empty__presented);
+    TEST(screendamage__not_be_empty__damaged);
+
+    TEST(merge_damage_boxes__return_no_boxes__no_rects);
+    TEST(merge_damage_boxes__keep_every_rect__rects_overlap);
+    TEST(merge_damage_boxes__use_at_most_the_box_limit__more_rects_than_boxes);
+    TEST(merge_damage_boxes__cover_every_rect__more_rects_than_boxes);
+    TEST(merge_damage_boxes__grow_the_closest_box__more_rects_than_boxes);
+
+    TEST(visible_pieces__return_nothing__rect_is_fully_covered);
+    TEST(visible_pieces__keep_the_whole_rect__occluder_doesnt_overlap);
+    TEST(visible_pieces__keep_the_right_part__left_edge_is_covered);
+    TEST(visible_pieces__keep_the_left_part__right_edge_is_covered);
+    TEST(visible_pieces__keep_the_bottom_part__top_edge_is_covered);
+    TEST(visible_pieces__keep_the_top_part__bottom_edge_is_covered);
+    TEST(visible_pieces__return_4_pieces__middle_is_covered);
+    TEST(visible_pieces__keep_the_uncovered_area__middle_is_covered);
+
+    TEST(face_ranges__reuse_the_range__taking_after_freeing);
+    TEST(face_ranges__merge_with_both_neighbours__freeing_between_free_ranges);
+    TEST(face_ranges__merge_with_the_previous__freeing_after_a_free_range);
+    TEST(face_ranges__merge_with_the_next__freeing_before_a_free_range);
+    TEST(face_ranges__stay_sorted__freeing_out_of_order);
+    TEST(face_ranges__fail__no_range_is_large_enough);
+    TEST(face_ranges__double_until_the_count_fits__growing);
+    TEST(face_ranges__allocate_past_the_old_capacity__growing_a_full_arena);
+    TEST(face_ranges__merge_the_free_tail__growing);
+
     return test_end();
 }